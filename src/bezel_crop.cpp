@@ -0,0 +1,79 @@
+/*
+ * This file is part of Moving Cells.
+ *
+ * Moving Cells is is a digital installation building on a depth sensor to
+ * allow spectators to interact with a cloud of particles through their movements.
+ * It has been developed and first displayed in June 2015 by Robin Lamarche-Perrin
+ * and Bruno Pace for the eponymous dance festival, in Leipzig.
+ * See: http://www.movingcells.org
+ * 
+ * The current version of the program is implemented on Kinect for Windows v2 (K4W2)
+ * through the open source driver libreenect2.
+ * See: https://github.com/OpenKinect/libfreenect2
+ * 
+ * Copyright © 2015-2017 Robin Lamarche-Perrin and Bruno Pace
+ * (<Robin.Lamarche-Perrin@lip6.fr>)
+ * 
+ * Moving Cells is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ * 
+ * Moving Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <cmath>
+#include <cstring>
+
+#include "bezel_crop.hpp"
+
+
+void BezelCrop::setup (int width, int height, int type)
+{
+	inputWidth = width;
+	inputHeight = height;
+	inputType = type;
+
+	if (evenBorders) {
+		borderWidth = round (width * widthRatio / 2) * 2;
+		borderHeight = round (height * heightRatio / 2) * 2;
+	}
+	else {
+		borderWidth = round (width * widthRatio);
+		borderHeight = round (height * heightRatio);
+	}
+	screenWidth = (width - borderWidth) / 2;
+	screenHeight = (height - borderHeight) / 2;
+
+	sourceRows.resize (2 * screenHeight);
+	for (int y = 0; y < screenHeight; y++) {
+		sourceRows[y] = y;
+		sourceRows[screenHeight + y] = screenHeight + borderHeight + y;
+	}
+
+	int pixelSize = CV_ELEM_SIZE (type);
+	spans.clear();
+	spans.push_back ({0, 0, screenWidth * pixelSize});
+	spans.push_back ({(screenWidth + borderWidth) * pixelSize, screenWidth * pixelSize, screenWidth * pixelSize});
+}
+
+
+// The spans are computed again when the input changes size or type
+void BezelCrop::apply (const cv::Mat &input, cv::Mat &output)
+{
+	if (input.cols != inputWidth || input.rows != inputHeight || input.type() != inputType) { setup (input.cols, input.rows, input.type()); }
+	output.create (getOutputHeight(), getOutputWidth(), input.type());
+
+	for (int y = 0; y < (int) sourceRows.size(); y++) {
+		const unsigned char *source = input.ptr<uchar>(sourceRows[y]);
+		unsigned char *destination = output.ptr<uchar>(y);
+		for (unsigned int i = 0; i < spans.size(); i++) { memcpy (destination + spans[i].destination, source + spans[i].source, spans[i].length); }
+	}
+}
@@ -0,0 +1,84 @@
+/*
+ * This file is part of Moving Cells.
+ *
+ * Moving Cells is is a digital installation building on a depth sensor to
+ * allow spectators to interact with a cloud of particles through their movements.
+ * It has been developed and first displayed in June 2015 by Robin Lamarche-Perrin
+ * and Bruno Pace for the eponymous dance festival, in Leipzig.
+ * See: http://www.movingcells.org
+ * 
+ * The current version of the program is implemented on Kinect for Windows v2 (K4W2)
+ * through the open source driver libreenect2.
+ * See: https://github.com/OpenKinect/libfreenect2
+ * 
+ * Copyright © 2015-2017 Robin Lamarche-Perrin and Bruno Pace
+ * (<Robin.Lamarche-Perrin@lip6.fr>)
+ * 
+ * Moving Cells is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ * 
+ * Moving Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef BEZEL_CROP_HPP
+#define BEZEL_CROP_HPP
+
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+
+#define BEZEL_WIDTH_RATIO         (2.596 / 332.644)   // width of the vertical mullion over the width of the 2x2 video wall
+#define BEZEL_HEIGHT_RATIO        (3.124 / 188.776)   // height of the horizontal mullion over the height of the wall
+
+
+// BEZEL CROP
+//
+// Removes the mullions of a 2x2 video wall from a frame drawn across it, so
+// that the four screens are joined without the hidden rows and columns. The
+// copy is precomputed once per frame size: the input row of each output row,
+// and the byte spans copied from it, one per screen column.
+
+struct CopySpan
+{
+	int source;                               // byte offset in the input row
+	int destination;                          // byte offset in the output row
+	int length;                               // in bytes
+};
+
+
+class BezelCrop
+{
+public:
+	double widthRatio = BEZEL_WIDTH_RATIO;
+	double heightRatio = BEZEL_HEIGHT_RATIO;
+	bool evenBorders = false;                 // mullion widths rounded to even values (time-delays)
+
+	int inputWidth = 0;
+	int inputHeight = 0;
+	int inputType = -1;
+	int screenWidth = 0;
+	int screenHeight = 0;
+	int borderWidth = 0;
+	int borderHeight = 0;
+
+	std::vector<int> sourceRows;              // input row of each output row
+	std::vector<CopySpan> spans;              // the same for every row
+
+	void setup (int width, int height, int type);
+	int getOutputWidth () const { return 2 * screenWidth; }
+	int getOutputHeight () const { return 2 * screenHeight; }
+	void apply (const cv::Mat &input, cv::Mat &output);
+};
+
+
+#endif
@@ -34,9 +34,12 @@
 
 #include <iostream>
 #include <cstdio>
+#include <cmath>
+#include <algorithm>
 #include <signal.h>
 #include <sys/time.h>
 #include <errno.h>
+#include <unistd.h>
 #include <pthread.h>
 #include <time.h>
 
@@ -89,29 +92,44 @@ void Cloud::run ()
 {
 	computeFrame();
 	if (displayParticles) displayFrame();
+	restoreFrame();
 
 	while (!stop)
 	{
+		if (resizeRequested) { applyResize (); }
 		getTime();
 		events.step (delay);
-		if (readParameters && inputParameterFile) { readInputParameterFile (); }
+		if (readParameters && timeline != NULL) { readInputParameterFile (); }
 		
 #if VERBOSE
 		std::cout << "FRAME NUMBER " << frameNb << std::endl;
 #endif
 
 		updateBodies ();
-		updatePhysics ();
-		computeParticles();
+		if (reorderFrequency > 0 && frameNb % reorderFrequency == 0) { reorderParticles (); }
+
+		struct timeval particleTimer;
+		gettimeofday (&particleTimer, NULL);
+		if (physicsFrequency > 0) { stepParticles (); }
+		else {
+			updatePhysics ();
+			computeParticles();
+		}
+		sumParticleDelay += getElapsedTime (particleTimer);
+
 		computeFrame();
 
 		if ((frameFrequency == 0 && frameLogFrequency == 0)
 			|| (frameFrequency > 0 && frameNb % frameFrequency == 0)
 			|| (frameLogFrequency > 0 && (int) (log (frameNb) / log (frameLogFrequency)) == log (frameNb) / log (frameLogFrequency))
 			) {
-			if (displayParticles) displayFrame();
 			if (recordParticles) recordFrame();
+			if (recordVideo) streamFrame();
+			if (displayParticles) displayFrame();
 		}
+		restoreFrame();
+		if (autosaveDelay > 0) { autosave (); }
+		parameterRecorder.commit();
 
 #if VERBOSE
 		std::cout << std::endl;
@@ -119,6 +137,11 @@ void Cloud::run ()
 
 		if (frameLimit > 0 && frameNb > frameLimit) stop = true;
 	}
+
+	recorder.stop();
+	video.close();
+	snapshotWriter.stop();
+	snapshotPrefetcher.stop();
 }
 
 
@@ -127,15 +150,17 @@ void Cloud::setup ()
 	stop = false;
 	setupParameters();
 	
-	// SETUP PARTICLES
-	particles = new Particle [maxParticleNumber];
+	// SETUP PARTICLES AND PIXELS
+	if (particleNumber > maxParticleNumber) { particleNumber = maxParticleNumber; }
+	presentFrames = displayParticles && presentationThread;
+	renderTexture = displayParticles && textureFrame && !presentFrames;
+	persistentFrame = !presentFrames && !renderTexture;
+	setupBuffers ();
 	initParticles (particleInitMode);
 
-	particleRedArray = new int [maxParticleNumber * pixelResolution + 1];
-	particleBlueArray = new int [maxParticleNumber * pixelResolution + 1];
-	particleGreenArray = new int [maxParticleNumber * pixelResolution + 1];
-
-	setupColor ();
+	particleKernelId = getBestParticleKernel ();
+	if (fastPhysics) { std::cout << "PARTICLE KERNEL: " << getParticleKernelName (particleKernelId) << std::endl; }
+	pixelKernel = fixedPixels ? getFixedPixelKernel (particleKernelId) : getPixelKernel (particleKernelId);
 
 	if (configFilename != "") {
 		if (outputFilename == "") { outputFilename = "out/" + configFilename.substr (configFilename.rfind ("/") + 1); }
@@ -149,30 +174,50 @@ void Cloud::setup ()
 		else {
 			int windowMode = 0;
 			if (displayFullscreen) { windowMode = SDL_WINDOW_FULLSCREEN_DESKTOP; }
+			SDL_SetHint (SDL_HINT_RENDER_VSYNC, vsync ? "1" : "0");
 			if (SDL_CreateWindowAndRenderer (graphicsWidth, graphicsHeight, windowMode, &window, &renderer) < 0) { std::cerr << "Error creating window or renderer: " << SDL_GetError() << std::endl; SDL_Quit(); }
 			else {
-				texture = SDL_CreateTexture (renderer, SDL_PIXELFORMAT_BGR24, SDL_TEXTUREACCESS_STREAMING, graphicsWidth, graphicsHeight);
+				createTexture ();
 				if (hideMouse) { SDL_ShowCursor (SDL_DISABLE); }
 			}
 		}
 	}
-		  
-	frame = new cv::Mat (graphicsHeight, graphicsWidth, CV_8UC3);
-	pixels = new float [graphicsWidth*graphicsHeight];
+	if (texture == NULL) { presentFrames = false; renderTexture = false; }
 
 	// SETUP THREADS
 	setupThreads();
+	if (presentFrames) { startPresenter (); }
+	if (recordParticles) { recorder.start (recordThreadNumber, recordQueueSize, recordLive); }
+	if (recordVideo) {
+		if (videoFilename == "") { videoFilename = outputFilename + (videoFormat == Y4M_STREAM ? ".y4m" : ".bgr"); }
+		openVideo (videoFilename);
+	}
 
 	// SETUP TIME
+	// With vsync, inline presentation already paces the frames at the refresh
+	// rate, while the presenter thread needs the simulation to be paced by sleeping
+	pacer.targetRate = framePerSecond;
+	if (vsync && framePerSecond == 0 && window != NULL) {
+		SDL_DisplayMode mode;
+		pacer.targetRate = DEFAULT_REFRESH_RATE;
+		if (SDL_GetCurrentDisplayMode (SDL_GetWindowDisplayIndex (window), &mode) == 0 && mode.refresh_rate > 0) { pacer.targetRate = mode.refresh_rate; }
+		pacer.vsync = !presentFrames;
+	}
+
 	frameNb = 0;
-	sumFrameNb = 0;
 	delay = 0;
-	sumDelay = 0;
 	currentDelay = 0;
-	gettimeofday (&startTimer, NULL);
-	parameterTimer = startTimer;
+	sumParticleDelay = 0;
+	sumReorderDelay = 0;
+	sumReorderNb = 0;
+	sumDroppedStepNb = 0;
+	physicsTime = 0;
+	pacer.start ();
+	autosaveTime = pacer.lastTime;
+	parameterStartTime = FramePacer::getTime();
 
 	initParticles (UNIFORM_INIT);
+	if (warmRestart && access (autosaveFilename.c_str(), R_OK) == 0) { readParticlePositions (autosaveFilename); }
 
 	// SETUP EVENTS
 	setupEvents ();
@@ -181,21 +226,447 @@ void Cloud::setup ()
 		openOutputParameterFile (inoutParameterFilename);
 		writeOutputParameterFile ();
 	}
-	else if (readParameters) { openInputParameterFile (inoutParameterFilename); }
+	else if (readParameters) {
+		preloadParameterSequences ();
+		openInputParameterFile (inoutParameterFilename, sequenceStartTime);
+	}
 }
 
 
 void Cloud::setdown ()
 {
+	presenter.stop();
+	recorder.stop();
+	video.close();
+	snapshotWriter.stop();
+	snapshotPrefetcher.stop();
 	if (recordParameters) { closeOutputParameterFile(); }
 	else if (readParameters) { closeInputParameterFile(); }
+	workers.stop();
+
+	delete [] pixelCounts;
+	pixelCounts = NULL;
+	pixelCountCapacity = 0;
+}
+
+
+// Sizes the buffers from particleNumber and the resolution. Allocations are
+// only replaced when they are too small, so that resizing down and up again
+// does not allocate anything.
+void Cloud::setupBuffers ()
+{
+	pixelNumber = graphicsWidth * graphicsHeight;
+
+	particles.resize (particleNumber);
+
+	if (fixedPixels) {
+		if (pixelNumber > pixelCapacity) {
+			delete [] fixedDensities;
+			fixedDensities = new uint16_t [pixelNumber];
+			pixelCapacity = pixelNumber;
+		}
+		std::fill (fixedDensities, fixedDensities + pixelNumber, 0);
+	}
+
+	else {
+		if (pixelNumber > pixelCapacity) {
+			delete [] pixels;
+			pixels = new float [pixelNumber];
+			pixelCapacity = pixelNumber;
+		}
+		std::fill (pixels, pixels + pixelNumber, 0);
+	}
+
+	updateColor ();
+
+	// The workers draw into the back buffer of the presenter
+	int frameType = (displayParticles && argbTexture) ? CV_8UC4 : CV_8UC3;
+	if (frame == NULL) { frame = new cv::Mat (); }
+	if (presentFrames) {
+		presenter.buffers.create (graphicsHeight, graphicsWidth, frameType);
+		*frame = presenter.buffers.getBack ();
+	}
+	else { frame->create (graphicsHeight, graphicsWidth, frameType); }
+	refreshPixels = true;
+}
+
+
+// The texture has the layout of the frame: BGRA bytes of ARGB8888, or BGR24
+void Cloud::createTexture ()
+{
+	int format = argbTexture ? SDL_PIXELFORMAT_ARGB8888 : SDL_PIXELFORMAT_BGR24;
+	texture = SDL_CreateTexture (renderer, format, SDL_TEXTUREACCESS_STREAMING, graphicsWidth, graphicsHeight);
+	if (texture == NULL) { std::cerr << "Error creating texture: " << SDL_GetError() << std::endl; exit (-1); }
+	if (format == SDL_PIXELFORMAT_ARGB8888) { SDL_SetTextureBlendMode (texture, SDL_BLENDMODE_NONE); }
+	textureLocked = false;
+}
+
+
+// Makes the frame a header of the locked texture, so that the workers and the
+// overlays draw straight into it. Its rows may be padded to the texture pitch.
+// The texture is write-only: every pixel has to be converted again.
+void Cloud::lockTexture ()
+{
+	if (textureLocked) { return; }
+
+	void *data = NULL;
+	int pitch = 0;
+	if (SDL_LockTexture (texture, NULL, &data, &pitch) < 0) { std::cerr << "Error locking texture: " << SDL_GetError() << std::endl; exit (-1); }
+	*frame = cv::Mat (graphicsHeight, graphicsWidth, frame->type(), data, pitch);
+	textureLocked = true;
+}
+
+
+// Frames are expected at the display rate, unless the frame rate is fixed or
+// only some frames are displayed
+void Cloud::startPresenter ()
+{
+	float framePeriod = (framePerSecond > 0) ? 1 / framePerSecond : 0;
+	if (frameFrequency > 1) { framePeriod = (framePeriod > 0 ? framePeriod : 1. / DEFAULT_REFRESH_RATE) * frameFrequency; }
+	presenter.start (window, renderer, texture, framePeriod);
+}
+
+
+// Opens the video at the size of the recorded frames, cropped or not
+void Cloud::openVideo (std::string filename)
+{
+	int videoWidth = graphicsWidth;
+	int videoHeight = graphicsHeight;
+	if (cropBezels) {
+		bezelCrop.setup (graphicsWidth, graphicsHeight, frame->type());
+		videoWidth = bezelCrop.getOutputWidth();
+		videoHeight = bezelCrop.getOutputHeight();
+	}
+	if (!video.open (filename, videoFormat, videoWidth, videoHeight, videoFrameRate)) { recordVideo = false; }
+}
+
+
+// Asks for a new particle number and resolution, applied by the cloud thread
+// at the beginning of its next frame. Can be called from any thread.
+void Cloud::resize (int vParticleNumber, int vWidth, int vHeight)
+{
+	pthread_mutex_lock (&mutex);
+	requestedParticleNumber = std::min (std::max (vParticleNumber, 1), (int) maxParticleNumber);
+	requestedWidth = std::max (vWidth, 1);
+	requestedHeight = std::max (vHeight, 1);
+	resizeRequested = true;
+	pthread_mutex_unlock (&mutex);
+}
+
+
+void Cloud::applyResize ()
+{
+	pthread_mutex_lock (&mutex);
+	int newParticleNumber = requestedParticleNumber;
+	int newWidth = requestedWidth;
+	int newHeight = requestedHeight;
+	resizeRequested = false;
+	pthread_mutex_unlock (&mutex);
+
+	int oldParticleNumber = particleNumber;
+	bool resolutionChanged = (newWidth != graphicsWidth || newHeight != graphicsHeight);
+	if (newParticleNumber == oldParticleNumber && !resolutionChanged) { return; }
+
+	// Keep particles and bodies at the same place on the screen (positions are
+	// in units of rDistance, which changes with the resolution)
+	float distanceRatio = rDistance / sqrt ((float) newWidth * newHeight);
+	float scaleX = (float) newWidth / graphicsWidth * distanceRatio;
+	float scaleY = (float) newHeight / graphicsHeight * distanceRatio;
+
+	if (resolutionChanged) {
+		for (int i = 0; i < std::min (oldParticleNumber, newParticleNumber); i++) {
+			particles.x[i] *= scaleX;
+			particles.y[i] *= scaleY;
+		}
+
+		pthread_mutex_lock (&mutex);
+		for (unsigned int j = 0; j < newBodyList->size(); j++) {
+			newBodyList->at(j)->x *= scaleX;
+			newBodyList->at(j)->y *= scaleY;
+		}
+		pthread_mutex_unlock (&mutex);
+	}
+
+	// The presenter reads the buffers and the texture being replaced
+	presenter.stop ();
+
+	particleNumber = newParticleNumber;
+	graphicsWidth = newWidth;
+	graphicsHeight = newHeight;
+	updatePhysics ();
+	setupBuffers ();
+	setupThreads ();
+
+	// New particles are spread randomly
+	for (int i = oldParticleNumber; i < particleNumber; i++) {
+		particles.x[i] = (rand() % graphicsWidth) / rDistance;
+		particles.y[i] = (rand() % graphicsHeight) / rDistance;
+		particles.dx[i] = 0;
+		particles.dy[i] = 0;
+	}
+
+	if (resolutionChanged && displayParticles && renderer != NULL) {
+		if (textureLocked) { SDL_UnlockTexture (texture); }
+		SDL_DestroyTexture (texture);
+		createTexture ();
+		if (!displayFullscreen) { SDL_SetWindowSize (window, graphicsWidth, graphicsHeight); }
+	}
+	if (presentFrames) { startPresenter (); }
+	if (recordParticles) { recorder.start (recordThreadNumber, recordQueueSize, recordLive); }
+
+	// A video stream has a single frame size: the new resolution goes to a new file
+	if (resolutionChanged) {
+		recordedFrameNb = -1;
+		recordedFrame = cv::Mat();
+		if (cropBezels) { bezelCrop.setup (graphicsWidth, graphicsHeight, frame->type()); }
+		if (recordVideo) {
+			video.close ();
+			std::string filename = videoFilename;
+			size_t extension = filename.rfind ('.');
+			if (extension == std::string::npos || extension < filename.rfind ('/') + 1) { extension = filename.size(); }
+			std::stringstream ss;
+			ss << filename.substr (0, extension) << "-" << graphicsWidth << "x" << graphicsHeight << filename.substr (extension);
+			openVideo (ss.str());
+		}
+	}
+
+	std::cout << "RESIZE: " << particleNumber << " particles, " << graphicsWidth << " x " << graphicsHeight << std::endl;
+}
+
+
+// Compares the forces computed by the fast kernel with the exact ones, over the
+// ranges of setupParameters: gravitation factors and angles are swept with
+// their large keyboard steps, bodies are drawn within the bounds of bodyX and
+// bodyY, and particles all over the screen. Returns false if a deviation
+// exceeds FAST_PHYSICS_TOLERANCE.
+bool Cloud::checkPhysics ()
+{
+	setupParameters ();
+	updatePhysics ();
+
+	int kernelId = getBestParticleKernel ();
+	std::cout << "CHECK PHYSICS: " << getParticleKernelName (kernelId) << " kernel against exact kernel" << std::endl;
+
+	const int sampleNumber = 4096;
+	const int maxBodyNumber = 4;
+	const float minFactor = -2;
+	const float maxFactor = 4;
+
+	std::mt19937 generator (0);
+	std::uniform_real_distribution<float> uniform (0, 1);
+
+	ParticleArray fast;
+	ParticleArray exact;
+	fast.allocate (sampleNumber);
+	exact.allocate (sampleNumber);
+
+	std::vector<float> sampleX (sampleNumber);
+	std::vector<float> sampleY (sampleNumber);
+	for (int i = 0; i < sampleNumber; i++) {
+		sampleX[i] = uniform (generator) * rWidthBorder;
+		sampleY[i] = uniform (generator) * rHeightBorder;
+	}
+
+	std::vector<float> bodyX (maxBodyNumber);
+	std::vector<float> bodyY (maxBodyNumber);
+	std::vector<float> bodyWeight (maxBodyNumber);
+
+	// One step of delay 1 from zero speed, without damping: the new speed is the force
+	ParticleKernelArgs args = particleKernelArgs;
+	args.first = 0;
+	args.last = sampleNumber;
+	args.bodyX = bodyX.data();
+	args.bodyY = bodyY.data();
+	args.bodyWeight = bodyWeight.data();
+	args.damping = 0;
+	args.delay = 1;
+
+	const Parameter &factorParameter = parameters[GRAVITATION_FACTOR];
+	const Parameter &angleParameter = parameters[GRAVITATION_ANGLE];
+	const Parameter &xParameter = parameters[BODY_X];
+	const Parameter &yParameter = parameters[BODY_Y];
+
+	float worstDeviation = 0;
+	for (float factor = minFactor; factor <= maxFactor; factor += 5 * factorParameter.aadd) {
+		float maxDeviation = 0;
+		double sumDeviation = 0;
+		long sampleCount = 0;
+
+		for (float angle = 0; angle < 360; angle += 9 * angleParameter.aadd) {
+			for (int bodyNumber = 1; bodyNumber <= maxBodyNumber; bodyNumber *= 2) {
+				for (int j = 0; j < bodyNumber; j++) {
+					bodyX[j] = xParameter.min + uniform (generator) * (xParameter.max - xParameter.min);
+					bodyY[j] = yParameter.min + uniform (generator) * (yParameter.max - yParameter.min);
+					bodyWeight[j] = 2 * uniform (generator) - 1;
+				}
+
+				args.bodyNumber = bodyNumber;
+				args.forceLaw = getForceLaw (factor);
+				args.exponent = - factor / 2 - 0.5;
+				args.cosAngle = cos (angle * PI / 180);
+				args.sinAngle = sin (angle * PI / 180);
+				args.zeroX = (args.forceLaw == CONSTANT_FORCE) ? args.cosAngle : 0;
+				args.zeroY = (args.forceLaw == CONSTANT_FORCE) ? args.sinAngle : 0;
+				args.gravitationFactor = factor / 2;
+				args.gravitationAngle = angle * PI / 180;
+				ParticleKernel kernel = getParticleKernel (kernelId, args.forceLaw, bodyNumber);
+
+				for (int i = 0; i < sampleNumber; i++) {
+					fast.x[i] = exact.x[i] = sampleX[i];
+					fast.y[i] = exact.y[i] = sampleY[i];
+					fast.dx[i] = exact.dx[i] = 0;
+					fast.dy[i] = exact.dy[i] = 0;
+				}
+
+				args.x = fast.x; args.y = fast.y; args.dx = fast.dx; args.dy = fast.dy;
+				kernel (args);
+				args.x = exact.x; args.y = exact.y; args.dx = exact.dx; args.dy = exact.dy;
+				integrateParticlesExact (args);
+
+				for (int i = 0; i < sampleNumber; i++) {
+					float norm = sqrt (pow (exact.dx[i], 2) + pow (exact.dy[i], 2));
+					if (norm == 0 || !std::isfinite (norm)) continue;
+
+					float deviation = sqrt (pow (fast.dx[i] - exact.dx[i], 2) + pow (fast.dy[i] - exact.dy[i], 2)) / norm;
+					if (!std::isfinite (deviation)) { deviation = FLT_MAX; }
+					maxDeviation = std::max (maxDeviation, deviation);
+					sumDeviation += deviation;
+					sampleCount++;
+				}
+			}
+		}
+
+		const char *law;
+		switch (getForceLaw (factor)) {
+		case CONSTANT_FORCE       : law = "constant"; break;
+		case INVERSE_LINEAR_FORCE : law = "inverse-linear"; break;
+		case INVERSE_SQUARE_FORCE : law = "inverse-square"; break;
+		default                   : law = "generic"; break;
+		}
+
+		std::cout << "gravitationFactor " << factor << " (" << law << "): max deviation " << maxDeviation
+				  << ", mean deviation " << sumDeviation / std::max (sampleCount, 1L) << std::endl;
+		worstDeviation = std::max (worstDeviation, maxDeviation);
+	}
+
+	bool passed = worstDeviation <= FAST_PHYSICS_TOLERANCE;
+	std::cout << "-> " << (passed ? "PASSED" : "FAILED") << ": worst deviation " << worstDeviation << " (tolerance " << FAST_PHYSICS_TOLERANCE << ")" << std::endl;
+	return passed;
+}
+
+
+// Compares the fixed-point densities with the float ones over several
+// half-lives, for the precisions of setupFixedColor: a fading from a high and
+// a low density without particles, then a drawing from zero with constant
+// particle counts. The mean densities are compared after each half-life, and
+// the SIMD fixed-point kernel with the scalar one. Returns false if a mean
+// deviates by more than FIXED_FADE_TOLERANCE, or if the kernels differ.
+bool Cloud::checkFading ()
+{
+	int kernelId = getBestParticleKernel ();
+	std::cout << "CHECK FADING: " << getParticleKernelName (kernelId) << " fixed-point kernel against float kernel" << std::endl;
+
+	const int sampleNumber = 4096;
+	const int halfLifeNumber = 4;
+	const int shifts[] = { 6, 9, FIXED_MAX_SHIFT };
+	const int halfLives[] = { 4, 16, 64, 256 };
+	const float drawingRates[] = { 0.002, 0.01, 0.05, 0.3 };
+
+	std::mt19937 generator (0);
+	std::uniform_int_distribution<int> uniform (0, 3);
+	std::vector<unsigned int> sampleCounts (sampleNumber);
+	for (int i = 0; i < sampleNumber; i++) { sampleCounts[i] = uniform (generator); }
+
+	std::vector<unsigned int> counts (sampleNumber);
+	std::vector<float> floatPixels (sampleNumber);
+	std::vector<uint16_t> fixedPixels (sampleNumber);
+	std::vector<uint16_t> scalarPixels (sampleNumber);
+	std::vector<uint32_t> table (COLOR_TABLE_SIZE);
+	std::vector<unsigned char> colors (sampleNumber * 4);
+
+	PixelKernelArgs args;
+	args.counts = counts.data();
+	args.frame = colors.data();
+	args.frameChannels = 4;
+	args.first = 0;
+	args.last = sampleNumber;
+	args.table = table.data();
+	args.tableScale = 0;
+
+	PixelKernel fixedKernel = getFixedPixelKernel (kernelId);
+	float worstDeviation = 0;
+	bool identical = true;
+
+	for (int shift : shifts) {
+		float saturation = 0xffff / (float) (1 << shift);
+		float epsilon = FIXED_FADE_EPSILON / (float) (1 << shift);
+
+		for (int halfLife : halfLives) {
+			float maxDeviation = 0;
+			args.cleaningRate = pow (0.5, 1.0 / halfLife);
+
+			// Fadings from a half and a hundredth of the saturation, then drawings
+			// whose equilibrium lies between a few epsilons and half the saturation
+			for (int run = 0; run < 2 + (int) (sizeof (drawingRates) / sizeof (float)); run++) {
+				float initialDensity = (run == 0) ? saturation / 2 : (run == 1) ? saturation / 100 : 0;
+				args.drawingRate = (run < 2) ? 0 : drawingRates[run - 2];
+				float equilibrium = 1.5 * args.drawingRate / (1 - args.cleaningRate);
+				if (run >= 2 && (equilibrium > saturation / 2 || equilibrium < 4 * epsilon)) { continue; }
+
+				for (int i = 0; i < sampleNumber; i++) {
+					floatPixels[i] = initialDensity;
+					fixedPixels[i] = scalarPixels[i] = lround (initialDensity * (1 << shift));
+				}
+
+				for (int frame = 1; frame <= halfLifeNumber * halfLife; frame++) {
+					setupFixedRates (args, shift, frame);
+
+					args.pixels = floatPixels.data();
+					for (int i = 0; i < sampleNumber; i++) { counts[i] = sampleCounts[i] * (run >= 2); }
+					convertPixelsScalar (args);
+
+					args.fixedPixels = fixedPixels.data();
+					for (int i = 0; i < sampleNumber; i++) { counts[i] = sampleCounts[i] * (run >= 2); }
+					fixedKernel (args);
+
+					args.fixedPixels = scalarPixels.data();
+					for (int i = 0; i < sampleNumber; i++) { counts[i] = sampleCounts[i] * (run >= 2); }
+					convertFixedPixelsScalar (args);
+
+					identical = identical && fixedPixels == scalarPixels;
+					if (frame % halfLife != 0) { continue; }
+
+					double floatSum = 0;
+					double fixedSum = 0;
+					for (int i = 0; i < sampleNumber; i++) {
+						floatSum += floatPixels[i];
+						fixedSum += fixedPixels[i] / (double) (1 << shift);
+					}
+					maxDeviation = std::max (maxDeviation, (float) fabs (fixedSum / floatSum - 1));
+				}
+			}
+
+			std::cout << "fixedShift " << shift << ", half-life " << halfLife << " frames: max deviation " << maxDeviation << std::endl;
+			worstDeviation = std::max (worstDeviation, maxDeviation);
+		}
+	}
+
+	bool passed = worstDeviation <= FIXED_FADE_TOLERANCE && identical;
+	if (!identical) { std::cout << "SIMD fixed-point densities differ from the scalar ones" << std::endl; }
+	std::cout << "-> " << (passed ? "PASSED" : "FAILED") << ": worst deviation " << worstDeviation << " (tolerance " << FIXED_FADE_TOLERANCE << ")" << std::endl;
+	return passed;
 }
 
 
 void Cloud::setupThreads ()
 {
-	pthread_attr_init (&attr);
-	pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_JOINABLE);
+	if (threadNumber <= 0) { threadNumber = WorkerPool::getProcessorNumber(); }
+	workers.start (threadNumber);
+
+	firstParticle.resize (threadNumber);
+	lastParticle.resize (threadNumber);
+	firstPixel.resize (threadNumber);
+	lastPixel.resize (threadNumber);
 
 	int particlePerThread = particleNumber / threadNumber;
 	int currentParticle = 0;
@@ -216,6 +687,32 @@ void Cloud::setupThreads ()
 		lastPixel[i] = currentPixel;
 	}
 	lastPixel[threadNumber-1] = pixelNumber;
+
+	if (pixelNumber > pixelCountCapacity) {
+		pixelCountCapacity = pixelNumber;
+		delete [] pixelCounts;
+		pixelCounts = new unsigned int [pixelCountCapacity] ();
+	}
+	else { std::fill (pixelCounts, pixelCounts + pixelNumber, 0); }
+
+	// A single count buffer is shared: a single worker counts its particles
+	// directly, several workers bin them so that each tile is counted by one
+	// of them. Fused bands keep their counts, densities and colors in cache
+	// (the frame is created by setupBuffers).
+	binning = tileBinning || fusedPixels || threadNumber > 1;
+	if (fusedPixels) {
+		int bytesPerPixel = sizeof (unsigned int) + (fixedPixels ? sizeof (uint16_t) : sizeof (float)) + frame->elemSize();
+		tileBins.setup (graphicsWidth, graphicsHeight, bytesPerPixel, threadNumber, particleNumber, true);
+	}
+	else { tileBins.setup (graphicsWidth, graphicsHeight, sizeof (unsigned int), threadNumber, particleNumber); }
+
+	dirtyGrid.setup (graphicsWidth, graphicsHeight, DIRTY_TILE_SHIFT, DIRTY_TILE_SHIFT);
+	pixelGrid = binning ? &tileBins.grid : &dirtyGrid;
+	dirtyTiles.assign (dirtyGrid.tileNumber, 0);
+	shownTiles.assign (pixelGrid->tileNumber, 1);
+	updatedTiles.assign (pixelGrid->tileNumber, 0);
+	particlePixels.resize (particleNumber);
+	particleTiles.resize (particleNumber);
 }
 
 
@@ -233,64 +730,125 @@ void Cloud::setupColor ()
 	float bB = (particleColorMoy.b - particleColorMin.b) / (particleRatioMoy - particleRatioMin) - aB * (particleRatioMin + particleRatioMoy);
 	float cB = particleColorMin.b - aB * pow (particleRatioMin, 2) - bB * particleRatioMin;
 
-	for (int number = 0; number <= particleNumber * pixelResolution; number++)
+	// Densities are quantized by pixelResolution, or more coarsely when the
+	// table would not reach the saturated colour
+	float maxDensity = particleRatioMax * particleNumber / pixelNumber;
+	colorTableScale = pixelResolution;
+	if (maxDensity * colorTableScale > COLOR_TABLE_SIZE - 1) { colorTableScale = (COLOR_TABLE_SIZE - 1) / maxDensity; }
+
+	colorTable.resize (COLOR_TABLE_SIZE);
+	for (int number = 0; number < COLOR_TABLE_SIZE; number++)
 	{
-		float particleRatio = (float) number / (particleNumber * pixelResolution) * pixelNumber;
+		float particleRatio = (float) number / (particleNumber * colorTableScale) * pixelNumber;
+		int R, G, B;
 
 		if (particleRatio <= particleRatioMin) {
-			particleRedArray[number] = particleColorMin.r;
-			particleGreenArray[number] = particleColorMin.g;
-			particleBlueArray[number] = particleColorMin.b;
+			R = particleColorMin.r;
+			G = particleColorMin.g;
+			B = particleColorMin.b;
 		}
 		
 		else if (particleRatio >= particleRatioMax) {
-			particleRedArray[number] = particleColorMax.r;
-			particleGreenArray[number] = particleColorMax.g;
-			particleBlueArray[number] = particleColorMax.b;
+			R = particleColorMax.r;
+			G = particleColorMax.g;
+			B = particleColorMax.b;
 		}
 
 		else {
-			float R = aR * pow (particleRatio, 2) + bR * particleRatio + cR;
-			float G = aG * pow (particleRatio, 2) + bG * particleRatio + cG;
-			float B = aB * pow (particleRatio, 2) + bB * particleRatio + cB;
+			float r = aR * pow (particleRatio, 2) + bR * particleRatio + cR;
+			float g = aG * pow (particleRatio, 2) + bG * particleRatio + cG;
+			float b = aB * pow (particleRatio, 2) + bB * particleRatio + cB;
 
-			if (R < 0) { R = 0; } if (R > 255) { R = 255; }
-			if (G < 0) { G = 0; } if (G > 255) { G = 255; }
-			if (B < 0) { B = 0; } if (B > 255) { B = 255; }
-		
-			particleRedArray[number] = R;
-			particleGreenArray[number] = G;
-			particleBlueArray[number] = B;
+			if (r < 0) { r = 0; } if (r > 255) { r = 255; }
+			if (g < 0) { g = 0; } if (g > 255) { g = 255; }
+			if (b < 0) { b = 0; } if (b > 255) { b = 255; }
+
+			R = r; G = g; B = b;
 		}
+
+		// Fold the intensity in
+		R = std::min (255, (int) (R * pixelIntensity));
+		G = std::min (255, (int) (G * pixelIntensity));
+		B = std::min (255, (int) (B * pixelIntensity));
+		colorTable[number] = B | (G << 8) | (R << 16) | 0xff000000;
 	}
+
+	if (fixedPixels) { setupFixedColor (maxDensity); }
 }
 
 
-void Cloud::getTime()
+// Fixed-point densities saturate where colors do, with as many fractional
+// bits as possible; their table gives the colors of the float densities.
+void Cloud::setupFixedColor (float maxDensity)
 {
-	gettimeofday (&endTimer, NULL);
-	delay = (endTimer.tv_sec - startTimer.tv_sec) + (float) (endTimer.tv_usec - startTimer.tv_usec) / MILLION;
-	startTimer = endTimer;
+	float saturation = std::min (maxDensity, (COLOR_TABLE_SIZE - 1) / colorTableScale);
+	int shift = FIXED_MAX_SHIFT;
+	while (shift > 0 && saturation * (1 << shift) > 0xffff) { shift--; }
+
+	// Keep the current densities when the precision changes
+	if (fixedShift >= 0 && shift != fixedShift) {
+		for (int i = 0; i < pixelNumber; i++) {
+			if (shift > fixedShift) { fixedDensities[i] = std::min (0xffff, fixedDensities[i] << (shift - fixedShift)); }
+			else { fixedDensities[i] >>= fixedShift - shift; }
+		}
+	}
+	fixedShift = shift;
 
-	if (framePerSecond > 0) {
-		if (delay < 1./framePerSecond) {
-			struct timespec waitTime = {0};
-			waitTime.tv_sec = 0;
-			waitTime.tv_nsec = (1./framePerSecond - delay) * BILLION;
-			nanosleep (& waitTime, (struct timespec *) NULL);
-		} else { std::cout << "WARNING: not able to have " << framePerSecond << "fps" << std::endl; }
+	fixedColorTable.resize (COLOR_TABLE_SIZE);
+	for (int entry = 0; entry < COLOR_TABLE_SIZE; entry++) {
+		int number = (float) (entry << FIXED_TABLE_SHIFT) / (1 << fixedShift) * colorTableScale;
+		fixedColorTable[entry] = colorTable[std::min (number, COLOR_TABLE_SIZE - 1)];
 	}
+}
+
+
+// Rebuilds the colour table when one of its inputs changed since the last call
+void Cloud::updateColor ()
+{
+	float key [] = {
+		(float) particleColorMin.r, (float) particleColorMin.g, (float) particleColorMin.b,
+		(float) particleColorMoy.r, (float) particleColorMoy.g, (float) particleColorMoy.b,
+		(float) particleColorMax.r, (float) particleColorMax.g, (float) particleColorMax.b,
+		particleRatioMin, particleRatioMoy, particleRatioMax,
+		pixelIntensity, (float) pixelResolution, (float) particleNumber, (float) pixelNumber
+	};
+	int keySize = sizeof (key) / sizeof (float);
+
+	if (colorTableKey.size() == (unsigned int) keySize && std::equal (key, key + keySize, colorTableKey.begin())) { return; }
+	colorTableKey.assign (key, key + keySize);
+	setupColor ();
+	refreshPixels = true;
+}
 
+
+void Cloud::getTime()
+{
+	delay = pacer.step ();
 	frameNb++;
-	sumFrameNb++;
-	sumDelay += delay;
 
-	if (sumDelay >= 3)
+	if (pacer.report ())
 	{
-		graphicsFps = (int) (((float) sumFrameNb) / sumDelay);
-		std::cout << "GRAPHICS: " << graphicsFps << "fps" << std::endl;
-		sumDelay = 0;
-		sumFrameNb = 0;
+		graphicsFps = pacer.fps;
+		std::cout << "GRAPHICS: ";
+		pacer.writeReport (std::cout);
+		std::cout << ", particles " << sumParticleDelay * 1000 / pacer.reportFrameNb << "ms";
+		if (sumReorderNb > 0) { std::cout << ", reorder " << sumReorderDelay * 1000 / sumReorderNb << "ms every " << reorderFrequency << " frames"; }
+		if (physicsFrequency > 0) { std::cout << ", physics " << physicsFrequency << "Hz (" << sumDroppedStepNb << " dropped steps)"; }
+		if (presentFrames) {
+			std::cout << ", display " << (int) (presenter.presentedFrameNb.exchange (0) / pacer.reportDuration) << "fps (" << presenter.droppedFrameNb.exchange (0) << " dropped, " << presenter.lateFrameNb.exchange (0) << " late frames";
+			int droppedInputNb = presenter.droppedInputNb.exchange (0);
+			if (droppedInputNb > 0) { std::cout << ", " << droppedInputNb << " dropped events"; }
+			std::cout << ")";
+		}
+		if (recordParticles) {
+			std::cout << ", ";
+			recorder.writeReport (std::cout, pacer.reportDuration);
+		}
+		std::cout << std::endl;
+		sumParticleDelay = 0;
+		sumReorderDelay = 0;
+		sumReorderNb = 0;
+		sumDroppedStepNb = 0;
 	}
 
 	if (constantDelay > 0) { delay = constantDelay; }
@@ -306,14 +864,13 @@ void Cloud::initParticles (int type)
 	{
 		for (int i = 0; i < particleNumber; i++)
 		{
-			Particle *particle = &particles[i];
 			float rX = rand() % graphicsWidth;
 			float rY = rand() % graphicsHeight;
 
-			particle->x = rX / rDistance;
-			particle->y = rY / rDistance;
-			particle->dx = 0;
-			particle->dy = 0;
+			particles.x[i] = rX / rDistance;
+			particles.y[i] = rY / rDistance;
+			particles.dx[i] = 0;
+			particles.dy[i] = 0;
 		}	
 	}
 	break;
@@ -322,17 +879,16 @@ void Cloud::initParticles (int type)
 	{
 		for (int i = 0; i < particleNumber; i++)
 		{
-			Particle *particle = &particles[i];
 			float rX = rand() % graphicsWidth;
 			float rY = rand() % graphicsHeight;
 
-			particle->x = rX / rDistance;
-			particle->y = rY / rDistance;
+			particles.x[i] = rX / rDistance;
+			particles.y[i] = rY / rDistance;
 
 			float speed = ((double) rand() / (RAND_MAX)) * rDistance / 10000;
 			float angle = rand() % 360;
-			particle->dx = speed * cos (angle);
-			particle->dy = speed * sin (angle);
+			particles.dx[i] = speed * cos (angle);
+			particles.dy[i] = speed * sin (angle);
 		}	
 	}
 	break;
@@ -341,28 +897,26 @@ void Cloud::initParticles (int type)
 	{
 		int index = 0;
 		float bin = sqrt ((float) (graphicsWidth * graphicsHeight) / particleNumber);
-		for (float rX = 0; rX < graphicsWidth; rX += bin)
+		for (float rX = 0; rX < graphicsWidth && index < particleNumber; rX += bin)
 		{
-			for (float rY = 0; rY < graphicsHeight; rY += bin)
+			for (float rY = 0; rY < graphicsHeight && index < particleNumber; rY += bin)
 			{
-				Particle *particle = &particles[index++];
-				
-				particle->x = rX / rDistance;
-				particle->y = rY / rDistance;
-				particle->dx = 0;
-				particle->dy = 0;
+				particles.x[index] = rX / rDistance;
+				particles.y[index] = rY / rDistance;
+				particles.dx[index] = 0;
+				particles.dy[index] = 0;
+				index++;
 			}
 		}
 
 		for (int i = index; i < particleNumber; i++) {
-			Particle *particle = &particles[i];
 			float rX = rand() % graphicsWidth;
 			float rY = rand() % graphicsHeight;
 
-			particle->x = rX / rDistance;
-			particle->y = rY / rDistance;
-			particle->dx = 0;
-			particle->dy = 0;
+			particles.x[i] = rX / rDistance;
+			particles.y[i] = rY / rDistance;
+			particles.dx[i] = 0;
+			particles.dy[i] = 0;
 		}
 	}
 	break;
@@ -370,6 +924,21 @@ void Cloud::initParticles (int type)
 }
 
 
+// Sorts the particles by the Morton code of their pixel, so that particles
+// next to each other in the arrays are also close on the screen, which
+// makes both the force loop and the pixel scatter more cache friendly
+void Cloud::reorderParticles ()
+{
+	struct timeval reorderTimer;
+	gettimeofday (&reorderTimer, NULL);
+
+	particleSorter.sort (&workers, &particles, particleNumber, rDistance, graphicsWidth, graphicsHeight);
+
+	sumReorderDelay += getElapsedTime (reorderTimer);
+	sumReorderNb++;
+}
+
+
 void Cloud::updateBodies ()
 {
 	if (bodyList != newBodyList) {
@@ -406,127 +975,173 @@ void Cloud::updatePhysics ()
 	rGravitationFactor = gravitationFactor / 2;
 	rGravitationAngle = gravitationAngle * PI / 180;
 
+	activeBodyX.clear();
+	activeBodyY.clear();
+	activeBodyWeight.clear();
+
 	for (unsigned int j = 0; j < bodyList->size(); j++) {
 		Body *body = bodyList->at(j);
 		body->rX = body->x * rDistance;
 		body->rY = body->y * rDistance;
+
+		if (body->weight == 0) continue;
+		activeBodyX.push_back (body->x);
+		activeBodyY.push_back (body->y);
+		activeBodyWeight.push_back (body->weight);
 	}
 
 	rParticleDamping = particleDamping / particleWeight;
+
+	// Arguments of the vectorized integrator, shared by all workers
+	particleKernelArgs.x = particles.x;
+	particleKernelArgs.y = particles.y;
+	particleKernelArgs.dx = particles.dx;
+	particleKernelArgs.dy = particles.dy;
+	particleKernelArgs.bodyNumber = activeBodyWeight.size();
+	particleKernelArgs.bodyX = activeBodyX.data();
+	particleKernelArgs.bodyY = activeBodyY.data();
+	particleKernelArgs.bodyWeight = activeBodyWeight.data();
+	particleKernelArgs.damping = rParticleDamping;
+	particleKernelArgs.delay = rDelay;
+	particleKernelArgs.maxSpeed = maxParticleSpeed;
+	particleKernelArgs.forceLaw = getForceLaw (gravitationFactor);
+	particleKernelArgs.exponent = - rGravitationFactor - 0.5;
+	particleKernelArgs.cosAngle = cos (rGravitationAngle);
+	particleKernelArgs.sinAngle = sin (rGravitationAngle);
+	particleKernelArgs.zeroX = (particleKernelArgs.forceLaw == CONSTANT_FORCE) ? particleKernelArgs.cosAngle : 0;
+	particleKernelArgs.zeroY = (particleKernelArgs.forceLaw == CONSTANT_FORCE) ? particleKernelArgs.sinAngle : 0;
+	particleKernelArgs.gravitationFactor = rGravitationFactor;
+	particleKernelArgs.gravitationAngle = rGravitationAngle;
+
+	// Specializations for the current parameters, so that the particle loop has no mode branches
+	if (fastPhysics) { particleKernel = getParticleKernel (particleKernelId, particleKernelArgs.forceLaw, particleKernelArgs.bodyNumber); }
+	else { particleKernel = &integrateParticlesExact; }
+
+	switch (borderMode) {
+	case MIRROR_BORDERS :
+		particleDrawer = binning ? &Cloud::drawParticles<MIRROR_BORDERS, BIN_PARTICLES> : &Cloud::drawParticles<MIRROR_BORDERS, COUNT_PARTICLES>;
+		particleMover = &Cloud::drawParticles<MIRROR_BORDERS, MOVE_PARTICLES>;
+		break;
+	case CYCLIC_BORDERS :
+		particleDrawer = binning ? &Cloud::drawParticles<CYCLIC_BORDERS, BIN_PARTICLES> : &Cloud::drawParticles<CYCLIC_BORDERS, COUNT_PARTICLES>;
+		particleMover = &Cloud::drawParticles<CYCLIC_BORDERS, MOVE_PARTICLES>;
+		break;
+	default :
+		particleDrawer = binning ? &Cloud::drawParticles<NO_BORDERS, BIN_PARTICLES> : &Cloud::drawParticles<NO_BORDERS, COUNT_PARTICLES>;
+		particleMover = &Cloud::drawParticles<NO_BORDERS, MOVE_PARTICLES>;
+		break;
+	}
 }
 
 
 void Cloud::computeParticles ()
 {
-	ArgStruct **args = new ArgStruct *[threadNumber];
-
-	// CLEAN OR CLEAR PIXELS
-	if (pixelCleaningRate == 0) {
+	// MOVE PARTICLES
 #if VERBOSE
-		std::cout << "BEGIN clear pixels" << std::endl;
+	std::cout << "BEGIN move particles" << std::endl;
 #endif
-	
-		for (int i = 0; i < threadNumber; i++)
-		{
-			args[i] = new ArgStruct (this, i);
-			int rc = pthread_create (&threads[i], NULL, &Cloud::clearPixels, (void *) args[i]);
-			if (rc) { std::cout << "Error: Unable to create thread " << rc << std::endl; exit(-1); }
-		}
 
-		for (int i = 0; i < threadNumber; i++)
-		{
-			int rc = pthread_join (threads[i], &status);
-			if (rc) { std::cout << "Error: Unable to join thread " << rc << std::endl; exit(-1); }
-			delete args[i];
-		}
+	workers.run (&Cloud::updateAndMoveParticles, this);
 
 #if VERBOSE
-		std::cout << "-> END clear pixels" << std::endl;
+	std::cout << "-> END move particles" << std::endl;
 #endif
-	}
 
-	else {
-#if VERBOSE
-		std::cout << "BEGIN clean pixels" << std::endl;
-#endif
-	
-		for (int i = 0; i < threadNumber; i++)
-		{
-			args[i] = new ArgStruct (this, i);
-			int rc = pthread_create (&threads[i], NULL, &Cloud::cleanPixels, (void *) args[i]);
-			if (rc) { std::cout << "Error: Unable to create thread " << rc << std::endl; exit(-1); }
-		}
+	updateColor ();
+	if (renderTexture) { lockTexture (); }
+	frameRendered = true;
 
-		for (int i = 0; i < threadNumber; i++)
-		{
-			int rc = pthread_join (threads[i], &status);
-			if (rc) { std::cout << "Error: Unable to join thread " << rc << std::endl; exit(-1); }
-			delete args[i];
-		}
-	}
-	
+	// Without cleaning, tiles that hold no particle now nor at the previous
+	// frame already show a zero density. Changing the colors or leaving the
+	// cleaning mode makes every pixel out of date, and so does rendering into
+	// a frame that does not hold the previous one.
+	sparseFrame = sparsePixels && pixelCleaningRate <= 0 && !refreshPixels && persistentFrame;
+	refreshPixels = (pixelCleaningRate > 0);
+	if (!sparseFrame) { std::fill (shownTiles.begin(), shownTiles.end(), 1); }
+
+	// SORT PARTICLES BY TILE AND ACCUMULATE THEM TILE BY TILE
+	if (binning) {
 #if VERBOSE
-	std::cout << "-> END clear pixels" << std::endl;
+		std::cout << "BEGIN bin particles" << std::endl;
 #endif
 
-	// MOVE PARTICLES
+		tileBins.computeOffsets ();
+		workers.run (&Cloud::binParticles, this);
+
+		// Bands are cleaned and applied to the frame as soon as they are counted
+		if (fusedPixels) { workers.run (&Cloud::drawBands, this); }
+		else { workers.run (&Cloud::accumulateTiles, this); }
+
 #if VERBOSE
-	std::cout << "BEGIN move particles" << std::endl;
+		std::cout << "-> END bin particles" << std::endl;
 #endif
-
-	for (int i = 0; i < threadNumber; i++)
-	{
-		args[i] = new ArgStruct (this, i);
-		int rc = pthread_create (&threads[i], NULL, &Cloud::updateAndMoveParticles, (void *) args[i]);
-		if (rc) { std::cout << "Error: Unable to create thread " << rc << std::endl; exit(-1); }
 	}
 
-	for (int i = 0; i < threadNumber; i++)
-	{
-		int rc = pthread_join (threads[i], &status);
-		if (rc) { std::cout << "Error: Unable to join thread " << rc << std::endl; exit(-1); }
-		delete args[i];
-	}		
-	
+	// MERGE, CLEAN AND APPLY PIXELS TO FRAME
+	if (!fusedPixels) {
 #if VERBOSE
-	std::cout << "-> END move particles" << std::endl;
+		std::cout << "BEGIN apply pixels" << std::endl;
 #endif
 
-	// APPLY PIXELS TO FRAME
+		workers.run (&Cloud::applyPixels, this);
+
 #if VERBOSE
-	std::cout << "BEGIN apply pixels" << std::endl;
+		std::cout << "-> END apply pixels" << std::endl;
 #endif
-
-	for (int i = 0; i < threadNumber; i++)
-	{
-		args[i] = new ArgStruct (this, i);
-		int rc = pthread_create (&threads[i], NULL, &Cloud::applyPixels, (void *) args[i]);
-		if (rc) { std::cout << "Error: Unable to create thread " << rc << std::endl; exit(-1); }
 	}
+}
 
-	for (int i = 0; i < threadNumber; i++)
-	{
-		int rc = pthread_join (threads[i], &status);
-		if (rc) { std::cout << "Error: Unable to join thread " << rc << std::endl; exit(-1); }
-		delete args[i];
+
+// Fixed timestep physics: the time elapsed since the last frame is consumed
+// by steps of 1 / physicsFrequency, whatever the display rate. Only the last
+// step of a frame draws the particles, with a fading that covers all steps.
+// When more than maxPhysicsSteps are due, the remaining time is dropped, which
+// slows the simulation down instead of making it explode. When no step is due,
+// the frame keeps showing the latest state.
+void Cloud::stepParticles ()
+{
+	physicsTime += delay;
+	int stepNumber = physicsTime * physicsFrequency;
+
+	if (stepNumber > maxPhysicsSteps) {
+		sumDroppedStepNb += stepNumber - maxPhysicsSteps;
+		stepNumber = maxPhysicsSteps;
+		physicsTime = 0;
 	}
+	else { physicsTime -= stepNumber / physicsFrequency; }
 
-#if VERBOSE
-	std::cout << "-> END apply pixels" << std::endl;
-#endif
+	if (stepNumber == 0) { return; }
+
+	float frameDelay = delay;
+	delay = 1. / physicsFrequency;
+	updatePhysics ();
+
+	for (int step = 1; step < stepNumber; step++) { workers.run (&Cloud::moveParticles, this); }
+
+	if (pixelCleaningRate > 0) {
+		rPixelCleaningRate = pow (rPixelCleaningRate, stepNumber);
+		rPixelDrawingRate = 1 - rPixelCleaningRate;
+	}
 
-	delete [] args;
+	computeParticles ();
+	delay = frameDelay;
 }
 
 
+// Overlays are composited over the frame itself. A persistent frame is
+// restored by restoreFrame once shown, as it may be kept by the sparse
+// conversion or when no physics step is due. Other frames are rewritten at
+// each frame, and are only shown once rendered.
 void Cloud::computeFrame ()
 {
-	finalFrame = frame->clone();
+	if (!persistentFrame && !frameRendered) { return; }
+	finalFrame = *frame;
+	overlay.clear ();
 
 	if (displayBodies) {
 		for (unsigned int j = 0; j < bodyList->size(); j++) {
 			Body *body = bodyList->at(j);
-			cv::circle (finalFrame, cv::Point (body->rX, body->rY), 1, cv::Scalar(250,200,100), 3);
+			overlay.addMark (cv::Point (body->rX, body->rY), cv::Scalar (250, 200, 100, 255));
 		}
 	}
 
@@ -542,47 +1157,45 @@ void Cloud::computeFrame ()
 			ss.str("");
 			ss << parameters[parameter].str << " = " << getParameter (parameter);
 			str = ss.str();
-			cv::putText (finalFrame, str, cv::Point(x,y), cv::FONT_HERSHEY_PLAIN, 1, cv::Scalar(255,255,255), 2);
+			overlay.addText (str, cv::Point (x, y));
 			y += 20;
 		}
 		
 		y += 10;
 
 		ss.str("");
-		if (borderMode == MIRROR_BORDERS) { ss << "[b] borders = TRUE"; } else { ss << "[b] borders = FALSE"; }
+		if (borderMode == MIRROR_BORDERS) { ss << "[b] borders = MIRROR"; } else if (borderMode == CYCLIC_BORDERS) { ss << "[b] borders = CYCLIC"; } else { ss << "[b] borders = FALSE"; }
 		str = ss.str();
-		cv::putText (finalFrame, str, cv::Point(x,y), cv::FONT_HERSHEY_PLAIN, 1, cv::Scalar(255,255,255), 2);
+		overlay.addText (str, cv::Point (x, y));
 		y += 20;
 
 		ss.str("");
 		ss << "mouse = (" << mouseX << "," << mouseY << ")";
 		str = ss.str();
-		cv::putText (finalFrame, str, cv::Point(x,y), cv::FONT_HERSHEY_PLAIN, 1, cv::Scalar(255,255,255), 2);
+		overlay.addText (str, cv::Point (x, y));
 		y += 30;
 		
 
 		ss.str("");
 		ss << "windows = " << graphicsWidth << " x " << graphicsHeight;
 		str = ss.str();
-		cv::putText (finalFrame, str, cv::Point(x,y), cv::FONT_HERSHEY_PLAIN, 1, cv::Scalar(255,255,255), 2);
+		overlay.addText (str, cv::Point (x, y));
 		y += 20;
 
 		ss.str("");
 		ss << "particles = " << particleNumber;
 		str = ss.str();
-		cv::putText (finalFrame, str, cv::Point(x,y), cv::FONT_HERSHEY_PLAIN, 1, cv::Scalar(255,255,255), 2);
+		overlay.addText (str, cv::Point (x, y));
 		y += 20;
 
 		ss.str("");
 		ss << "threads = " << threadNumber;
 		str = ss.str();
-		cv::putText (finalFrame, str, cv::Point(x,y), cv::FONT_HERSHEY_PLAIN, 1, cv::Scalar(255,255,255), 2);
+		overlay.addText (str, cv::Point (x, y));
 		y += 20;
 
 
-		struct timeval drawTimer;
-		gettimeofday (&drawTimer, NULL);
-		int seconds = floor ((drawTimer.tv_sec - parameterTimer.tv_sec) + (float) (drawTimer.tv_usec - parameterTimer.tv_usec) / MILLION);
+		int seconds = floor (FramePacer::getTime() - parameterStartTime);
 		int hours = floor (seconds / 3600);
 		seconds = seconds % 3600;
 		int minutes = floor (seconds / 60);
@@ -591,19 +1204,19 @@ void Cloud::computeFrame ()
 		ss.str("");
 		ss << "time = " << std::setfill('0') << std::setw(2) << hours << ":" << std::setw(2) << minutes << ":" << std::setw(2) << seconds;
 		str = ss.str();
-		cv::putText (finalFrame, str, cv::Point(x,y), cv::FONT_HERSHEY_PLAIN, 1, cv::Scalar(255,255,255), 2);
+		overlay.addText (str, cv::Point (x, y));
 		y += 20;
 			
 		ss.str("");
 		ss << "frame = " << frameNb;
 		str = ss.str();
-		cv::putText (finalFrame, str, cv::Point(x,y), cv::FONT_HERSHEY_PLAIN, 1, cv::Scalar(255,255,255), 2);
+		overlay.addText (str, cv::Point (x, y));
 		y += 20;
 
 		ss.str("");
 		ss << "graphics = " << graphicsFps << "fps";
 		str = ss.str();
-		cv::putText (finalFrame, str, cv::Point(x,y), cv::FONT_HERSHEY_PLAIN, 1, cv::Scalar(255,255,255), 2);
+		overlay.addText (str, cv::Point (x, y));
 		y += 20;
 
 	}
@@ -622,269 +1235,344 @@ void Cloud::computeFrame ()
 			ss.str("");
 			ss << "(" << body->x << ", " << body->y << ") -> " << body->weight;
 			str = ss.str();
-			cv::putText (finalFrame, str, cv::Point(x,y), cv::FONT_HERSHEY_PLAIN, 1, cv::Scalar(255,255,255), 2);
+			overlay.addText (str, cv::Point (x, y));
 			y += 20;
 		}
 	}
+
+	overlay.apply (finalFrame, persistentFrame);
 }
 
 
+void Cloud::restoreFrame () { overlay.restore (finalFrame); }
+
+
+// With the presenter, the frame is handed over and drawing goes on in the next
+// back buffer, and the input polled by the presenter is handled. Otherwise
+// the frame is presented here, after which the input is polled.
 void Cloud::displayFrame ()
 {
 	unsigned char *texture_data = NULL;
 	int texture_pitch = 0;
 
-	SDL_LockTexture (texture, 0, (void **) &texture_data, &texture_pitch);
-	memcpy (texture_data, (void *) finalFrame.data, finalFrame.cols * finalFrame.rows * finalFrame.channels());
-	SDL_UnlockTexture (texture);
-	
-	SDL_RenderClear (renderer);
-	SDL_RenderCopy (renderer, texture, NULL, NULL);
-	SDL_RenderPresent (renderer);
+	if (presentFrames) {
+		if (frameRendered) {
+			presenter.publish ();
+			*frame = presenter.buffers.getBack ();
+			frameRendered = false;
+		}
+
+		InputEvent input;
+		while (presenter.inputs.pop (input)) { handleEvent (input.event, input.keyboard); }
+		return;
+	}
+
+	// Without a new frame in the texture, the window keeps the previous one
+	if (renderTexture) {
+		if (textureLocked) {
+			SDL_UnlockTexture (texture);
+			textureLocked = false;
+			SDL_RenderClear (renderer);
+			SDL_RenderCopy (renderer, texture, NULL, NULL);
+			SDL_RenderPresent (renderer);
+		}
+	}
+
+	else {
+		SDL_LockTexture (texture, 0, (void **) &texture_data, &texture_pitch);
+		int rowSize = finalFrame.cols * finalFrame.channels();
+		for (int y = 0; y < finalFrame.rows; y++) { memcpy (texture_data + y * texture_pitch, finalFrame.ptr<uchar>(y), rowSize); }
+		SDL_UnlockTexture (texture);
+
+		SDL_RenderClear (renderer);
+		SDL_RenderCopy (renderer, texture, NULL, NULL);
+		SDL_RenderPresent (renderer);
+	}
+	frameRendered = false;
+
+	while (SDL_PollEvent (&event)) { handleEvent (event, SDL_GetKeyboardState (NULL)); }
+}
 
-	const Uint8 *keyboard = SDL_GetKeyboardState(NULL);
-	while (SDL_PollEvent (&event))
+
+void Cloud::handleEvent (const SDL_Event &event, const Uint8 *keyboard)
+{
+	switch (event.type)
 	{
-		switch (event.type)
+		// Mouse events
+	case SDL_MOUSEBUTTONDOWN :
+		switch (event.button.button)
 		{
-			// Mouse events
-		case SDL_MOUSEBUTTONDOWN :
-			switch (event.button.button)
-			{
-			case SDL_BUTTON_LEFT :
-				if (mouseBody->weight != 0) { events.interrupt (new InstantaneousVariation (this, BODY_WEIGHT, 0)); }
-				else { events.interrupt (new InstantaneousVariation (this, BODY_WEIGHT, 1)); }
-				break;
-					
-			case SDL_BUTTON_RIGHT :
-				if (mouseBody->weight != 0) { events.interrupt (new InstantaneousVariation (this, BODY_WEIGHT, 0)); }
-				else { events.interrupt (new InstantaneousVariation (this, BODY_WEIGHT, 2)); }
-				break;
-
-			case SDL_BUTTON_MIDDLE :
-				for (int p = 0; p < PARAMETER_NUMBER; p++) {
-					if (keyboard[parameters[p].scancode]) { setParameter (p, parameters[p].moy); }
-				}
-				break;
-			}
+		case SDL_BUTTON_LEFT :
+			if (mouseBody->weight != 0) { events.interrupt (new InstantaneousVariation (this, BODY_WEIGHT, 0)); }
+			else { events.interrupt (new InstantaneousVariation (this, BODY_WEIGHT, 1)); }
 			break;
 				
-		case SDL_MOUSEMOTION:
-			mouseX = event.motion.x;
-			mouseY = event.motion.y;
-			setParameter (BODY_X, ((float) mouseX) / rDistance);
-			setParameter (BODY_Y, ((float) mouseY) / rDistance);
+		case SDL_BUTTON_RIGHT :
+			if (mouseBody->weight != 0) { events.interrupt (new InstantaneousVariation (this, BODY_WEIGHT, 0)); }
+			else { events.interrupt (new InstantaneousVariation (this, BODY_WEIGHT, 2)); }
 			break;
 
-		case SDL_MOUSEWHEEL:
+		case SDL_BUTTON_MIDDLE :
 			for (int p = 0; p < PARAMETER_NUMBER; p++) {
-				if (keyboard[parameters[p].scancode]) {
-					float value = getParameter (p);
+				if (keyboard[parameters[p].scancode]) { setParameter (p, parameters[p].moy); }
+			}
+			break;
+		}
+		break;
+			
+	case SDL_MOUSEMOTION:
+		mouseX = event.motion.x;
+		mouseY = event.motion.y;
+		setParameter (BODY_X, ((float) mouseX) / rDistance);
+		setParameter (BODY_Y, ((float) mouseY) / rDistance);
+		break;
 
-					if (event.wheel.y < 0) {
-						value -= parameters[p].ssub * event.wheel.y;
-						if (value < parameters[p].min) { value = parameters[p].min; }
-					}
-					else {
-						value += parameters[p].aadd * event.wheel.y;
-						if (value > parameters[p].max) { value = parameters[p].max; }
-					}
-					setParameter (p, value);
+	case SDL_MOUSEWHEEL:
+		for (int p = 0; p < PARAMETER_NUMBER; p++) {
+			if (keyboard[parameters[p].scancode]) {
+				float value = getParameter (p);
+
+				if (event.wheel.y < 0) {
+					value -= parameters[p].ssub * event.wheel.y;
+					if (value < parameters[p].min) { value = parameters[p].min; }
+				}
+				else {
+					value += parameters[p].aadd * event.wheel.y;
+					if (value > parameters[p].max) { value = parameters[p].max; }
 				}
+				setParameter (p, value);
 			}
-			break;
+		}
+		break;
 
-			// Keyboard events
-		case SDL_KEYDOWN:
-			// SDL_Log ("Physical %s key acting as %s key",
-			// 		 SDL_GetScancodeName (event.key.keysym.scancode),
-			// 		 SDL_GetKeyName (event.key.keysym.sym)
-			// 	);
+		// Keyboard events
+	case SDL_KEYDOWN:
+		// SDL_Log ("Physical %s key acting as %s key",
+		// 		 SDL_GetScancodeName (event.key.keysym.scancode),
+		// 		 SDL_GetKeyName (event.key.keysym.sym)
+		// 	);
 
-			switch (event.key.keysym.scancode)
-			{
-			case SDL_SCANCODE_ESCAPE:
-				stop = true;
-				break;
+		switch (event.key.keysym.scancode)
+		{
+		case SDL_SCANCODE_ESCAPE:
+			stop = true;
+			break;
 
-			case SDL_SCANCODE_KP_ENTER:
-				displayParameters = !displayParameters;
-				break;				
+		case SDL_SCANCODE_KP_ENTER:
+			displayParameters = !displayParameters;
+			break;				
 
-			case SDL_SCANCODE_RETURN : 
-				initParticles (UNIFORM_INIT);
-				break;
-				
-			case SDL_SCANCODE_BACKSPACE : 
-				initParticles (RANDOM_INIT);
-				break;
-				
-			case SDL_SCANCODE_EQUALS : 
-				initParticles (DYNAMIC_INIT);
-				break;
-				
-			case SDL_SCANCODE_B :
-				if (borderMode == MIRROR_BORDERS) { borderMode = NO_BORDERS; } else { borderMode = MIRROR_BORDERS; }
-				break;
+		case SDL_SCANCODE_RETURN : 
+			initParticles (UNIFORM_INIT);
+			break;
+			
+		case SDL_SCANCODE_BACKSPACE : 
+			initParticles (RANDOM_INIT);
+			break;
+			
+		case SDL_SCANCODE_EQUALS : 
+			initParticles (DYNAMIC_INIT);
+			break;
+			
+		case SDL_SCANCODE_B :
+			if (borderMode == MIRROR_BORDERS) { borderMode = CYCLIC_BORDERS; } else if (borderMode == CYCLIC_BORDERS) { borderMode = NO_BORDERS; } else { borderMode = MIRROR_BORDERS; }
+			break;
 
-				// Control intensity
-			case SDL_SCANCODE_DELETE :
-				if (pixelIntensity > 0) { events.interrupt (new LinearVariation (this, PIXEL_INTENSITY, 0, 5)); }
-				else { events.interrupt (new LinearVariation (this, PIXEL_INTENSITY, 1, 4)); }
-				break;
+			// Control intensity
+		case SDL_SCANCODE_DELETE :
+			if (pixelIntensity > 0) { events.interrupt (new LinearVariation (this, PIXEL_INTENSITY, 0, 5)); }
+			else { events.interrupt (new LinearVariation (this, PIXEL_INTENSITY, 1, 4)); }
+			break;
 
-			case SDL_SCANCODE_RIGHTBRACKET : events.interrupt (new LinearVariation (this, PIXEL_INTENSITY, 0, 1)); break;
-			case SDL_SCANCODE_BACKSLASH : events.interrupt (new LinearVariation (this, PIXEL_INTENSITY, 1, 0.1)); break;
+		case SDL_SCANCODE_RIGHTBRACKET : events.interrupt (new LinearVariation (this, PIXEL_INTENSITY, 0, 1)); break;
+		case SDL_SCANCODE_BACKSLASH : events.interrupt (new LinearVariation (this, PIXEL_INTENSITY, 1, 0.1)); break;
 
-				// Control parameter sequences
-			case SDL_SCANCODE_GRAVE :
-			{
-				openInputParameterFile ("static-cells-input-sequence.csv");
-				openOutputParameterFile ("static-cells-output-sequence.csv");
-				readParameters = true;
-				recordParameters = true;
+			// Control parameter sequences
+		case SDL_SCANCODE_GRAVE :
+		{
+			openInputParameterFile ("static-cells-input-sequence.csv");
+			openOutputParameterFile ("static-cells-output-sequence.csv");
+			readParameters = true;
+			recordParameters = true;
+		}
+		break;
+		
+		case SDL_SCANCODE_0 : case SDL_SCANCODE_1 : case SDL_SCANCODE_2 : case SDL_SCANCODE_3 : case SDL_SCANCODE_4 : case SDL_SCANCODE_5 : case SDL_SCANCODE_6 : case SDL_SCANCODE_7 : case SDL_SCANCODE_8 : case SDL_SCANCODE_9 :
+		{
+			std::string filename;
+			switch (event.key.keysym.scancode) {
+			case SDL_SCANCODE_0 : filename = "static-cells-parameter-sequence-0.csv"; break;
+			case SDL_SCANCODE_1 : filename = "static-cells-parameter-sequence-1.csv"; break;
+			case SDL_SCANCODE_2 : filename = "static-cells-parameter-sequence-2.csv"; break;
+			case SDL_SCANCODE_3 : filename = "static-cells-parameter-sequence-3.csv"; break;
+			case SDL_SCANCODE_4 : filename = "static-cells-parameter-sequence-4.csv"; break;
+			case SDL_SCANCODE_5 : filename = "static-cells-parameter-sequence-5.csv"; break;
+			case SDL_SCANCODE_6 : filename = "static-cells-parameter-sequence-6.csv"; break;
+			case SDL_SCANCODE_7 : filename = "static-cells-parameter-sequence-7.csv"; break;
+			case SDL_SCANCODE_8 : filename = "static-cells-parameter-sequence-8.csv"; break;
+			case SDL_SCANCODE_9 : filename = "static-cells-parameter-sequence-9.csv"; break;
+			default : break;
 			}
+
+			if (recordParameters) {
+				openOutputParameterFile (filename);
+				writeOutputParameterFile ();
+			}
+			else if (readParameters) { openInputParameterFile (filename); }
+			break;
+		}
+
+		case SDL_SCANCODE_PAGEUP :
+		{
+			double currentTimestamp = FramePacer::getTime() - parameterStartTime;
+
+			std::stringstream ss;
+			ss.str("");
+			ss << "particle-positions-" << currentTimestamp << (textSnapshots ? TEXT_SNAPSHOT_EXTENSION : SNAPSHOT_EXTENSION);
+			captureParticlePositions (ss.str(), true);
+		}
+		break;
+		
+		case SDL_SCANCODE_PAGEDOWN : readParticlePositions (ParticleSnapshot::find ("particle-positions")); break;
+
+			// Control particle number and resolution
+		case SDL_SCANCODE_F5 : resize (particleNumber / 2, graphicsWidth, graphicsHeight); break;
+		case SDL_SCANCODE_F6 : resize (particleNumber * 2, graphicsWidth, graphicsHeight); break;
+		case SDL_SCANCODE_F7 : resize (particleNumber, graphicsWidth / 2, graphicsHeight / 2); break;
+		case SDL_SCANCODE_F8 : resize (particleNumber, graphicsWidth * 2, graphicsHeight * 2); break;
+
+			// Control body weight
+		case SDL_SCANCODE_SPACE :
+			if (mouseBody->weight != 0) { events.interrupt (new InstantaneousVariation (this, BODY_WEIGHT, 0)); }
+			else { events.interrupt (new InstantaneousVariation (this, BODY_WEIGHT, 0.5)); }
+			break;
+
+		case SDL_SCANCODE_LEFT :
+			events.interrupt (new InstantaneousVariation (this, BODY_WEIGHT, 0.75));
 			break;
-			
-			case SDL_SCANCODE_0 : case SDL_SCANCODE_1 : case SDL_SCANCODE_2 : case SDL_SCANCODE_3 : case SDL_SCANCODE_4 : case SDL_SCANCODE_5 : case SDL_SCANCODE_6 : case SDL_SCANCODE_7 : case SDL_SCANCODE_8 : case SDL_SCANCODE_9 :
-			{
-				std::string filename;
-				switch (event.key.keysym.scancode) {
-				case SDL_SCANCODE_0 : filename = "static-cells-parameter-sequence-0.csv"; break;
-				case SDL_SCANCODE_1 : filename = "static-cells-parameter-sequence-1.csv"; break;
-				case SDL_SCANCODE_2 : filename = "static-cells-parameter-sequence-2.csv"; break;
-				case SDL_SCANCODE_3 : filename = "static-cells-parameter-sequence-3.csv"; break;
-				case SDL_SCANCODE_4 : filename = "static-cells-parameter-sequence-4.csv"; break;
-				case SDL_SCANCODE_5 : filename = "static-cells-parameter-sequence-5.csv"; break;
-				case SDL_SCANCODE_6 : filename = "static-cells-parameter-sequence-6.csv"; break;
-				case SDL_SCANCODE_7 : filename = "static-cells-parameter-sequence-7.csv"; break;
-				case SDL_SCANCODE_8 : filename = "static-cells-parameter-sequence-8.csv"; break;
-				case SDL_SCANCODE_9 : filename = "static-cells-parameter-sequence-9.csv"; break;
-				default : break;
-				}
 
-				if (recordParameters) {
-					openOutputParameterFile (filename);
-					writeOutputParameterFile ();
+		case SDL_SCANCODE_UP :
+			events.interrupt (new InstantaneousVariation (this, BODY_WEIGHT, 1.));
+			break;
+
+		case SDL_SCANCODE_DOWN :
+			events.interrupt (new InstantaneousVariation (this, BODY_WEIGHT, 1.));
+			break;
+
+		case SDL_SCANCODE_RIGHT :
+			events.interrupt (new InstantaneousVariation (this, BODY_WEIGHT, 1.5));
+			break;
+
+			// Control all parameters
+		case SDL_SCANCODE_KP_PERIOD :
+			for (int p = 0; p < PARAMETER_NUMBER; p++) {
+				if (keyboard[parameters[p].scancode]) {
+					setParameter (p, parameters[p].min);
 				}
-				else if (readParameters) { openInputParameterFile (filename); }
-				break;
 			}
+			break;
 
-			case SDL_SCANCODE_PAGEUP :
-			{
-				struct timeval writeTimer;
-				gettimeofday (&writeTimer, NULL);
-				double currentTimestamp = (writeTimer.tv_sec - parameterTimer.tv_sec) + (float) (writeTimer.tv_usec - parameterTimer.tv_usec) / MILLION;
-
-				std::stringstream ss;
-				ss.str("");
-				ss << "particle-positions-" << currentTimestamp << ".csv";
-				recordParticlePositions (ss.str());
+		case SDL_SCANCODE_KP_0 :
+			for (int p = 0; p < PARAMETER_NUMBER; p++) {
+				if (keyboard[parameters[p].scancode]) {
+					setParameter (p, parameters[p].moy);
+				}
 			}
 			break;
-			
-			case SDL_SCANCODE_PAGEDOWN : readParticlePositions ("particle-positions.csv"); break;
-
-				// Control body weight
-			case SDL_SCANCODE_SPACE :
-				if (mouseBody->weight != 0) { events.interrupt (new InstantaneousVariation (this, BODY_WEIGHT, 0)); }
-				else { events.interrupt (new InstantaneousVariation (this, BODY_WEIGHT, 0.5)); }
-				break;
-
-			case SDL_SCANCODE_LEFT :
-				events.interrupt (new InstantaneousVariation (this, BODY_WEIGHT, 0.75));
-				break;
-
-			case SDL_SCANCODE_UP :
-				events.interrupt (new InstantaneousVariation (this, BODY_WEIGHT, 1.));
-				break;
-
-			case SDL_SCANCODE_DOWN :
-				events.interrupt (new InstantaneousVariation (this, BODY_WEIGHT, 1.));
-				break;
-
-			case SDL_SCANCODE_RIGHT :
-				events.interrupt (new InstantaneousVariation (this, BODY_WEIGHT, 1.5));
-				break;
-
-				// Control all parameters
-			case SDL_SCANCODE_KP_PERIOD :
-				for (int p = 0; p < PARAMETER_NUMBER; p++) {
-					if (keyboard[parameters[p].scancode]) {
-						setParameter (p, parameters[p].min);
-					}
-				}
-				break;
 
-			case SDL_SCANCODE_KP_0 :
-				for (int p = 0; p < PARAMETER_NUMBER; p++) {
-					if (keyboard[parameters[p].scancode]) {
-						setParameter (p, parameters[p].moy);
+		case SDL_SCANCODE_KP_PLUS : case SDL_SCANCODE_KP_9 : case SDL_SCANCODE_KP_MULTIPLY : case SDL_SCANCODE_KP_MINUS :
+			for (int p = 0; p < PARAMETER_NUMBER; p++) {
+				if (keyboard[parameters[p].scancode]) {
+					float value = getParameter (p);
+						
+					switch (event.key.keysym.scancode)
+					{
+					case SDL_SCANCODE_KP_PLUS :     value += parameters[p].aadd; break;
+					case SDL_SCANCODE_KP_9 :        value += parameters[p].add; break;
+					case SDL_SCANCODE_KP_MULTIPLY : value += parameters[p].sub; break;
+					case SDL_SCANCODE_KP_MINUS :    value += parameters[p].ssub; break;
+					default : break;
 					}
-				}
-				break;
-
-			case SDL_SCANCODE_KP_PLUS : case SDL_SCANCODE_KP_9 : case SDL_SCANCODE_KP_MULTIPLY : case SDL_SCANCODE_KP_MINUS :
-				for (int p = 0; p < PARAMETER_NUMBER; p++) {
-					if (keyboard[parameters[p].scancode]) {
-						float value = getParameter (p);
-							
-						switch (event.key.keysym.scancode)
-						{
-						case SDL_SCANCODE_KP_PLUS :     value += parameters[p].aadd; break;
-						case SDL_SCANCODE_KP_9 :        value += parameters[p].add; break;
-						case SDL_SCANCODE_KP_MULTIPLY : value += parameters[p].sub; break;
-						case SDL_SCANCODE_KP_MINUS :    value += parameters[p].ssub; break;
-						default : break;
-						}
-							
-						switch (event.key.keysym.scancode)
-						{
-						case SDL_SCANCODE_KP_PLUS : case SDL_SCANCODE_KP_9 :         if (value > parameters[p].max) { value = parameters[p].max; } break;
-						case SDL_SCANCODE_KP_MULTIPLY : case SDL_SCANCODE_KP_MINUS : if (value < parameters[p].min) { value = parameters[p].min; } break;
-						default : break;
-						}
-							
-						setParameter (p, value);
+						
+					switch (event.key.keysym.scancode)
+					{
+					case SDL_SCANCODE_KP_PLUS : case SDL_SCANCODE_KP_9 :         if (value > parameters[p].max) { value = parameters[p].max; } break;
+					case SDL_SCANCODE_KP_MULTIPLY : case SDL_SCANCODE_KP_MINUS : if (value < parameters[p].min) { value = parameters[p].min; } break;
+					default : break;
 					}
+						
+					setParameter (p, value);
 				}
-				break;
-
-				default : break;
 			}
 			break;
-				
-			// Other events
-		case SDL_QUIT:
-			stop = true;
-			break;
+
+			default : break;
 		}
+		break;
+			
+		// Other events
+	case SDL_QUIT:
+		stop = true;
+		break;
 	}
 }
 
 
 void Cloud::recordFrame ()
 {
+	// Recorded before displayFrame hands the frame over
+	cv::Mat &recorded = getRecordedFrame();
+	if (recorded.empty()) { return; }
+
 	std::string frameStr = std::string (5 - floor(log10(frameNb)), '0') + std::to_string(frameNb);
-	std::string filename = outputFilename + "-" + frameStr + ".png";
-	std::vector<int> params;
-	params.push_back (CV_IMWRITE_PNG_COMPRESSION);
-	params.push_back (0);
-	cv::imwrite (filename, finalFrame, params);
-	std::cout << "SCREENSHOT: " << filename << std::endl;
+	recorder.push (recorded, outputFilename + "-" + frameStr + ".png");
+}
+
+
+void Cloud::streamFrame ()
+{
+	cv::Mat &recorded = getRecordedFrame();
+	if (!recorded.empty()) { video.write (recorded, workers); }
+}
+
+
+// Cropped once per frame, for both the images and the video. A frame that is
+// not persistent is copied, so that frames without a new physics step record
+// the last rendered one again: the video keeps its frame rate, and the images
+// their numbering.
+cv::Mat &Cloud::getRecordedFrame ()
+{
+	if (!persistentFrame && !frameRendered) { return recordedFrame; }
+	if (!cropBezels && persistentFrame) { return finalFrame; }
+	if (recordedFrameNb != frameNb) {
+		if (cropBezels) { bezelCrop.apply (finalFrame, recordedFrame); }
+		else { finalFrame.copyTo (recordedFrame); }
+		recordedFrameNb = frameNb;
+	}
+	return recordedFrame;
 }
 
 
 void Cloud::recordParticlePositions (int index)
 {
 	std::stringstream ss;
-	ss << "particle-positions-" << index << ".csv";
+	ss << "particle-positions-" << index << (textSnapshots ? TEXT_SNAPSHOT_EXTENSION : SNAPSHOT_EXTENSION);
 	recordParticlePositions (ss.str());
 }
 
 
+// Binary snapshot, or text lines for TEXT_SNAPSHOT_EXTENSION files
 void Cloud::recordParticlePositions (std::string filename)
+{
+	if (ParticleSnapshot::isText (filename)) { exportParticlePositions (filename); return; }
+
+	const float *arrays[] = { particles.x, particles.y, particles.dx, particles.dy };
+	if (ParticleSnapshot::write (filename, particleNumber, graphicsWidth, graphicsHeight, 4, 1, arrays)) { std::cout << "SAVING PARTICLE POSITIONS: " << filename << std::endl; }
+	else { std::cout << "COULD NOT WRITE FILE: " << filename << std::endl; }
+}
+
+
+void Cloud::exportParticlePositions (std::string filename)
 {
 	std::ofstream outputParticleFile;
 	outputParticleFile.open (filename, std::ios::out | std::ios::trunc);
@@ -894,171 +1582,331 @@ void Cloud::recordParticlePositions (std::string filename)
 		std::cout << "SAVING PARTICLE POSITIONS: " << filename << std::endl;
 
 		for (int i = 0; i < particleNumber; i++)
-		{ outputParticleFile << particles[i].x << " " << particles[i].y << " " << particles[i].dx << " " << particles[i].dy << "\n"; }	
+		{ outputParticleFile << particles.x[i] << " " << particles.y[i] << " " << particles.dx[i] << " " << particles.dy[i] << "\n"; }	
 
 		outputParticleFile.close ();
 	}
 }
 
 
+// Copies the particles and writes them on a background thread, text files
+// are written right away
+void Cloud::captureParticlePositions (std::string filename, bool verbose)
+{
+	if (ParticleSnapshot::isText (filename)) { exportParticlePositions (filename); return; }
+
+	const float *arrays[] = { particles.x, particles.y, particles.dx, particles.dy };
+	snapshotWriter.capture (filename, particleNumber, graphicsWidth, graphicsHeight, 4, 1, arrays, verbose);
+}
+
+
+void Cloud::autosave ()
+{
+	double time = FramePacer::getTime();
+	if (time - autosaveTime < autosaveDelay) { return; }
+	autosaveTime = time;
+	captureParticlePositions (autosaveFilename, false);
+}
+
+
 void Cloud::readParticlePositions (int index)
 {
 	std::stringstream ss;
-	ss << "particle-positions-" << index << ".csv";
-	readParticlePositions (ss.str());
+	ss << "particle-positions-" << index;
+	readParticlePositions (ParticleSnapshot::find (ss.str()));
 }
 
 
+// Particles beyond the end of the snapshot keep their state
 void Cloud::readParticlePositions (std::string filename)
 {
-	std::ifstream inputParticleFile;
-	inputParticleFile.open (filename, std::ios::in);
-
-	if (! inputParticleFile.is_open()) { std::cout << "COULD NOT OPEN FILE: " << filename << std::endl; }
-	else {
-		std::cout << "LOADING PARTICLE POSITIONS: " << filename << std::endl;
-
-		int i = 0;
-		std::string line;
-		float x, y, dx, dy;
-	
-		while (std::getline (inputParticleFile, line) && i < particleNumber) {
-			std::istringstream ss (line);
-			ss >> x >> y >> dx >> dy;
-			particles[i].x = x;
-			particles[i].y = y;
-			particles[i].dx = dx;
-			particles[i].dy = dy;
-			i++;
+	if (ParticleSnapshot::isText (filename)) { importParticlePositions (filename); return; }
+
+	ParticleSnapshot snapshot;
+	if (! snapshot.open (filename)) { std::cout << "COULD NOT OPEN FILE: " << filename << std::endl; return; }
+	std::cout << "LOADING PARTICLE POSITIONS: " << filename << std::endl;
+
+	float *arrays[] = { particles.x, particles.y, particles.dx, particles.dy };
+	int number = snapshot.read (arrays, 4, 1, particleNumber);
+	if (number < 0) { std::cout << "WRONG PARTICLE FIELDS: " << filename << std::endl; return; }
+
+	// Positions are in units of the rDistance of the recording cloud: keep them
+	// at the same place on the screen when the resolution differs (as in applyResize)
+	int width = snapshot.header.width;
+	int height = snapshot.header.height;
+	if (width > 0 && height > 0 && (width != graphicsWidth || height != graphicsHeight)) {
+		std::cout << "RESCALING PARTICLE POSITIONS FROM " << width << "x" << height << std::endl;
+		float distanceRatio = sqrt ((float) width * height) / rDistance;
+		float scaleX = (float) graphicsWidth / width * distanceRatio;
+		float scaleY = (float) graphicsHeight / height * distanceRatio;
+		for (int i = 0; i < number; i++) {
+			particles.x[i] *= scaleX;
+			particles.y[i] *= scaleY;
 		}
-
-		inputParticleFile.close ();
 	}
 }
 
 
-void *Cloud::updateAndMoveParticles (void *args)
+void Cloud::importParticlePositions (std::string filename)
 {
-	ArgStruct *argStruct = (ArgStruct *) args;
-	reinterpret_cast<Cloud*>(argStruct->cloud)->updateAndMoveParticles (argStruct->id);
-	pthread_exit (NULL);
+	float *arrays[] = { particles.x, particles.y, particles.dx, particles.dy };
+	if (ParticleSnapshot::importText (filename, arrays, 4, 1, particleNumber) < 0) { std::cout << "COULD NOT OPEN FILE: " << filename << std::endl; }
+	else { std::cout << "LOADING PARTICLE POSITIONS: " << filename << std::endl; }
 }
 
 
-void Cloud::updateAndMoveParticles (int id)
+void Cloud::updateAndMoveParticles (void *cloud, int id)
 {
-	for (int i = firstParticle[id]; i < lastParticle[id]; i++) {
+	reinterpret_cast<Cloud*>(cloud)->updateAndMoveParticles (id);
+}
 
-		Particle *particle = &particles[i];
-		
-		// Compute motion
-		float ddx = - rParticleDamping * particle->dx;
-		float ddy = - rParticleDamping * particle->dy;
 
-		for (unsigned int j = 0; j < bodyList->size(); j++) {
-			Body *body = bodyList->at(j);
-			if (body->weight == 0) continue;
+void Cloud::updateAndMoveParticles (int id)
+{
+	if (binning) { tileBins.clear (id); }
+	else { std::fill (dirtyTiles.begin(), dirtyTiles.end(), 0); }
+
+	ParticleKernelArgs args = particleKernelArgs;
+	for (int first = firstParticle[id]; first < lastParticle[id]; first += particleBlockSize) {
+		args.first = first;
+		args.last = std::min (first + particleBlockSize, lastParticle[id]);
+		particleKernel (args);
+		(this->*particleDrawer) (id, args.first, args.last);
+	}
+}
 
-			float distanceX = particle->x - body->x;
-			float distanceY = particle->y - body->y;
-	
-			float factor = pow (pow (distanceX, 2) + pow (distanceY, 2), rGravitationFactor);
-			if (factor == 0) continue;
-			
-			float angle = atan2 (distanceY, distanceX);
-			ddx -= body->weight * cos (angle + rGravitationAngle) / factor;
-			ddy -= body->weight * sin (angle + rGravitationAngle) / factor;
-		}
 
-		// Apply motion
-		particle->dx += ddx * rDelay;
-		particle->dy += ddy * rDelay;
+// Without binning, the only worker counts the particles in the count buffer.
+// With binning, pixels and tiles are only recorded here and counted by
+// accumulateTiles or drawBands, one worker per tile, so that no increment is
+// lost and the counts do not depend on the number of threads. Intermediate
+// physics steps only apply the borders.
+template <int border, int target>
+void Cloud::drawParticles (int id, int first, int last)
+{
+	unsigned int *counts = pixelCounts;
+	unsigned char *dirty = dirtyTiles.data();
+	for (int i = first; i < last; i++) {
+		float &x = particles.x[i];
+		float &y = particles.y[i];
+		int rX, rY;
+
+		if (border == MIRROR_BORDERS) {
+			while (x < 0 || x >= rWidthBorder) {
+				if (x < 0) { x = - x + rPixelSize; } else { x = rWidthBorderDoubled - x - rPixelSize; }
+				particles.dx[i] = - particles.dx[i];
+			}
 
-		if (particle->dx > maxParticleSpeed) { particle->dx = maxParticleSpeed; }
-		if (particle->dx < -maxParticleSpeed) { particle->dx = -maxParticleSpeed; }
-		if (particle->dy > maxParticleSpeed) { particle->dy = maxParticleSpeed; }
-		if (particle->dy < -maxParticleSpeed) { particle->dy = -maxParticleSpeed; }
-		
-		particle->x += (particle->dx - ddx * rDelay / 2) * rDelay;
-		particle->y += (particle->dy - ddy * rDelay / 2) * rDelay;
+			while (y < 0 || y >= rHeightBorder) {
+				if (y < 0) { y = - y + rPixelSize; } else { y = rHeightBorderDoubled - y - rPixelSize; }
+				particles.dy[i] = - particles.dy[i];
+			}
 
-		if (borderMode == MIRROR_BORDERS) {
-			while (particle->x < 0 || particle->x >= rWidthBorder) {
-				if (particle->x < 0) { particle->x = - particle->x + rPixelSize; } else { particle->x = rWidthBorderDoubled - particle->x - rPixelSize; }
-				particle->dx = -particle->dx;
+			rX = x * rDistance;
+			rY = y * rDistance;
+		}
+
+		else if (border == CYCLIC_BORDERS) {
+			if (x < 0 || x >= rWidthBorder) {
+				x -= floor (x / rWidthBorder) * rWidthBorder;
+				if (x >= rWidthBorder) { x = 0; }
 			}
 
-			while (particle->y < 0 || particle->y >= rHeightBorder) {
-				if (particle->y < 0) { particle->y = - particle->y + rPixelSize; } else { particle->y = rHeightBorderDoubled - particle->y - rPixelSize; }
-				particle->dy = -particle->dy;
+			if (y < 0 || y >= rHeightBorder) {
+				y -= floor (y / rHeightBorder) * rHeightBorder;
+				if (y >= rHeightBorder) { y = 0; }
 			}
 
-			int rX = particle->x * rDistance;
-			int rY = particle->y * rDistance;
-			pixels [rX + rY * graphicsWidth] += rPixelDrawingRate;
+			rX = std::min ((int) (x * rDistance), graphicsWidth - 1);
+			rY = std::min ((int) (y * rDistance), graphicsHeight - 1);
 		}
 
 		else {
-			int rX = particle->x * rDistance;
-			int rY = particle->y * rDistance;
-			if (rX >= 0 && rX < graphicsWidth && rY >= 0 && rY < graphicsHeight) { pixels [rX + rY * graphicsWidth] += rPixelDrawingRate; }
+			rX = x * rDistance;
+			rY = y * rDistance;
+			if (rX < 0 || rX >= graphicsWidth || rY < 0 || rY >= graphicsHeight) {
+				if (target == BIN_PARTICLES) { particleTiles[i] = -1; }
+				continue;
+			}
 		}
 
+		if (target == BIN_PARTICLES) {
+			int tile = tileBins.grid.getTile (rX, rY);
+			particlePixels[i] = rX + rY * graphicsWidth;
+			particleTiles[i] = tile;
+			tileBins.count (id, tile);
+		}
+		else if (target == COUNT_PARTICLES) {
+			counts [rX + rY * graphicsWidth]++;
+			dirty [dirtyGrid.getTile (rX, rY)] = 1;
+		}
 	}
-	pthread_exit (NULL);
 }
 
 
-void *Cloud::clearPixels (void *args)
+void Cloud::moveParticles (void *cloud, int id)
 {
-	ArgStruct *argStruct = (ArgStruct *) args;
-	reinterpret_cast<Cloud*>(argStruct->cloud)->clearPixels (argStruct->id);
-	pthread_exit (NULL);
+	reinterpret_cast<Cloud*>(cloud)->moveParticles (id);
 }
 
-void Cloud::clearPixels (int id)
+void Cloud::moveParticles (int id)
 {
-	for (int i = firstPixel[id]; i < lastPixel[id]; i++) { pixels[i] = 0; }
+	ParticleKernelArgs args = particleKernelArgs;
+	for (int first = firstParticle[id]; first < lastParticle[id]; first += particleBlockSize) {
+		args.first = first;
+		args.last = std::min (first + particleBlockSize, lastParticle[id]);
+		particleKernel (args);
+		(this->*particleMover) (id, args.first, args.last);
+	}
 }
 
 
-void *Cloud::cleanPixels (void *args)
+void Cloud::binParticles (void *cloud, int id)
 {
-	ArgStruct *argStruct = (ArgStruct *) args;
-	reinterpret_cast<Cloud*>(argStruct->cloud)->cleanPixels (argStruct->id);
-	pthread_exit (NULL);
+	reinterpret_cast<Cloud*>(cloud)->binParticles (id);
 }
 
-void Cloud::cleanPixels (int id)
+void Cloud::binParticles (int id)
 {
-	for (int i = firstPixel[id]; i < lastPixel[id]; i++) { pixels[i] = pixels[i] * rPixelCleaningRate; }
+	for (int i = firstParticle[id]; i < lastParticle[id]; i++) {
+		if (particleTiles[i] >= 0) { tileBins.insert (id, particleTiles[i], particlePixels[i]); }
+	}
 }
 
 
+void Cloud::accumulateTiles (void *cloud, int id)
+{
+	reinterpret_cast<Cloud*>(cloud)->accumulateTiles (id);
+}
 
+// Each tile is counted by a single worker
+void Cloud::accumulateTiles (int id)
+{
+	unsigned int *counts = pixelCounts;
+	const int *entries = tileBins.entries.data();
+	for (int tile = id; tile < tileBins.grid.tileNumber; tile += threadNumber) {
+		int last = tileBins.getLastEntry (tile);
+		for (int k = tileBins.getFirstEntry (tile); k < last; k++) { counts[entries[k]]++; }
+	}
+}
 
 
-void *Cloud::applyPixels (void *args)
+void Cloud::drawBands (void *cloud, int id)
 {
-	ArgStruct *argStruct = (ArgStruct *) args;
-	reinterpret_cast<Cloud*>(argStruct->cloud)->applyPixels (argStruct->id);
-	pthread_exit (NULL);
+	reinterpret_cast<Cloud*>(cloud)->drawBands (id);
+}
+
+// Each band of rows is counted by a single worker, which then cleans and
+// converts it while its counts and densities are still in cache
+void Cloud::drawBands (int id)
+{
+	unsigned int *counts = pixelCounts;
+	const int *entries = tileBins.entries.data();
+	for (int band = id; band < tileBins.grid.tileNumber; band += threadNumber) {
+		bool dirty = isTileDirty (band);
+		if (sparseFrame) {
+			if (!dirty && !shownTiles[band]) { continue; }
+			shownTiles[band] = dirty;
+		}
+
+		int last = tileBins.getLastEntry (band);
+		for (int k = tileBins.getFirstEntry (band); k < last; k++) { counts[entries[k]]++; }
+		convertPixels (tileBins.grid.getFirstY (band) * graphicsWidth, tileBins.grid.getLastY (band) * graphicsWidth);
+	}
+}
+
+
+void Cloud::applyPixels (void *cloud, int id)
+{
+	reinterpret_cast<Cloud*>(cloud)->applyPixels (id);
 }
 
 void Cloud::applyPixels (int id)
 {
-	uchar *pixel = frame->ptr<uchar>(0);
-	for (int i = firstPixel[id]; i < lastPixel[id]; i++)
-	{
-		int c = pixels[i] * pixelResolution;
-		int i3 = i*3;
-		pixel[i3] = particleBlueArray[c] * pixelIntensity;
-		pixel[i3+1] = particleGreenArray[c] * pixelIntensity;
-		pixel[i3+2] = particleRedArray[c] * pixelIntensity;		
+	if (!sparseFrame) { convertPixels (firstPixel[id], lastPixel[id]); return; }
+
+	// Rows of tiles are split between workers, then converted pixel row by
+	// pixel row, by runs of consecutive tiles to update
+	int columnNumber = pixelGrid->columnNumber;
+	int firstRow = (long) pixelGrid->rowNumber * id / threadNumber;
+	int lastRow = (long) pixelGrid->rowNumber * (id + 1) / threadNumber;
+	for (int row = firstRow; row < lastRow; row++) {
+		unsigned char *updated = updatedTiles.data() + row * columnNumber;
+		unsigned char *shown = shownTiles.data() + row * columnNumber;
+		for (int column = 0; column < columnNumber; column++) {
+			bool dirty = isTileDirty (row * columnNumber + column);
+			updated[column] = dirty || shown[column];
+			shown[column] = dirty;
+		}
+
+		int firstTile = row * columnNumber;
+		for (int y = pixelGrid->getFirstY (firstTile); y < pixelGrid->getLastY (firstTile); y++) {
+			for (int column = 0; column < columnNumber; column++) {
+				if (!updated[column]) { continue; }
+				int first = pixelGrid->getFirstX (firstTile + column);
+				while (column + 1 < columnNumber && updated[column + 1]) { column++; }
+				convertPixels (y * graphicsWidth + first, y * graphicsWidth + pixelGrid->getLastX (firstTile + column));
+			}
+		}
 	}
 }
 
 
+// A tile is dirty when particles were counted in it during this frame
+bool Cloud::isTileDirty (int tile)
+{
+	if (binning) { return tileBins.getLastEntry (tile) > tileBins.getFirstEntry (tile); }
+
+	return dirtyTiles[tile];
+}
+
+
+// Takes the counts (resetting them for the next frame), fades or clears the
+// previous density and converts it to colors, in a single pass over the
+// pixels [first, last).
+void Cloud::convertPixels (int first, int last)
+{
+	PixelKernelArgs args;
+	args.counts = pixelCounts;
+	args.pixels = pixels;
+	args.frameChannels = frame->channels();
+	args.first = first;
+	args.last = last;
+	args.cleaningRate = (pixelCleaningRate > 0) ? rPixelCleaningRate : 0;
+	args.drawingRate = rPixelDrawingRate;
+	args.table = colorTable.data();
+	args.tableScale = colorTableScale;
+
+	if (fixedPixels) {
+		args.fixedPixels = fixedDensities;
+		setupFixedRates (args, fixedShift, frameNb);
+		args.table = fixedColorTable.data();
+	}
+
+	if (frame->isContinuous()) {
+		args.frame = frame->ptr<uchar>(0) + (long) first * args.frameChannels;
+		pixelKernel (args);
+		return;
+	}
+
+	// Rows of a texture are padded to its pitch: pixels are converted row by row
+	for (int y = first / graphicsWidth; args.first < last; y++) {
+		args.last = std::min (last, (y + 1) * graphicsWidth);
+		args.frame = frame->ptr<uchar>(y) + (args.first - y * graphicsWidth) * args.frameChannels;
+		pixelKernel (args);
+		args.first = args.last;
+	}
+}
+
+
+
+float getElapsedTime (struct timeval &startTimer)
+{
+	struct timeval endTimer;
+	gettimeofday (&endTimer, NULL);
+	return (endTimer.tv_sec - startTimer.tv_sec) + (float) (endTimer.tv_usec - startTimer.tv_usec) / MILLION;
+}
+
 
 int ms_sleep (unsigned int ms)
 {
@@ -1080,10 +1928,12 @@ int ms_sleep (unsigned int ms)
 // PARAMETERS
 
 void Cloud::openOutputParameterFile (std::string filename) {
-	if (outputParameterFile.is_open()) { closeOutputParameterFile(); }
-	gettimeofday (&parameterTimer, NULL);
-	outputParameterFile.open (filename, std::ios::out | std::ios::trunc);
-	if (outputParameterFile) { std::cout << "WRITE PARAMETER SEQUENCE: " << filename << std::endl; } else { std::cerr << "CANNOT WRITE PARAMETER SEQUENCE: " << filename << std::endl; }	
+	closeOutputParameterFile();
+	if (timeline == NULL || timeline->filename != filename) { timelines.erase (filename); }   // recompiled when played again
+	parameterStartTime = FramePacer::getTime();
+	std::vector<std::string> names;
+	for (int p = 0; p < PARAMETER_NUMBER; p++) { names.push_back (parameters[p].name); }
+	if (parameterRecorder.open (filename, names)) { std::cout << "WRITE PARAMETER SEQUENCE: " << filename << std::endl; } else { std::cerr << "CANNOT WRITE PARAMETER SEQUENCE: " << filename << std::endl; }	
 }
 
 void Cloud::writeOutputParameterFile ()
@@ -1091,76 +1941,181 @@ void Cloud::writeOutputParameterFile ()
 	for (int p = 0; p < PARAMETER_NUMBER; p++) { setParameter (p, getParameter (p)); }
 }
 
-void Cloud::closeOutputParameterFile () { outputParameterFile.close(); }
+void Cloud::closeOutputParameterFile () { parameterRecorder.close(); }
 
 
-void Cloud::openInputParameterFile (std::string filename) {
-	if (inputParameterFile.is_open()) { closeInputParameterFile(); }
-	gettimeofday (&parameterTimer, NULL);
-	inputParameterFile.open (filename, std::ios::in);
+// Sequences are compiled once, and kept for the next time they are played
+ParameterTimeline *Cloud::compileParameterSequence (std::string filename)
+{
+	std::map<std::string, ParameterTimeline>::iterator it = timelines.find (filename);
+	if (it != timelines.end()) { return &it->second; }
+
+	ParameterTimeline compiled;
+	if (! compiled.compile (filename)) { return NULL; }
+	for (unsigned int t = 0; t < compiled.tracks.size(); t++) {
+		TimelineTrack &track = compiled.tracks[t];
+		if (track.name == "particlePositions") { track.id = PARTICLE_POSITIONS_ACTION; }
+		else if (track.name == "particleInit") { track.id = PARTICLE_INIT_ACTION; }
+		else if (track.name == "borderMode") { track.id = BORDER_MODE_ACTION; }
+		else { track.id = getParameterId (track.name); }
+	}
 
-	if (inputParameterFile) { std::cout << "READ PARAMETER SEQUENCE: " << filename << std::endl; } else { std::cerr << "CANNOT READ PARAMETER SEQUENCE: " << filename << std::endl; }	
-	std::getline (inputParameterFile, inputParameterLine);
+	ParameterTimeline &timeline = timelines[filename];
+	timeline.filename = compiled.filename;
+	timeline.tracks.swap (compiled.tracks);
+	timeline.sampleNumber = compiled.sampleNumber;
+	timeline.duration = compiled.duration;
+	return &timeline;
 }
 
+
+void Cloud::preloadParameterSequences ()
+{
+	int sequenceNb = 0, sampleNb = 0;
+	for (int n = 0; n < PARAMETER_SEQUENCE_NUMBER; n++) {
+		std::stringstream ss;
+		ss << "static-cells-parameter-sequence-" << n << ".csv";
+		if (access (ss.str().c_str(), R_OK) != 0) continue;
+		ParameterTimeline *sequence = compileParameterSequence (ss.str());
+		if (sequence == NULL) continue;
+		sequenceNb++;
+		sampleNb += sequence->sampleNumber;
+	}
+	if (sequenceNb > 0) { std::cout << "PRELOADED PARAMETER SEQUENCES: " << sequenceNb << " (" << sampleNb << " samples)" << std::endl; }
+}
+
+
+void Cloud::openInputParameterFile (std::string filename, double startTime) {
+	if (timeline != NULL) { closeInputParameterFile(); }
+	timeline = compileParameterSequence (filename);
+
+	if (timeline) { std::cout << "READ PARAMETER SEQUENCE: " << filename << std::endl; } else { std::cerr << "CANNOT READ PARAMETER SEQUENCE: " << filename << std::endl; return; }
+
+	// The snapshots of the sequence are loaded before they are needed
+	snapshotTrack = -1;
+	snapshotFilenames.clear();
+	for (unsigned int t = 0; t < timeline->tracks.size(); t++) {
+		const TimelineTrack &track = timeline->tracks[t];
+		if (track.id != PARTICLE_POSITIONS_ACTION) continue;
+		snapshotTrack = t;
+		for (unsigned int i = 0; i < track.values.size(); i++) {
+			std::stringstream ss;
+			ss << "particle-positions-" << track.values[i];
+			snapshotFilenames.push_back (ParticleSnapshot::find (ss.str()));
+		}
+	}
+
+	// Sequence times are counted from startTime
+	parameterStartTime = FramePacer::getTime() - startTime;
+	parameterDelay = currentDelay - startTime;
+	seekInputParameterFile (startTime);
+}
+
+
+// Moves to time without replaying the samples before it: each parameter
+// takes its last value, and the particles the last snapshot (or
+// initialization). The physics in between is not replayed.
+void Cloud::seekInputParameterFile (double time)
+{
+	snapshotPrefetcher.clear();
+	timelineCursors.assign (timeline->tracks.size(), 0);
+	for (unsigned int t = 0; t < timeline->tracks.size(); t++) { timelineCursors[t] = timeline->seek (t, time); }
+	snapshotRequestNb = (snapshotTrack >= 0) ? timelineCursors[snapshotTrack] : 0;
+
+	int particleTrack = -1;
+	for (unsigned int t = 0; t < timeline->tracks.size(); t++) {
+		const TimelineTrack &track = timeline->tracks[t];
+		int last = timelineCursors[t] - 1;
+		if (last < 0) continue;
+		if (track.id == PARTICLE_POSITIONS_ACTION || track.id == PARTICLE_INIT_ACTION) {
+			if (particleTrack < 0 || track.lines[last] > timeline->tracks[particleTrack].lines[timelineCursors[particleTrack] - 1]) { particleTrack = t; }
+		}
+		else { applyParameterSample (track, last); }
+	}
+	if (particleTrack >= 0) { applyParameterSample (timeline->tracks[particleTrack], timelineCursors[particleTrack] - 1); }
+}
+
+
+// Time since the sequence started, on the simulation clock with a constant delay
+double Cloud::getSequenceTime ()
+{
+	if (constantDelay > 0) { return currentDelay - parameterDelay; }
+	return FramePacer::getTime() - parameterStartTime;
+}
+
+
+// Requests the next snapshots of the sequence while prefetch slots are free
+void Cloud::prefetchParticlePositions (double timestamp)
+{
+	if (snapshotTrack < 0) return;
+	const std::vector<double> &timestamps = timeline->tracks[snapshotTrack].timestamps;
+	while (snapshotRequestNb < (int) timestamps.size()
+		&& timestamps[snapshotRequestNb] <= timestamp + PREFETCH_LOOKAHEAD
+		&& snapshotPrefetcher.request (snapshotFilenames[snapshotRequestNb], particles.number, particleNumber)
+		) { snapshotRequestNb++; }
+}
+
+
 void Cloud::readInputParameterFile ()
 {
-				double currentTimestamp;
-				if (constantDelay > 0) { currentTimestamp = currentDelay; }
-				else {
-				struct timeval readTimer;
-				gettimeofday (&readTimer, NULL);
-				currentTimestamp = (readTimer.tv_sec - parameterTimer.tv_sec) + (float) (readTimer.tv_usec - parameterTimer.tv_usec) / MILLION;
-			}
-				
-	std::istringstream iss;
-	double timestamp;
-	std::string name;
-	float value;
-
-	if (! inputParameterFile) return;
-	iss = std::istringstream (inputParameterLine);
-	iss >> timestamp >> name >> value;
-
-	while (timestamp <= currentTimestamp) {
-		if (name == "particlePositions") {
-				std::stringstream ss;
-				ss.str("");
-				ss << "particle-positions-" << value << ".csv";
-				readParticlePositions (ss.str());
-			}
-		
-		else if (name == "particleInit") { initParticles (UNIFORM_INIT); }
-		
-		else if (name == "borderMode") {
-				if (value == 0) { borderMode = NO_BORDERS; } else { borderMode = MIRROR_BORDERS; }
-			}
-		
-		else {
-				setParameter (getParameterId (name), value, false);
-				if (name == "bodyX") {
-				mouseX = value * rDistance;
-				SDL_WarpMouseGlobal (mouseX, mouseY);
-				SDL_PumpEvents();
-				SDL_FlushEvent (SDL_MOUSEMOTION);
-			}
-				else if (name == "bodyY") {
-				mouseY = value * rDistance;
-				SDL_WarpMouseGlobal (mouseX, mouseY);
-				SDL_PumpEvents();
-				SDL_FlushEvent (SDL_MOUSEMOTION);
-			}
-			}
-		
-		std::getline (inputParameterFile, inputParameterLine);
+	double currentTimestamp = getSequenceTime();
+	prefetchParticlePositions (currentTimestamp);
+
+	// The samples that are due are applied in the order of the file
+	while (true) {
+		int next = -1;
+		for (unsigned int t = 0; t < timeline->tracks.size(); t++) {
+			const TimelineTrack &track = timeline->tracks[t];
+			int i = timelineCursors[t];
+			if (i == (int) track.timestamps.size() || track.timestamps[i] > currentTimestamp) continue;
+			if (next < 0 || track.lines[i] < timeline->tracks[next].lines[timelineCursors[next]]) { next = t; }
+		}
+		if (next < 0) break;
+		applyParameterSample (timeline->tracks[next], timelineCursors[next]++);
+	}
+}
+
 
-		if (! inputParameterFile) break;		
-		iss = std::istringstream (inputParameterLine);
-		iss >> timestamp >> name >> value;
+void Cloud::applyParameterSample (const TimelineTrack &track, int index)
+{
+	float value = track.values[index];
+
+	switch (track.id) {
+	case PARTICLE_POSITIONS_ACTION :
+	{
+		const std::string &filename = snapshotFilenames[index];
+		if (snapshotPrefetcher.take (filename, &particles, particleNumber)) { std::cout << "LOADING PARTICLE POSITIONS: " << filename << std::endl; }
+		else { readParticlePositions (filename); }
+		prefetchParticlePositions (getSequenceTime());
+		break;
+	}
+
+	case PARTICLE_INIT_ACTION : initParticles (UNIFORM_INIT); break;
+
+	case BORDER_MODE_ACTION :
+		if (value == 0) { borderMode = NO_BORDERS; } else if (value == CYCLIC_BORDERS) { borderMode = CYCLIC_BORDERS; } else { borderMode = MIRROR_BORDERS; }
+		break;
+
+	case UNKNOWN_PARAMETER : break;
+
+	default :
+		setParameter (track.id, value, false);
+		if (track.id == BODY_X || track.id == BODY_Y) {
+			if (track.id == BODY_X) { mouseX = value * rDistance; } else { mouseY = value * rDistance; }
+			SDL_WarpMouseGlobal (mouseX, mouseY);
+			SDL_PumpEvents();
+			SDL_FlushEvent (SDL_MOUSEMOTION);
+		}
+		break;
 	}
 }
 
-void Cloud::closeInputParameterFile () { inputParameterFile.close(); }
+void Cloud::closeInputParameterFile ()
+{
+	timeline = NULL;
+	snapshotTrack = -1;
+	snapshotPrefetcher.clear();
+}
 
 
 void Cloud::setupParameters ()
@@ -1330,10 +2285,8 @@ void Cloud::setParameter (int parameter, float value, bool write)
 	}
 
 	if (write && recordParameters) {
-		struct timeval recordTimer;
-		gettimeofday (&recordTimer, NULL);
-		double timestamp = (recordTimer.tv_sec - parameterTimer.tv_sec) + (float) (recordTimer.tv_usec - parameterTimer.tv_usec) / MILLION;
-		outputParameterFile << timestamp << " " << parameters[parameter].name << " " << value << "\n";
+		double timestamp = FramePacer::getTime() - parameterStartTime;
+		parameterRecorder.set (parameter, timestamp, value);
 	}
 }
 
@@ -33,10 +33,28 @@
 #include <random>
 #include <vector>
 #include <list>
+#include <map>
 
 #include <SDL.h>
 #include <opencv2/opencv.hpp>
 
+#include "worker_pool.hpp"
+#include "particle_array.hpp"
+#include "particle_kernels.hpp"
+#include "pixel_kernels.hpp"
+#include "overlay_layer.hpp"
+#include "frame_presenter.hpp"
+#include "frame_pacer.hpp"
+#include "frame_recorder.hpp"
+#include "particle_snapshot.hpp"
+#include "parameter_recorder.hpp"
+#include "snapshot_prefetcher.hpp"
+#include "parameter_timeline.hpp"
+#include "video_stream.hpp"
+#include "bezel_crop.hpp"
+#include "tile_bins.hpp"
+#include "particle_sorter.hpp"
+
 
 #define VERBOSE 0
 #define MILLION 1000000L
@@ -55,6 +73,13 @@
 
 #define NO_BORDERS                0
 #define MIRROR_BORDERS            1
+#define CYCLIC_BORDERS            2
+
+#define COUNT_PARTICLES           0
+#define BIN_PARTICLES             1
+#define MOVE_PARTICLES            2
+
+#define DIRTY_TILE_SHIFT          6         // 64 x 64 pixels tiles for the sparse conversion
 
 
 // PARAMETER METHODS
@@ -74,19 +99,22 @@
 
 #define PARAMETER_NUMBER      9
 
+// Names of a parameter sequence that are not parameters
+#define UNKNOWN_PARAMETER         -1
+#define PARTICLE_POSITIONS_ACTION -2
+#define PARTICLE_INIT_ACTION      -3
+#define BORDER_MODE_ACTION        -4
+
+#define PARAMETER_SEQUENCE_NUMBER 10        // static-cells-parameter-sequence-N.csv, played with the number keys
+
 
 // CLASS PREDIFINITIONS
 
 class Cloud;
+typedef void (Cloud::*ParticleDrawer) (int id, int first, int last);
 class Body;
 typedef std::vector<Body*> BodyList;
 
-struct ArgStruct {
-	Cloud *cloud;
-	int id;
-	ArgStruct (Cloud *vCloud, int vId) : cloud (vCloud), id (vId) {};
-};
-
 
 // PARAMETER STRUCTURE
 
@@ -248,6 +276,7 @@ typedef struct HsvColor
 // void calibrateKinect (int key);
 
 int ms_sleep (unsigned int ms);
+float getElapsedTime (struct timeval &startTimer);
 
 
 // SIMPLE STRUCTURES
@@ -273,15 +302,6 @@ public:
 };
 
 
-struct Particle
-{
-public:
-	float x, y, dx, dy;
-	Particle () : x (0), y (0), dx (0), dy (0) {}
-};
-
-
-
 // OTHER CLASSES
 
 class Cloud
@@ -294,14 +314,30 @@ public:
 	bool displayCoordinates   = false;
 	bool hideMouse            = true;
 	bool displayFullscreen    = true;
+	bool presentationThread   = false;   // present frames and poll the input on a dedicated thread, through a triple buffer, so that the simulation never waits for the display (set before init)
+	bool textureFrame         = false;   // without presentationThread, render pixels and overlays straight into the locked SDL texture, without copying the frame (set before init)
+	bool argbTexture          = false;   // ARGB8888 frames and texture, that SDL uploads without converting them (set before init)
+	bool vsync                = false;   // wait for the display refresh when presenting, and run at its rate when framePerSecond is 0 (set before init)
 
 	bool recordParticles      = false;
+	int recordThreadNumber    = RECORDER_THREAD_NUMBER;   // PNG encoders (set before init)
+	int recordQueueSize       = RECORDER_QUEUE_SIZE;      // frames copied and waiting for the encoders (set before init)
+	bool recordLive           = false;   // drop the recorded frames when the encoders are behind, instead of waiting for them (set before init)
+	bool recordVideo          = false;   // stream the recorded frames to videoFilename, a file or a named pipe read by ffmpeg (set before init)
+	int videoFormat           = Y4M_STREAM;
+	float videoFrameRate      = DEFAULT_VIDEO_FRAME_RATE;
+	bool cropBezels           = false;   // remove the mullions of the 2x2 video wall from the recorded frames and videos (set before init)
 	bool recordParameters     = false;
 	bool readParameters       = !recordParameters;
+	bool textSnapshots        = false;   // record particle snapshots as text lines instead of binary files
+	float autosaveDelay       = 0;       // seconds between two particle snapshots saved in the background to autosaveFilename, 0 to disable
+	bool warmRestart          = false;   // start from the autosaved particles when they exist (set before init)
+	float sequenceStartTime   = 0;       // play the parameter sequence read at launch from this time, in seconds, without replaying what comes before (set before init)
 	
 	std::string inputParameterFilename  = "static-cells-input-sequence.csv";
 	std::string outputParameterFilename = "static-cells-output-sequence.csv";
 	std::string inoutParameterFilename  = "static-cells-inout-sequence.csv";
+	std::string autosaveFilename        = "particle-positions-autosave.snapshot";
 
 	float framePerSecond      = 0;
 	float frameLogFrequency   = 0;
@@ -311,11 +347,17 @@ public:
 
 	int graphicsWidth         = 1920;
 	int graphicsHeight        = 1080;
-	int threadNumber          = 8;
+	int threadNumber          = 8;       // 0 to use every available processor
+	bool tileBinning          = false;   // sort particles by screen tile before counting them, even with a single worker (several workers always do)
+	bool fusedPixels          = false;   // sort particles by band of rows, then count, clean and convert each band in one pass (set before init)
+	bool sparsePixels         = false;   // without pixel cleaning, only clear and convert the tiles holding particles now or at the previous frame
+	bool fixedPixels          = false;   // 16-bit fixed-point densities instead of floats, half the memory traffic (set before init)
+	int reorderFrequency      = 0;       // frames between two reorderings of the particles by screen position, 0 to disable
 
 // PHYSICS PARAMETER
 	int borderMode            = MIRROR_BORDERS;
 	int particleInitMode      = UNIFORM_INIT;
+	bool fastPhysics          = false;   // trig-free vectorized kernel instead of the exact one (see --check-physics)
 
 	int particleNumber        = 1920 * 1080 / 9;
 	float particleWeight      = 1.;
@@ -325,6 +367,9 @@ public:
 	float gravitationAngle    = 0.;
 	float timeFactor          = 1.;
 
+	float physicsFrequency    = 0;       // fixed physics steps per second, 0 for one step per frame
+	int maxPhysicsSteps       = 4;       // steps per frame when late, further time is dropped
+
 	pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
 	BodyList *bodyList = new BodyList ();
 	BodyList *newBodyList = new BodyList ();
@@ -354,7 +399,7 @@ public:
 
 // PROGRAM PARAMETERS
 	static const int maxParticleNumber   = 1920 * 1080 * 4;
-	static const int maxThreadNumber     = 16;
+	static const int particleBlockSize   = 256;
 	const float maxParticleSpeed         = 1000000.;
 	
 // PROGRAM VARIABLES
@@ -362,14 +407,33 @@ public:
 
 	std::string configFilename = "";
 	std::string outputFilename = "";
-	std::ifstream inputParameterFile;
-	std::ofstream outputParameterFile;
-	std::string inputParameterLine;
+	std::string videoFilename = "";
+	ParameterRecorder parameterRecorder;
+	std::map<std::string, ParameterTimeline> timelines;   // compiled parameter sequences, by filename
+	ParameterTimeline *timeline = NULL;       // sequence being played
+	std::vector<int> timelineCursors;         // next sample of each of its tracks
+	int snapshotTrack = -1;                   // its particlePositions track
+	std::vector<std::string> snapshotFilenames;
+	int snapshotRequestNb = 0;                // of these snapshots, the ones already requested
+	SnapshotPrefetcher snapshotPrefetcher;
 
 	int mouseX, mouseY;
-	SDL_Window *window;
-	SDL_Renderer *renderer;
-	SDL_Texture *texture;
+	SDL_Window *window = NULL;
+	SDL_Renderer *renderer = NULL;
+	SDL_Texture *texture = NULL;
+	bool presentFrames = false;               // the frame is the back buffer of the presenter, rewritten at each frame
+	bool renderTexture = false;               // the frame is the locked texture, rewritten at each frame
+	bool persistentFrame = true;              // the frame keeps its pixels from a frame to the next
+	bool frameRendered = false;               // pixels were converted into the frame since it was last shown
+	bool textureLocked = false;
+	FramePresenter presenter;
+	FrameRecorder recorder;
+	VideoStream video;
+	SnapshotWriter snapshotWriter;
+	double autosaveTime;
+	BezelCrop bezelCrop;
+	cv::Mat recordedFrame;                    // cropped, or copied when the frame is not persistent
+	int recordedFrameNb = -1;
 	SDL_Event event;
 	ParameterVector parameters;
 
@@ -378,14 +442,19 @@ public:
 	EventList events;
 
 	int frameNb;
-	int sumFrameNb;
 	float delay;
-	float sumDelay;
 	float currentDelay;
+	FramePacer pacer;
+
+	float sumParticleDelay;
+	float sumReorderDelay;
+	int sumReorderNb;
+	int sumDroppedStepNb;
+
+	float physicsTime;
 
-	struct timeval startTimer;
-	struct timeval endTimer;
-	struct timeval parameterTimer;
+	double parameterStartTime;               // FramePacer time at which the parameter sequence started
+	float parameterDelay;                     // currentDelay when the sequence started, with a constant delay
 
 // PHYSICS VARIABLES
 	float rDistance;
@@ -406,16 +475,47 @@ public:
 	float rHeightBorderDoubled;
 
 // PARTICLE VARIABLES
-	Particle *particles;
-	float *pixels;
-	cv::Mat *frame;
-	cv::Mat finalFrame;
+	ParticleArray particles;
+	int particleKernelId = SCALAR_KERNEL;
+	ParticleKernel particleKernel;
+	ParticleDrawer particleDrawer;
+	ParticleDrawer particleMover;
+	ParticleKernelArgs particleKernelArgs;
+	std::vector<float> activeBodyX;
+	std::vector<float> activeBodyY;
+	std::vector<float> activeBodyWeight;
+	ParticleSorter particleSorter;
+
+	float *pixels = NULL;
+	uint16_t *fixedDensities = NULL;
+	int fixedShift = -1;                      // fractional bits of the fixed-point densities
+	cv::Mat *frame = NULL;
+	cv::Mat finalFrame;                       // the frame with its overlays, no copy of it
+	OverlayLayer overlay;
 	int frameIndex;
 	int firstFrameIndex = 0;
 
-	int *particleRedArray;
-	int *particleGreenArray;
-	int *particleBlueArray;
+	PixelKernel pixelKernel;
+	bool binning = false;
+	bool sparseFrame = false;
+	bool refreshPixels = true;                // convert every pixel at the next frame
+	TileGrid dirtyGrid;                       // DIRTY_TILE_SIZE tiles marked by the direct scatter
+	TileGrid *pixelGrid;                      // tiles of the sparse conversion: dirtyGrid, or the bins of the binning
+	std::vector<unsigned char> dirtyTiles;    // tiles of dirtyGrid counted in by the direct scatter
+	std::vector<unsigned char> shownTiles;    // tiles of pixelGrid that may hold a non-zero density
+	std::vector<unsigned char> updatedTiles;  // tiles of pixelGrid converted at this frame
+	std::vector<uint32_t> colorTable;
+	float colorTableScale;
+	std::vector<float> colorTableKey;
+	std::vector<uint32_t> fixedColorTable;
+
+	int pixelCapacity = 0;
+	int pixelCountCapacity = 0;
+
+	bool resizeRequested = false;
+	int requestedParticleNumber;
+	int requestedWidth;
+	int requestedHeight;
 
 	float bodyLeftWeight;
 	float bodyRightWeight;
@@ -423,14 +523,17 @@ public:
 	float bodyBottomWeight;
 
 // THREAD VARIABLES
-	void *status;
-	pthread_attr_t attr;
+	WorkerPool workers;
 
-	pthread_t threads [maxThreadNumber];
-	int firstParticle [maxThreadNumber];
-	int lastParticle [maxThreadNumber];
-	int firstPixel [maxThreadNumber];
-	int lastPixel [maxThreadNumber];
+	std::vector<int> firstParticle;
+	std::vector<int> lastParticle;
+	std::vector<int> firstPixel;
+	std::vector<int> lastPixel;
+	unsigned int *pixelCounts = NULL;         // particles drawn in the current frame, each tile counted by a single worker
+
+	TileBins tileBins;
+	std::vector<int> particlePixels;
+	std::vector<int> particleTiles;           // -1 for particles out of the screen
 
 	Cloud ();
 	~Cloud ();
@@ -439,49 +542,87 @@ public:
 	void setup ();
 	void setupEvents ();
 	void setupParameters ();
+	void setupBuffers ();
+	void createTexture ();
+	void lockTexture ();
+	void startPresenter ();
 	void setupThreads ();
 	void setupColor ();
+	void setupFixedColor (float maxDensity);
+	void updateColor ();
 	void setdown ();
 
+	bool checkPhysics ();
+	bool checkFading ();
+
 	static void *run (void *arg);
 	void run ();
 
+	void resize (int vParticleNumber, int vWidth, int vHeight);
+	void applyResize ();
+
 	void initParticles (int type);
+	void reorderParticles ();
 	void getTime ();
 
 	void updateBodies ();
 	void updatePhysics ();
 	void computeParticles ();
+	void stepParticles ();
 	void computeFrame ();
+	void restoreFrame ();
 	void displayFrame ();
+	void handleEvent (const SDL_Event &event, const Uint8 *keyboard);
 	void recordFrame ();
+	void streamFrame ();
+	void openVideo (std::string filename);
+	cv::Mat &getRecordedFrame ();
 
 	void addBody (Body *body);
 	void clearBodies ();
 
 	void recordParticlePositions (int index);
 	void recordParticlePositions (std::string filename);
+	void exportParticlePositions (std::string filename);
 	void readParticlePositions (int index);
 	void readParticlePositions (std::string filename);
+	void importParticlePositions (std::string filename);
+	void captureParticlePositions (std::string filename, bool verbose);
+	void autosave ();
 
-	static void *updateAndMoveParticles (void *args);
+	static void updateAndMoveParticles (void *cloud, int id);
 	void updateAndMoveParticles (int id);
+	template <int border, int target> void drawParticles (int id, int first, int last);
+
+	static void moveParticles (void *cloud, int id);
+	void moveParticles (int id);
+
+	static void binParticles (void *cloud, int id);
+	void binParticles (int id);
 
-	static void *cleanPixels (void *args);
-	void cleanPixels (int id);
+	static void accumulateTiles (void *cloud, int id);
+	void accumulateTiles (int id);
 
-	static void *clearPixels (void *args);
-	void clearPixels (int id);
+	static void drawBands (void *cloud, int id);
+	void drawBands (int id);
 
-	static void *applyPixels (void *args);
+	static void applyPixels (void *cloud, int id);
 	void applyPixels (int id);
+	void convertPixels (int first, int last);
+	bool isTileDirty (int tile);
 
 	void openOutputParameterFile (std::string filename);
 	void writeOutputParameterFile ();
 	void closeOutputParameterFile ();
 
-	void openInputParameterFile (std::string filename);
+	ParameterTimeline *compileParameterSequence (std::string filename);
+	void preloadParameterSequences ();
+	void openInputParameterFile (std::string filename, double startTime = 0);
+	void seekInputParameterFile (double time);
 	void readInputParameterFile ();
+	void applyParameterSample (const TimelineTrack &track, int index);
+	void prefetchParticlePositions (double timestamp);
+	double getSequenceTime ();
 	void closeInputParameterFile ();
 
 	int getParameterId (std::string name);
@@ -112,7 +112,9 @@ void Cloud::run ()
 			) {
 			if (displayParticles) displayFrame();
 			if (recordParticles) recordFrame();
+			if (recordVideo) streamFrame();
 		}
+		parameterRecorder.commit();
 
 #if VERBOSE
 		std::cout << std::endl;
@@ -120,6 +122,10 @@ void Cloud::run ()
 
 		if (frameLimit > 0 && frameNb > frameLimit) stop = true;
 	}
+
+	recorder.stop();
+	video.close();
+	snapshotWriter.stop();
 }
 
 
@@ -139,9 +145,9 @@ void Cloud::setup ()
 	}
 	initParticles (particleInitMode);
 
-	particleRedArray = new int [maxParticleNumber+1];
-	particleBlueArray = new int [maxParticleNumber+1];
-	particleGreenArray = new int [maxParticleNumber+1];
+	particleRedArray = new int [particleNumber+1];
+	particleBlueArray = new int [particleNumber+1];
+	particleGreenArray = new int [particleNumber+1];
 
 	setupColor ();
 
@@ -166,19 +172,23 @@ void Cloud::setup ()
 	}
 		  
 	frame = new cv::Mat (graphicsHeight, graphicsWidth, CV_8UC3);
-	pixels = new int [graphicsWidth*graphicsHeight];
+	pixels = new int [graphicsWidth*graphicsHeight] ();
 
 	// SETUP THREADS
 	setupThreads();
+	if (recordParticles) { recorder.start (recordThreadNumber, recordQueueSize, recordLive); }
+	if (recordVideo) {
+		if (videoFilename == "") { videoFilename = outputFilename + (videoFormat == Y4M_STREAM ? ".y4m" : ".bgr"); }
+		if (!video.open (videoFilename, videoFormat, graphicsWidth, graphicsHeight, videoFrameRate)) { recordVideo = false; }
+	}
 
 	// SETUP TIME
+	pacer.targetRate = framePerSecond;
 	frameNb = 0;
-	sumFrameNb = 0;
 	delay = 0;
-	sumDelay = 0;
 	currentDelay = 0;
-	gettimeofday (&startTimer, NULL);
-	parameterTimer = startTimer;
+	pacer.start ();
+	parameterStartTime = FramePacer::getTime();
 
 	// SETUP EVENTS
 	setupEvents ();
@@ -193,8 +203,12 @@ void Cloud::setup ()
 
 void Cloud::setdown ()
 {
+	recorder.stop();
+	video.close();
+	snapshotWriter.stop();
 	if (recordParameters) { closeOutputParameterFile(); }
 	else if (readParameters) { closeInputParameterFile(); }
+	workers.stop();
 }
 
 
@@ -231,8 +245,11 @@ void Cloud::setupCamera ()
 
 void Cloud::setupThreads ()
 {
-	pthread_attr_init (&attr);
-	pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_JOINABLE);
+	if (threadNumber <= 0) { threadNumber = WorkerPool::getProcessorNumber(); }
+	workers.start (threadNumber);
+
+	firstParticle.resize (threadNumber);
+	lastParticle.resize (threadNumber);
 
 	int particlePerThread = particleNumber / threadNumber;
 	int currentParticle = 0;
@@ -244,15 +261,10 @@ void Cloud::setupThreads ()
 	}
 	lastParticle[threadNumber-1] = particleNumber;
 
-	int pixelPerThread = pixelNumber / threadNumber;
-	int currentPixel = 0;
-	for (int i = 0; i < threadNumber; i++)
-	{
-		firstPixel[i] = currentPixel;
-		currentPixel += pixelPerThread;
-		lastPixel[i] = currentPixel;
-	}
-	lastPixel[threadNumber-1] = pixelNumber;
+	// Particles are binned by band of rows, whose counts and colors stay in cache
+	tileBins.setup (graphicsWidth, graphicsHeight, sizeof (int) + 3, threadNumber, particleNumber, true);
+	particlePixels.resize (particleNumber);
+	particleTiles.resize (particleNumber);
 }
 
 
@@ -305,29 +317,19 @@ void Cloud::setupColor ()
 
 void Cloud::getTime()
 {
-	gettimeofday (&endTimer, NULL);
-	delay = (endTimer.tv_sec - startTimer.tv_sec) + (float) (endTimer.tv_usec - startTimer.tv_usec) / MILLION;
-	startTimer = endTimer;
-
-	if (framePerSecond > 0) {
-		if (delay < 1./framePerSecond) {
-			struct timespec waitTime = {0};
-			waitTime.tv_sec = 0;
-			waitTime.tv_nsec = (1./framePerSecond - delay) * BILLION;
-			nanosleep (& waitTime, (struct timespec *) NULL);
-		} else { std::cout << "WARNING: not able to have " << framePerSecond << "fps" << std::endl; }
-	}
-
+	delay = pacer.step ();
 	frameNb++;
-	sumFrameNb++;
-	sumDelay += delay;
 
-	if (sumDelay >= 3)
+	if (pacer.report ())
 	{
-		graphicsFps = (int) (((float) sumFrameNb) / sumDelay);
-		std::cout << "GRAPHICS: " << graphicsFps << "fps" << std::endl;
-		sumDelay = 0;
-		sumFrameNb = 0;
+		graphicsFps = pacer.fps;
+		std::cout << "GRAPHICS: ";
+		pacer.writeReport (std::cout);
+		if (recordParticles) {
+			std::cout << ", ";
+			recorder.writeReport (std::cout, pacer.reportDuration);
+		}
+		std::cout << std::endl;
 	}
 
 	if (constantDelay > 0) { delay = constantDelay; }
@@ -466,50 +468,13 @@ void Cloud::projectParticles ()
 
 void Cloud::computeParticles ()
 {
-	ArgStruct **args = new ArgStruct *[threadNumber];
-
-	// CLEAR PIXELS
-#if VERBOSE
-	std::cout << "BEGIN clear pixels" << std::endl;
-#endif
-	
-	for (int i = 0; i < threadNumber; i++)
-	{
-		args[i] = new ArgStruct (this, i);
-		int rc = pthread_create (&threads[i], NULL, &Cloud::clearPixels, (void *) args[i]);
-		if (rc) { std::cout << "Error: Unable to create thread " << rc << std::endl; exit(-1); }
-	}
-
-	for (int i = 0; i < threadNumber; i++)
-	{
-		int rc = pthread_join (threads[i], &status);
-		if (rc) { std::cout << "Error: Unable to join thread " << rc << std::endl; exit(-1); }
-		delete args[i];
-	}
-
-#if VERBOSE
-	std::cout << "-> END clear pixels" << std::endl;
-#endif
-
 	// UPDATE PARTICLES
 #if VERBOSE
 	std::cout << "BEGIN update particles" << std::endl;
 #endif
 
-	for (int i = 0; i < threadNumber; i++)
-	{
-		args[i] = new ArgStruct (this, i);
-		int rc = pthread_create (&threads[i], NULL, &Cloud::updateParticles, (void *) args[i]);
-		if (rc) { std::cout << "Error: Unable to create thread " << rc << std::endl; exit(-1); }
-	}
+	workers.run (&Cloud::updateParticles, this);
 
-	for (int i = 0; i < threadNumber; i++)
-	{
-		int rc = pthread_join (threads[i], &status);
-		if (rc) { std::cout << "Error: Unable to join thread " << rc << std::endl; exit(-1); }
-		delete args[i];
-	}		
-	
 #if VERBOSE
 	std::cout << "-> END update particles" << std::endl;
 #endif
@@ -522,22 +487,12 @@ void Cloud::computeParticles ()
 	std::cout << "BEGIN apply particles" << std::endl;
 #endif
 
-	for (int i = 0; i < threadNumber; i++)
-	{
-		args[i] = new ArgStruct (this, i);
-		int rc = pthread_create (&threads[i], NULL, &Cloud::applyParticles, (void *) args[i]);
-		if (rc) { std::cout << "Error: Unable to create thread " << rc << std::endl; exit(-1); }
-	}
+	workers.run (&Cloud::applyParticles, this);
+	tileBins.computeOffsets ();
+	workers.run (&Cloud::binParticles, this);
 
-	for (int i = 0; i < threadNumber; i++)
-	{
-		int rc = pthread_join (threads[i], &status);
-		if (rc) { std::cout << "Error: Unable to join thread " << rc << std::endl; exit(-1); }
-		delete args[i];
-	}		
-	
 #if VERBOSE
-	std::cout << "-> END update particles" << std::endl;
+	std::cout << "-> END apply particles" << std::endl;
 #endif
 
 	// APPLY PIXELS
@@ -545,36 +500,25 @@ void Cloud::computeParticles ()
 	std::cout << "BEGIN apply pixels" << std::endl;
 #endif
 
-	for (int i = 0; i < threadNumber; i++)
-	{
-		args[i] = new ArgStruct (this, i);
-		int rc = pthread_create (&threads[i], NULL, &Cloud::applyPixels, (void *) args[i]);
-		if (rc) { std::cout << "Error: Unable to create thread " << rc << std::endl; exit(-1); }
-	}
-
-	for (int i = 0; i < threadNumber; i++)
-	{
-		int rc = pthread_join (threads[i], &status);
-		if (rc) { std::cout << "Error: Unable to join thread " << rc << std::endl; exit(-1); }
-		delete args[i];
-	}
+	workers.run (&Cloud::applyPixels, this);
 
 #if VERBOSE
 	std::cout << "-> END apply pixels" << std::endl;
 #endif
-
-	delete [] args;
 }
 
 
+// Overlays are composited over the frame itself, which applyPixels rewrites
+// entirely at each frame
 void Cloud::computeFrame ()
 {
-	finalFrame = frame->clone();
+	finalFrame = *frame;
+	overlay.clear ();
 
 	if (displayBodies) {
 		for (unsigned int j = 0; j < bodyList->size(); j++) {
 			Body *body = bodyList->at(j);
-			cv::circle (finalFrame, cv::Point (body->rX, body->rY), 1, cv::Scalar(250,200,100), 3);
+			overlay.addMark (cv::Point (body->rX, body->rY), cv::Scalar (250, 200, 100, 255));
 		}
 	}
 
@@ -590,7 +534,7 @@ void Cloud::computeFrame ()
 			ss.str("");
 			ss << parameters[parameter].str << " = " << getParameter (parameter);
 			str = ss.str();
-			cv::putText (finalFrame, str, cv::Point(x,y), cv::FONT_HERSHEY_PLAIN, 1, cv::Scalar(255,255,255), 2);
+			overlay.addText (str, cv::Point (x, y));
 			y += 20;
 		}
 		
@@ -599,38 +543,36 @@ void Cloud::computeFrame ()
 		ss.str("");
 		if (borderMode == MIRROR_BORDERS) { ss << "[b] borders = TRUE"; } else { ss << "[b] borders = FALSE"; }
 		str = ss.str();
-		cv::putText (finalFrame, str, cv::Point(x,y), cv::FONT_HERSHEY_PLAIN, 1, cv::Scalar(255,255,255), 2);
+		overlay.addText (str, cv::Point (x, y));
 		y += 20;
 
 		ss.str("");
 		ss << "mouse = (" << mouseX << "," << mouseY << ")";
 		str = ss.str();
-		cv::putText (finalFrame, str, cv::Point(x,y), cv::FONT_HERSHEY_PLAIN, 1, cv::Scalar(255,255,255), 2);
+		overlay.addText (str, cv::Point (x, y));
 		y += 30;
 		
 
 		ss.str("");
 		ss << "windows = " << graphicsWidth << " x " << graphicsHeight;
 		str = ss.str();
-		cv::putText (finalFrame, str, cv::Point(x,y), cv::FONT_HERSHEY_PLAIN, 1, cv::Scalar(255,255,255), 2);
+		overlay.addText (str, cv::Point (x, y));
 		y += 20;
 
 		ss.str("");
 		ss << "particles = " << particleNumber;
 		str = ss.str();
-		cv::putText (finalFrame, str, cv::Point(x,y), cv::FONT_HERSHEY_PLAIN, 1, cv::Scalar(255,255,255), 2);
+		overlay.addText (str, cv::Point (x, y));
 		y += 20;
 
 		ss.str("");
 		ss << "threads = " << threadNumber;
 		str = ss.str();
-		cv::putText (finalFrame, str, cv::Point(x,y), cv::FONT_HERSHEY_PLAIN, 1, cv::Scalar(255,255,255), 2);
+		overlay.addText (str, cv::Point (x, y));
 		y += 20;
 
 
-		struct timeval drawTimer;
-		gettimeofday (&drawTimer, NULL);
-		int seconds = floor ((drawTimer.tv_sec - parameterTimer.tv_sec) + (float) (drawTimer.tv_usec - parameterTimer.tv_usec) / MILLION);
+		int seconds = floor (FramePacer::getTime() - parameterStartTime);
 		int hours = floor (seconds / 3600);
 		seconds = seconds % 3600;
 		int minutes = floor (seconds / 60);
@@ -639,19 +581,19 @@ void Cloud::computeFrame ()
 		ss.str("");
 		ss << "time = " << std::setfill('0') << std::setw(2) << hours << ":" << std::setw(2) << minutes << ":" << std::setw(2) << seconds;
 		str = ss.str();
-		cv::putText (finalFrame, str, cv::Point(x,y), cv::FONT_HERSHEY_PLAIN, 1, cv::Scalar(255,255,255), 2);
+		overlay.addText (str, cv::Point (x, y));
 		y += 20;
 			
 		ss.str("");
 		ss << "frame = " << frameNb;
 		str = ss.str();
-		cv::putText (finalFrame, str, cv::Point(x,y), cv::FONT_HERSHEY_PLAIN, 1, cv::Scalar(255,255,255), 2);
+		overlay.addText (str, cv::Point (x, y));
 		y += 20;
 
 		ss.str("");
 		ss << "graphics = " << graphicsFps << "fps";
 		str = ss.str();
-		cv::putText (finalFrame, str, cv::Point(x,y), cv::FONT_HERSHEY_PLAIN, 1, cv::Scalar(255,255,255), 2);
+		overlay.addText (str, cv::Point (x, y));
 		y += 20;
 
 	}
@@ -670,10 +612,12 @@ void Cloud::computeFrame ()
 			ss.str("");
 			ss << "(" << body->x << ", " << body->y << ") -> " << body->weight;
 			str = ss.str();
-			cv::putText (finalFrame, str, cv::Point(x,y), cv::FONT_HERSHEY_PLAIN, 1, cv::Scalar(255,255,255), 2);
+			overlay.addText (str, cv::Point (x, y));
 			y += 20;
 		}
 	}
+
+	overlay.apply (finalFrame, false);
 }
 
 
@@ -683,7 +627,8 @@ void Cloud::displayFrame ()
 	int texture_pitch = 0;
 
 	SDL_LockTexture (texture, 0, (void **) &texture_data, &texture_pitch);
-	memcpy (texture_data, (void *) finalFrame.data, finalFrame.cols * finalFrame.rows * finalFrame.channels());
+	int rowSize = finalFrame.cols * finalFrame.channels();
+	for (int y = 0; y < finalFrame.rows; y++) { memcpy (texture_data + y * texture_pitch, finalFrame.ptr<uchar>(y), rowSize); }
 	SDL_UnlockTexture (texture);
 	
 	SDL_RenderClear (renderer);
@@ -821,18 +766,16 @@ void Cloud::displayFrame ()
 
 			case SDL_SCANCODE_PAGEUP :
 			{
-				struct timeval writeTimer;
-				gettimeofday (&writeTimer, NULL);
-				double currentTimestamp = (writeTimer.tv_sec - parameterTimer.tv_sec) + (float) (writeTimer.tv_usec - parameterTimer.tv_usec) / MILLION;
+				double currentTimestamp = FramePacer::getTime() - parameterStartTime;
 
 				std::stringstream ss;
 				ss.str("");
-				ss << "particle-positions-" << currentTimestamp << ".csv";
-				recordParticlePositions (ss.str());
+				ss << "particle-positions-" << currentTimestamp << (textSnapshots ? TEXT_SNAPSHOT_EXTENSION : SNAPSHOT_EXTENSION);
+				captureParticlePositions (ss.str(), true);
 			}
 			break;
 			
-			case SDL_SCANCODE_PAGEDOWN : readParticlePositions ("particle-positions.csv"); break;
+			case SDL_SCANCODE_PAGEDOWN : readParticlePositions (ParticleSnapshot::find ("particle-positions")); break;
 
 				// Control body weight
 			case SDL_SCANCODE_SPACE :
@@ -915,24 +858,36 @@ void Cloud::displayFrame ()
 void Cloud::recordFrame ()
 {
 	std::string frameStr = std::string (5 - floor(log10(frameNb)), '0') + std::to_string(frameNb);
-	std::string filename = outputFilename + "-" + frameStr + ".png";
-	std::vector<int> params;
-	params.push_back (CV_IMWRITE_PNG_COMPRESSION);
-	params.push_back (0);
-	cv::imwrite (filename, finalFrame, params);
-	std::cout << "SCREENSHOT: " << filename << std::endl;
+	recorder.push (finalFrame, outputFilename + "-" + frameStr + ".png");
+}
+
+
+void Cloud::streamFrame ()
+{
+	video.write (finalFrame, workers);
 }
 
 
 void Cloud::recordParticlePositions (int index)
 {
 	std::stringstream ss;
-	ss << "particle-positions-" << index << ".csv";
+	ss << "particle-positions-" << index << (textSnapshots ? TEXT_SNAPSHOT_EXTENSION : SNAPSHOT_EXTENSION);
 	recordParticlePositions (ss.str());
 }
 
 
+// Binary snapshot, or text lines for TEXT_SNAPSHOT_EXTENSION files
 void Cloud::recordParticlePositions (std::string filename)
+{
+	if (ParticleSnapshot::isText (filename)) { exportParticlePositions (filename); return; }
+
+	const float *arrays[] = { &particlePosition[0].x, &particleSpeed[0].x };
+	if (ParticleSnapshot::write (filename, particleNumber, graphicsWidth, graphicsHeight, 6, 3, arrays)) { std::cout << "SAVING PARTICLE POSITIONS: " << filename << std::endl; }
+	else { std::cout << "COULD NOT WRITE FILE: " << filename << std::endl; }
+}
+
+
+void Cloud::exportParticlePositions (std::string filename)
 {
 	std::ofstream outputParticleFile;
 	outputParticleFile.open (filename, std::ios::out | std::ios::trunc);
@@ -949,49 +904,50 @@ void Cloud::recordParticlePositions (std::string filename)
 }
 
 
+// Copies the particles and writes them on a background thread, text files
+// are written right away
+void Cloud::captureParticlePositions (std::string filename, bool verbose)
+{
+	if (ParticleSnapshot::isText (filename)) { exportParticlePositions (filename); return; }
+
+	const float *arrays[] = { &particlePosition[0].x, &particleSpeed[0].x };
+	snapshotWriter.capture (filename, particleNumber, graphicsWidth, graphicsHeight, 6, 3, arrays, verbose);
+}
+
+
 void Cloud::readParticlePositions (int index)
 {
 	std::stringstream ss;
-	ss << "particle-positions-" << index << ".csv";
-	readParticlePositions (ss.str());
+	ss << "particle-positions-" << index;
+	readParticlePositions (ParticleSnapshot::find (ss.str()));
 }
 
 
+// Particles beyond the end of the snapshot keep their state
 void Cloud::readParticlePositions (std::string filename)
 {
-	std::ifstream inputParticleFile;
-	inputParticleFile.open (filename, std::ios::in);
+	if (ParticleSnapshot::isText (filename)) { importParticlePositions (filename); return; }
 
-	if (! inputParticleFile.is_open()) { std::cout << "COULD NOT OPEN FILE: " << filename << std::endl; }
-	else {
-		std::cout << "LOADING PARTICLE POSITIONS: " << filename << std::endl;
+	ParticleSnapshot snapshot;
+	if (! snapshot.open (filename)) { std::cout << "COULD NOT OPEN FILE: " << filename << std::endl; return; }
+	std::cout << "LOADING PARTICLE POSITIONS: " << filename << std::endl;
 
-		int i = 0;
-		std::string line;
-		float x, y, z, dx, dy, dz;
-	
-		while (std::getline (inputParticleFile, line) && i < particleNumber) {
-			std::istringstream ss (line);
-			ss >> x >> y >> z >> dx >> dy >> dz;
-			particlePosition[i].x = x;
-			particlePosition[i].y = y;
-			particlePosition[i].z = z;
-			particleSpeed[i].x = dx;
-			particleSpeed[i].y = dy;
-			particleSpeed[i].z = dz;
-			i++;
-		}
+	float *arrays[] = { &particlePosition[0].x, &particleSpeed[0].x };
+	if (snapshot.read (arrays, 6, 3, particleNumber) < 0) { std::cout << "WRONG PARTICLE FIELDS: " << filename << std::endl; }
+}
 
-		inputParticleFile.close ();
-	}
+
+void Cloud::importParticlePositions (std::string filename)
+{
+	float *arrays[] = { &particlePosition[0].x, &particleSpeed[0].x };
+	if (ParticleSnapshot::importText (filename, arrays, 6, 3, particleNumber) < 0) { std::cout << "COULD NOT OPEN FILE: " << filename << std::endl; }
+	else { std::cout << "LOADING PARTICLE POSITIONS: " << filename << std::endl; }
 }
 
 
-void *Cloud::updateParticles (void *args)
+void Cloud::updateParticles (void *cloud, int id)
 {
-	ArgStruct *argStruct = (ArgStruct *) args;
-	reinterpret_cast<Cloud*>(argStruct->cloud)->updateParticles (argStruct->id);
-	pthread_exit (NULL);
+	reinterpret_cast<Cloud*>(cloud)->updateParticles (id);
 }
 
 
@@ -1082,58 +1038,74 @@ void Cloud::updateParticles (int id)
 		particleSpeed[i] = spd;
 
 	}
-	pthread_exit (NULL);
 }
 
 
-void *Cloud::clearPixels (void *args)
+void Cloud::applyParticles (void *cloud, int id)
 {
-	ArgStruct *argStruct = (ArgStruct *) args;
-	reinterpret_cast<Cloud*>(argStruct->cloud)->clearPixels (argStruct->id);
-	pthread_exit (NULL);
+	reinterpret_cast<Cloud*>(cloud)->applyParticles (id);
 }
 
-void Cloud::clearPixels (int id)
+// Pixels and bands of the particles are recorded, then sorted by band so that
+// each band is counted by a single worker: no increment is lost, and the
+// counts do not depend on the number of threads
+void Cloud::applyParticles (int id)
 {
-	for (int i = firstPixel[id]; i < lastPixel[id]; i++) { pixels[i] = 0; }
+	tileBins.clear (id);
+	for (int i = firstParticle[id]; i < lastParticle[id]; i++) {
+		cv::Point2f pix = particlePixel[i];
+		if (pix.x >= 0 && pix.x < graphicsWidth && pix.y >= 0 && pix.y < graphicsHeight) {
+			particlePixels[i] = (int) pix.x + (int) pix.y * graphicsWidth;
+			particleTiles[i] = tileBins.grid.getTile ((int) pix.x, (int) pix.y);
+			tileBins.count (id, particleTiles[i]);
+		}
+		else { particleTiles[i] = -1; }
+	}
 }
 
 
-void *Cloud::applyParticles (void *args)
+void Cloud::binParticles (void *cloud, int id)
 {
-	ArgStruct *argStruct = (ArgStruct *) args;
-	reinterpret_cast<Cloud*>(argStruct->cloud)->applyParticles (argStruct->id);
-	pthread_exit (NULL);
+	reinterpret_cast<Cloud*>(cloud)->binParticles (id);
 }
 
-void Cloud::applyParticles (int id)
+void Cloud::binParticles (int id)
 {
 	for (int i = firstParticle[id]; i < lastParticle[id]; i++) {
-		cv::Point2f pix = particlePixel[i];
-		if (pix.x >= 0 && pix.x < graphicsWidth && pix.y >= 0 && pix.y < graphicsHeight) { pixels [(int) pix.x + (int) pix.y * graphicsWidth]++; }
+		if (particleTiles[i] >= 0) { tileBins.insert (id, particleTiles[i], particlePixels[i]); }
 	}
 }
 
 
 
-void *Cloud::applyPixels (void *args)
+void Cloud::applyPixels (void *cloud, int id)
 {
-	ArgStruct *argStruct = (ArgStruct *) args;
-	reinterpret_cast<Cloud*>(argStruct->cloud)->applyPixels (argStruct->id);
-	pthread_exit (NULL);
+	reinterpret_cast<Cloud*>(cloud)->applyPixels (id);
 }
 
 
+// Each band is counted by a single worker, then converted while in cache
 void Cloud::applyPixels (int id)
 {
+	const int *entries = tileBins.entries.data();
 	uchar *pixel = frame->ptr<uchar>(0);
-	for (int i = firstPixel[id]; i < lastPixel[id]; i++)
+	for (int band = id; band < tileBins.grid.tileNumber; band += threadNumber)
 	{
-		int c = pixels[i];
-		int i3 = i*3;
-		pixel[i3] = particleBlueArray[c] * pixelIntensity;
-		pixel[i3+1] = particleGreenArray[c] * pixelIntensity;
-		pixel[i3+2] = particleRedArray[c] * pixelIntensity;		
+		int first = tileBins.grid.getFirstY (band) * graphicsWidth;
+		int last = tileBins.grid.getLastY (band) * graphicsWidth;
+		std::fill (pixels + first, pixels + last, 0);
+
+		int lastEntry = tileBins.getLastEntry (band);
+		for (int k = tileBins.getFirstEntry (band); k < lastEntry; k++) { pixels[entries[k]]++; }
+
+		for (int i = first; i < last; i++)
+		{
+			int c = pixels[i];
+			int i3 = i*3;
+			pixel[i3] = particleBlueArray[c] * pixelIntensity;
+			pixel[i3+1] = particleGreenArray[c] * pixelIntensity;
+			pixel[i3+2] = particleRedArray[c] * pixelIntensity;
+		}
 	}
 }
 
@@ -1159,10 +1131,11 @@ int ms_sleep (unsigned int ms)
 // PARAMETERS
 
 void Cloud::openOutputParameterFile (std::string filename) {
-	if (outputParameterFile.is_open()) { closeOutputParameterFile(); }
-	gettimeofday (&parameterTimer, NULL);
-	outputParameterFile.open (filename, std::ios::out | std::ios::trunc);
-	if (outputParameterFile) { std::cout << "WRITE PARAMETER SEQUENCE: " << filename << std::endl; } else { std::cerr << "CANNOT WRITE PARAMETER SEQUENCE: " << filename << std::endl; }	
+	closeOutputParameterFile();
+	parameterStartTime = FramePacer::getTime();
+	std::vector<std::string> names;
+	for (int p = 0; p < PARAMETER_NUMBER; p++) { names.push_back (parameters[p].name); }
+	if (parameterRecorder.open (filename, names)) { std::cout << "WRITE PARAMETER SEQUENCE: " << filename << std::endl; } else { std::cerr << "CANNOT WRITE PARAMETER SEQUENCE: " << filename << std::endl; }	
 }
 
 void Cloud::writeOutputParameterFile ()
@@ -1170,12 +1143,12 @@ void Cloud::writeOutputParameterFile ()
 	for (int p = 0; p < PARAMETER_NUMBER; p++) { setParameter (p, getParameter (p)); }
 }
 
-void Cloud::closeOutputParameterFile () { outputParameterFile.close(); }
+void Cloud::closeOutputParameterFile () { parameterRecorder.close(); }
 
 
 void Cloud::openInputParameterFile (std::string filename) {
 	if (inputParameterFile.is_open()) { closeInputParameterFile(); }
-	gettimeofday (&parameterTimer, NULL);
+	parameterStartTime = FramePacer::getTime();
 	inputParameterFile.open (filename, std::ios::in);
 
 	if (inputParameterFile) { std::cout << "READ PARAMETER SEQUENCE: " << filename << std::endl; } else { std::cerr << "CANNOT READ PARAMETER SEQUENCE: " << filename << std::endl; }	
@@ -1187,9 +1160,7 @@ void Cloud::readInputParameterFile ()
 				double currentTimestamp;
 				if (constantDelay > 0) { currentTimestamp = currentDelay; }
 				else {
-				struct timeval readTimer;
-				gettimeofday (&readTimer, NULL);
-				currentTimestamp = (readTimer.tv_sec - parameterTimer.tv_sec) + (float) (readTimer.tv_usec - parameterTimer.tv_usec) / MILLION;
+				currentTimestamp = FramePacer::getTime() - parameterStartTime;
 			}
 				
 	std::istringstream iss;
@@ -1205,8 +1176,8 @@ void Cloud::readInputParameterFile ()
 		if (name == "particlePositions") {
 				std::stringstream ss;
 				ss.str("");
-				ss << "particle-positions-" << value << ".csv";
-				readParticlePositions (ss.str());
+				ss << "particle-positions-" << value;
+				readParticlePositions (ParticleSnapshot::find (ss.str()));
 			}
 		
 		else if (name == "particleInit") { initParticles (UNIFORM_INIT); }
@@ -1484,10 +1455,8 @@ void Cloud::setParameter (int parameter, float value, bool write)
 	}
 
 	if (write && recordParameters) {
-		struct timeval recordTimer;
-		gettimeofday (&recordTimer, NULL);
-		double timestamp = (recordTimer.tv_sec - parameterTimer.tv_sec) + (float) (recordTimer.tv_usec - parameterTimer.tv_usec) / MILLION;
-		outputParameterFile << timestamp << " " << parameters[parameter].name << " " << value << "\n";
+		double timestamp = FramePacer::getTime() - parameterStartTime;
+		parameterRecorder.set (parameter, timestamp, value);
 	}
 }
 
@@ -37,6 +37,15 @@
 #include <SDL.h>
 #include <opencv2/opencv.hpp>
 
+#include "worker_pool.hpp"
+#include "tile_bins.hpp"
+#include "overlay_layer.hpp"
+#include "frame_pacer.hpp"
+#include "frame_recorder.hpp"
+#include "particle_snapshot.hpp"
+#include "parameter_recorder.hpp"
+#include "video_stream.hpp"
+
 #define VERBOSE 0
 #define MILLION 1000000L
 #define BILLION 1000000000L
@@ -87,12 +96,6 @@ class Cloud;
 struct Body;
 typedef std::vector<Body*> BodyList;
 
-struct ArgStruct {
-	Cloud *cloud;
-	int id;
-	ArgStruct (Cloud *vCloud, int vId) : cloud (vCloud), id (vId) {};
-};
-
 
 // PARAMETER STRUCTURE
 
@@ -308,8 +311,15 @@ public:
 	bool displayFullscreen    = true;
 
 	bool recordParticles      = false;
+	int recordThreadNumber    = RECORDER_THREAD_NUMBER;   // PNG encoders (set before init)
+	int recordQueueSize       = RECORDER_QUEUE_SIZE;      // frames copied and waiting for the encoders (set before init)
+	bool recordLive           = false;   // drop the recorded frames when the encoders are behind, instead of waiting for them (set before init)
+	bool recordVideo          = false;   // stream the recorded frames to videoFilename, a file or a named pipe read by ffmpeg (set before init)
+	int videoFormat           = Y4M_STREAM;
+	float videoFrameRate      = DEFAULT_VIDEO_FRAME_RATE;
 	bool recordParameters     = false;
 	bool readParameters       = !recordParameters;
+	bool textSnapshots        = false;   // record particle snapshots as text lines instead of binary files
 	
 	std::string inputParameterFilename  = "static-cells-input-sequence.csv";
 	std::string outputParameterFilename = "static-cells-output-sequence.csv";
@@ -327,7 +337,7 @@ public:
 
 	int graphicsWidth         = 1920;
 	int graphicsHeight        = 1080;
-	int threadNumber          = 8;
+	int threadNumber          = 8;       // 0 to use every available processor
 
 // PHYSICS PARAMETER
 	int borderMode            = MIRROR_BORDERS;
@@ -365,7 +375,6 @@ public:
 
 // PROGRAM PARAMETERS
 	static const int maxParticleNumber   = 1000000;
-	static const int maxThreadNumber     = 16;
 	const float maxParticleSpeed         = 1000000.;
 	
 // PROGRAM VARIABLES
@@ -373,8 +382,9 @@ public:
 
 	std::string configFilename = "";
 	std::string outputFilename = "";
+	std::string videoFilename = "";
 	std::ifstream inputParameterFile;
-	std::ofstream outputParameterFile;
+	ParameterRecorder parameterRecorder;
 	std::string inputParameterLine;
 
 	int mouseX, mouseY;
@@ -389,14 +399,11 @@ public:
 	EventList events;
 
 	int frameNb;
-	int sumFrameNb;
 	float delay;
-	float sumDelay;
 	float currentDelay;
+	FramePacer pacer;
 
-	struct timeval startTimer;
-	struct timeval endTimer;
-	struct timeval parameterTimer;
+	double parameterStartTime;               // FramePacer time at which the parameter sequence started
 
 // PHYSICS VARIABLES
 	float rDistance;
@@ -416,7 +423,11 @@ public:
 
 	int *pixels;
 	cv::Mat *frame;
-	cv::Mat finalFrame;
+	cv::Mat finalFrame;                       // the frame with its overlays, no copy of it
+	OverlayLayer overlay;
+	FrameRecorder recorder;
+	VideoStream video;
+	SnapshotWriter snapshotWriter;
 	int frameIndex;
 	int firstFrameIndex = 0;
 
@@ -430,14 +441,14 @@ public:
 	float bodyBottomWeight;
 
 // THREAD VARIABLES
-	void *status;
-	pthread_attr_t attr;
+	WorkerPool workers;
+
+	std::vector<int> firstParticle;
+	std::vector<int> lastParticle;
 
-	pthread_t threads [maxThreadNumber];
-	int firstParticle [maxThreadNumber];
-	int lastParticle [maxThreadNumber];
-	int firstPixel [maxThreadNumber];
-	int lastPixel [maxThreadNumber];
+	TileBins tileBins;               // bands of rows, each counted by a single worker
+	std::vector<int> particlePixels;
+	std::vector<int> particleTiles;  // -1 for particles out of the screen
 
 	Cloud ();
 	~Cloud ();
@@ -463,6 +474,7 @@ public:
 	void computeFrame ();
 	void displayFrame ();
 	void recordFrame ();
+	void streamFrame ();
 
 	void projectBodies ();
 	void projectParticles ();
@@ -472,19 +484,22 @@ public:
 
 	void recordParticlePositions (int index);
 	void recordParticlePositions (std::string filename);
+	void exportParticlePositions (std::string filename);
 	void readParticlePositions (int index);
 	void readParticlePositions (std::string filename);
+	void importParticlePositions (std::string filename);
+	void captureParticlePositions (std::string filename, bool verbose);
 
-	static void *updateParticles (void *args);
+	static void updateParticles (void *cloud, int id);
 	void updateParticles (int id);
 
-	static void *applyParticles (void *args);
+	static void applyParticles (void *cloud, int id);
 	void applyParticles (int id);
 
-	static void *clearPixels (void *args);
-	void clearPixels (int id);
+	static void binParticles (void *cloud, int id);
+	void binParticles (int id);
 
-	static void *applyPixels (void *args);
+	static void applyPixels (void *cloud, int id);
 	void applyPixels (int id);
 
 	void openOutputParameterFile (std::string filename);
@@ -0,0 +1,193 @@
+/*
+ * This file is part of Moving Cells.
+ *
+ * Moving Cells is is a digital installation building on a depth sensor to
+ * allow spectators to interact with a cloud of particles through their movements.
+ * It has been developed and first displayed in June 2015 by Robin Lamarche-Perrin
+ * and Bruno Pace for the eponymous dance festival, in Leipzig.
+ * See: http://www.movingcells.org
+ * 
+ * The current version of the program is implemented on Kinect for Windows v2 (K4W2)
+ * through the open source driver libreenect2.
+ * See: https://github.com/OpenKinect/libfreenect2
+ * 
+ * Copyright © 2015-2017 Robin Lamarche-Perrin and Bruno Pace
+ * (<Robin.Lamarche-Perrin@lip6.fr>)
+ * 
+ * Moving Cells is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ * 
+ * Moving Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// FRAME BENCHMARK
+//
+// Measures the particle phase of Cloud (move, count, clean and convert to
+// colors) at 1080p and 4K with the three pixel pipelines:
+//   direct  particles counted straight into the count buffer, cleaned and
+//           converted in a separate pass (tileBinning and fusedPixels off).
+//           Several workers always bin their particles, so that each tile
+//           is counted by one of them: this one runs on a single thread;
+//   tiles   particles binned by screen tile and counted tile by tile, then
+//           the same separate pass (tileBinning on);
+//   fused   particles binned by band of rows, each band being counted,
+//           cleaned and converted by one worker in a single pass
+//           (fusedPixels on);
+//   fixed   the same with 16-bit fixed-point densities (fixedPixels on).
+//
+// Next to the time per frame, it reports the memory traffic per frame, as
+// estimated from the buffers each pass streams through: 16 bytes per
+// particle read and written by the move, the pixel, tile and entry arrays of
+// the binning, one cache line per particle increment outside of a binned
+// tile (up to the size of the count buffer), then 4 bytes per pixel of
+// counts read and reset, 4 bytes per pixel of density read and
+// written, and 3 bytes per pixel of frame written. Counts of a fused band
+// are still in cache when the band is converted, so they only cost one read
+// and one write. Hardware counters would give the real figure (e.g. with
+// perf stat -e LLC-load-misses,LLC-store-misses), the estimate is there to
+// compare the pipelines on any machine.
+//
+// Frames of the four pipelines, and densities of the float ones, are checked
+// to be identical (pixels are not faded, so that fixed-point densities are
+// exact).
+//
+// Usage: frame-benchmark [threadNumber] [frameNumber]
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <vector>
+#include <sys/time.h>
+
+#include "cloud.hpp"
+
+
+#define DIRECT_PIPELINE           0
+#define TILE_PIPELINE             1
+#define FUSED_PIPELINE            2
+#define FIXED_PIPELINE            3
+
+#define CACHE_LINE_SIZE           64
+
+struct Resolution { const char *name; int width; int height; };
+
+const Resolution resolutions[] = {
+	{ "1080p", 1920, 1080 },
+	{ "4K",    3840, 2160 }
+};
+
+const char *pipelineNames[] = { "direct-1", "tiles", "fused", "fixed" };
+
+
+double getTime ()
+{
+	struct timeval timer;
+	gettimeofday (&timer, NULL);
+	return timer.tv_sec + timer.tv_usec / 1e6;
+}
+
+
+// Estimated bytes read and written per frame (see above)
+double getTraffic (int pipeline, double particleNumber, double pixelNumber)
+{
+	double traffic = particleNumber * 16 * 2;
+
+	if (pipeline == DIRECT_PIPELINE) {
+		double lines = std::min (particleNumber, pixelNumber * sizeof (unsigned int) / CACHE_LINE_SIZE);
+		traffic += lines * CACHE_LINE_SIZE * 2;
+		traffic += pixelNumber * sizeof (unsigned int) * 2;
+	}
+
+	else {
+		traffic += particleNumber * 2 * sizeof (int) * 2;      // particle pixels and tiles
+		traffic += particleNumber * sizeof (int) * 2;          // tile entries
+		traffic += pixelNumber * sizeof (unsigned int) * 2;    // counted tile by tile
+		if (pipeline == TILE_PIPELINE) { traffic += pixelNumber * sizeof (unsigned int) * 2; }
+	}
+
+	if (pipeline == FIXED_PIPELINE) { traffic += pixelNumber * sizeof (uint16_t) * 2; }
+	else { traffic += pixelNumber * sizeof (float) * 2; }
+	traffic += pixelNumber * 3;
+	return traffic;
+}
+
+
+int main (int argc, char *argv[])
+{
+	int threadNumber = (argc > 1) ? atoi (argv[1]) : 0;
+	int frameNumber = (argc > 2) ? atoi (argv[2]) : 50;
+	if (threadNumber <= 0) { threadNumber = WorkerPool::getProcessorNumber(); }
+	if (frameNumber <= 0) { frameNumber = 1; }
+
+	std::cout << "FRAME BENCHMARK: " << threadNumber << " threads, " << frameNumber << " frames, L2 cache " << TileGrid::getCacheSize() / 1024 << " KB" << std::endl;
+	std::cout << std::setw (6) << "res" << std::setw (10) << "particles" << std::setw (10) << "pipeline" << std::setw (8) << "tiles"
+			  << std::setw (12) << "ms/frame" << std::setw (12) << "MB/frame" << std::setw (10) << "GB/s" << std::endl;
+
+	for (unsigned int r = 0; r < sizeof (resolutions) / sizeof (Resolution); r++) {
+		std::vector<float> reference;
+		std::vector<uchar> referenceFrame;
+
+		for (int pipeline = DIRECT_PIPELINE; pipeline <= FIXED_PIPELINE; pipeline++) {
+			srand (0);
+			Cloud *cloud = new Cloud ();
+			cloud->displayParticles = false;
+			cloud->readParameters = false;
+			cloud->threadNumber = (pipeline == DIRECT_PIPELINE) ? 1 : threadNumber;
+			cloud->constantDelay = 0.02;
+			cloud->reorderFrequency = 0;
+			cloud->graphicsWidth = resolutions[r].width;
+			cloud->graphicsHeight = resolutions[r].height;
+			cloud->particleNumber = cloud->graphicsWidth * cloud->graphicsHeight / 9;
+			cloud->tileBinning = (pipeline == TILE_PIPELINE);
+			cloud->fusedPixels = (pipeline == FUSED_PIPELINE || pipeline == FIXED_PIPELINE);
+			cloud->fixedPixels = (pipeline == FIXED_PIPELINE);
+			cloud->init ();
+
+			cloud->setParameter (BODY_X, 0.3, false);
+			cloud->setParameter (BODY_Y, 0.3, false);
+			cloud->setParameter (BODY_WEIGHT, 1, false);
+			cloud->updateBodies ();
+
+			double total = 0;
+			for (int frame = 0; frame <= frameNumber; frame++) {
+				cloud->getTime ();
+				cloud->updatePhysics ();
+				double t0 = getTime ();
+				cloud->computeParticles ();
+				double t1 = getTime ();
+
+				// The first frame only warms up the caches
+				if (frame > 0) { total += t1 - t0; }
+			}
+
+			int pixelNumber = cloud->graphicsWidth * cloud->graphicsHeight;
+			uchar *frame = cloud->frame->ptr<uchar>(0);
+			if (pipeline == DIRECT_PIPELINE) {
+				reference.assign (cloud->pixels, cloud->pixels + pixelNumber);
+				referenceFrame.assign (frame, frame + pixelNumber * 3);
+			}
+			else if (pipeline != FIXED_PIPELINE && !std::equal (reference.begin(), reference.end(), cloud->pixels)) { std::cerr << "Error: " << pipelineNames[pipeline] << " density differs from direct density" << std::endl; exit (-1); }
+			if (!std::equal (referenceFrame.begin(), referenceFrame.end(), frame)) { std::cerr << "Error: " << pipelineNames[pipeline] << " frame differs from direct frame" << std::endl; exit (-1); }
+
+			double traffic = getTraffic (pipeline, cloud->particleNumber, pixelNumber);
+			double time = total / frameNumber;
+			std::cout << std::fixed << std::setprecision (2)
+					  << std::setw (6) << resolutions[r].name << std::setw (10) << cloud->particleNumber << std::setw (10) << pipelineNames[pipeline]
+					  << std::setw (8) << ((pipeline == DIRECT_PIPELINE) ? 0 : cloud->tileBins.grid.tileNumber)
+					  << std::setw (12) << time * 1000 << std::setw (12) << traffic / 1e6 << std::setw (10) << traffic / time / 1e9 << std::endl;
+
+			delete cloud;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,126 @@
+/*
+ * This file is part of Moving Cells.
+ *
+ * Moving Cells is is a digital installation building on a depth sensor to
+ * allow spectators to interact with a cloud of particles through their movements.
+ * It has been developed and first displayed in June 2015 by Robin Lamarche-Perrin
+ * and Bruno Pace for the eponymous dance festival, in Leipzig.
+ * See: http://www.movingcells.org
+ * 
+ * The current version of the program is implemented on Kinect for Windows v2 (K4W2)
+ * through the open source driver libreenect2.
+ * See: https://github.com/OpenKinect/libfreenect2
+ * 
+ * Copyright © 2015-2017 Robin Lamarche-Perrin and Bruno Pace
+ * (<Robin.Lamarche-Perrin@lip6.fr>)
+ * 
+ * Moving Cells is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ * 
+ * Moving Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <time.h>
+
+#include "frame_pacer.hpp"
+
+
+double FramePacer::getTime ()
+{
+	struct timespec time;
+	clock_gettime (CLOCK_MONOTONIC, &time);
+	return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+
+void FramePacer::waitUntil (double time, double spinTime)
+{
+	double wakeTime = time - spinTime;
+	if (wakeTime > getTime ()) {
+		struct timespec wake;
+		wake.tv_sec = (time_t) floor (wakeTime);
+		wake.tv_nsec = (long) ((wakeTime - wake.tv_sec) * 1e9);
+		while (clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, NULL) == EINTR) {}
+	}
+	while (getTime () < time) {}
+}
+
+
+void FramePacer::start ()
+{
+	lastTime = getTime ();
+	deadline = lastTime;
+	reportStartTime = lastTime;
+	frameTimes.clear ();
+	lateFrameNb = 0;
+}
+
+
+float FramePacer::step ()
+{
+	if (lastTime < 0) { start (); }
+
+	double time = getTime ();
+	if (targetRate > 0) {
+		double period = 1. / targetRate;
+		if (vsync) {
+			if (time - lastTime > PACER_LATE_RATIO * period) { lateFrameNb++; }
+		} else {
+			deadline += period;
+			if (time < deadline) {
+				waitUntil (deadline, spinTime);
+				time = getTime ();
+			} else {
+				lateFrameNb++;
+				deadline = time;
+			}
+		}
+	}
+
+	float frameTime = time - lastTime;
+	lastTime = time;
+	frameTimes.push_back (frameTime);
+	return frameTime;
+}
+
+
+bool FramePacer::report ()
+{
+	if (frameTimes.empty () || lastTime - reportStartTime < reportDelay) { return false; }
+
+	reportDuration = lastTime - reportStartTime;
+	reportFrameNb = frameTimes.size ();
+	reportLateFrameNb = lateFrameNb;
+	fps = (int) (reportFrameNb / reportDuration);
+
+	std::sort (frameTimes.begin (), frameTimes.end ());
+	p50 = frameTimes[(int) (0.50 * (reportFrameNb - 1))];
+	p95 = frameTimes[(int) (0.95 * (reportFrameNb - 1))];
+	p99 = frameTimes[(int) (0.99 * (reportFrameNb - 1))];
+
+	frameTimes.clear ();
+	lateFrameNb = 0;
+	reportStartTime = lastTime;
+	return true;
+}
+
+
+void FramePacer::writeReport (std::ostream &stream) const
+{
+	// Frame times in ms, rounded to 0.1ms
+	stream << fps << "fps (p50 " << round (p50 * 10000) / 10 << "ms, p95 " << round (p95 * 10000) / 10 << "ms, p99 " << round (p99 * 10000) / 10 << "ms";
+	if (targetRate > 0) { stream << ", " << reportLateFrameNb << " late"; }
+	stream << ")";
+}
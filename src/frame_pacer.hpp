@@ -0,0 +1,86 @@
+/*
+ * This file is part of Moving Cells.
+ *
+ * Moving Cells is is a digital installation building on a depth sensor to
+ * allow spectators to interact with a cloud of particles through their movements.
+ * It has been developed and first displayed in June 2015 by Robin Lamarche-Perrin
+ * and Bruno Pace for the eponymous dance festival, in Leipzig.
+ * See: http://www.movingcells.org
+ * 
+ * The current version of the program is implemented on Kinect for Windows v2 (K4W2)
+ * through the open source driver libreenect2.
+ * See: https://github.com/OpenKinect/libfreenect2
+ * 
+ * Copyright © 2015-2017 Robin Lamarche-Perrin and Bruno Pace
+ * (<Robin.Lamarche-Perrin@lip6.fr>)
+ * 
+ * Moving Cells is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ * 
+ * Moving Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef FRAME_PACER_HPP
+#define FRAME_PACER_HPP
+
+#include <ostream>
+#include <vector>
+
+
+#define PACER_SPIN_TIME           0.002     // seconds spent spinning before a deadline, as sleeping is not precise enough
+#define PACER_REPORT_DELAY        3         // seconds between two reports
+#define PACER_LATE_RATIO          1.5       // without sleeping, frames longer than this many periods are late
+
+
+// FRAME PACER
+//
+// Paces a loop at a target rate against a CLOCK_MONOTONIC deadline: each
+// step sleeps until shortly before the deadline, then spins until it. Late
+// frames are counted, and the deadline is moved to the current time rather
+// than catching up with a burst of short frames. With vsync, the presentation
+// already waits for the display, so frames are only measured.
+//
+// Frame times are kept until the next report, which gives the frame rate and
+// the 50th, 95th and 99th percentiles of the frame times.
+
+class FramePacer
+{
+public:
+	float targetRate = 0;                     // frames per second, 0 to run as fast as possible
+	bool vsync = false;                       // frames are paced by the display, only measure them at targetRate
+	double spinTime = PACER_SPIN_TIME;
+	double reportDelay = PACER_REPORT_DELAY;
+
+	double lastTime = -1;
+	double deadline = 0;
+	double reportStartTime = 0;
+	std::vector<float> frameTimes;            // since the last report
+	int lateFrameNb = 0;
+
+	// LAST REPORT
+	int fps = 0;
+	int reportFrameNb = 0;
+	int reportLateFrameNb = 0;
+	double reportDuration = 0;
+	float p50 = 0, p95 = 0, p99 = 0;          // frame times, in seconds
+
+	static double getTime ();
+	static void waitUntil (double time, double spinTime);
+
+	void start ();
+	float step ();                            // waits for the next frame, returns the time since the previous one
+	bool report ();                           // true when a new report is ready
+	void writeReport (std::ostream &stream) const;
+};
+
+
+#endif
@@ -0,0 +1,207 @@
+/*
+ * This file is part of Moving Cells.
+ *
+ * Moving Cells is is a digital installation building on a depth sensor to
+ * allow spectators to interact with a cloud of particles through their movements.
+ * It has been developed and first displayed in June 2015 by Robin Lamarche-Perrin
+ * and Bruno Pace for the eponymous dance festival, in Leipzig.
+ * See: http://www.movingcells.org
+ * 
+ * The current version of the program is implemented on Kinect for Windows v2 (K4W2)
+ * through the open source driver libreenect2.
+ * See: https://github.com/OpenKinect/libfreenect2
+ * 
+ * Copyright © 2015-2017 Robin Lamarche-Perrin and Bruno Pace
+ * (<Robin.Lamarche-Perrin@lip6.fr>)
+ * 
+ * Moving Cells is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ * 
+ * Moving Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// LIBRARIES
+
+#include <iostream>
+#include <cstring>
+#include <time.h>
+
+#include "frame_presenter.hpp"
+#include "frame_pacer.hpp"
+
+
+// TRIPLE BUFFER
+
+void TripleBuffer::create (int height, int width, int type)
+{
+	for (int i = 0; i < 3; i++) { frames[i].create (height, width, type); }
+	back = 0;
+	middle = 1;
+	front = 2;
+}
+
+
+bool TripleBuffer::publish ()
+{
+	int previous = middle.exchange (back | FRESH_FRAME, std::memory_order_acq_rel);
+	back = previous & ~FRESH_FRAME;
+	return !(previous & FRESH_FRAME);
+}
+
+
+bool TripleBuffer::acquire ()
+{
+	if (!(middle.load (std::memory_order_acquire) & FRESH_FRAME)) { return false; }
+	int previous = middle.exchange (front, std::memory_order_acq_rel);
+	front = previous & ~FRESH_FRAME;
+	return true;
+}
+
+
+// INPUT QUEUE
+
+InputEvent *InputQueue::getFree ()
+{
+	unsigned int last = tail.load (std::memory_order_relaxed);
+	if (last - head.load (std::memory_order_acquire) == INPUT_QUEUE_SIZE) { return NULL; }
+	return &events[last % INPUT_QUEUE_SIZE];
+}
+
+
+bool InputQueue::pop (InputEvent &event)
+{
+	unsigned int first = head.load (std::memory_order_relaxed);
+	if (first == tail.load (std::memory_order_acquire)) { return false; }
+	event = events[first % INPUT_QUEUE_SIZE];
+	head.store (first + 1, std::memory_order_release);
+	return true;
+}
+
+
+// FRAME PRESENTER
+
+FramePresenter::FramePresenter () : presentedFrameNb (0), droppedFrameNb (0), lateFrameNb (0), droppedInputNb (0), stopping (false)
+{
+	sem_init (&frameSemaphore, 0, 0);
+}
+
+
+FramePresenter::~FramePresenter ()
+{
+	stop ();
+	sem_destroy (&frameSemaphore);
+}
+
+
+// Frames are expected every vFramePeriod seconds, or at the refresh rate of
+// the display when it is 0
+void FramePresenter::start (SDL_Window *window, SDL_Renderer *vRenderer, SDL_Texture *vTexture, float vFramePeriod)
+{
+	if (running) { return; }
+	renderer = vRenderer;
+	texture = vTexture;
+
+	framePeriod = vFramePeriod;
+	if (framePeriod <= 0) {
+		SDL_DisplayMode mode;
+		int refreshRate = DEFAULT_REFRESH_RATE;
+		if (SDL_GetCurrentDisplayMode (SDL_GetWindowDisplayIndex (window), &mode) == 0 && mode.refresh_rate > 0) { refreshRate = mode.refresh_rate; }
+		framePeriod = 1. / refreshRate;
+	}
+
+	lastPresentTime = -1;
+	stopping = false;
+	int rc = pthread_create (&thread, NULL, &FramePresenter::run, (void *) this);
+	if (rc) { std::cout << "Error: Unable to create thread " << rc << std::endl; exit (-1); }
+	running = true;
+}
+
+
+void FramePresenter::stop ()
+{
+	if (!running) { return; }
+	stopping = true;
+	sem_post (&frameSemaphore);
+	pthread_join (thread, NULL);
+	running = false;
+}
+
+
+// Called by the producer once the back buffer holds a complete frame
+void FramePresenter::publish ()
+{
+	if (!buffers.publish ()) { droppedFrameNb++; }
+	sem_post (&frameSemaphore);
+}
+
+
+void *FramePresenter::run (void *presenter)
+{
+	reinterpret_cast<FramePresenter*>(presenter)->run();
+	pthread_exit (NULL);
+}
+
+
+// Waits for frames, polling the input at least every INPUT_POLL_DELAY ms
+void FramePresenter::run ()
+{
+	while (!stopping)
+	{
+		pollInputs ();
+
+		struct timespec timeout;
+		clock_gettime (CLOCK_REALTIME, &timeout);
+		timeout.tv_nsec += INPUT_POLL_DELAY * 1000000L;
+		if (timeout.tv_nsec >= 1000000000L) { timeout.tv_sec++; timeout.tv_nsec -= 1000000000L; }
+		if (sem_timedwait (&frameSemaphore, &timeout) != 0) { continue; }
+
+		if (buffers.acquire ()) { presentFrame (); }
+	}
+}
+
+
+void FramePresenter::pollInputs ()
+{
+	SDL_Event event;
+	while (SDL_PollEvent (&event))
+	{
+		InputEvent *input = inputs.getFree ();
+		if (input == NULL) { droppedInputNb++; continue; }
+		input->event = event;
+		memcpy (input->keyboard, SDL_GetKeyboardState (NULL), SDL_NUM_SCANCODES);
+		inputs.push ();
+	}
+}
+
+
+// The texture rows are padded to its pitch
+void FramePresenter::presentFrame ()
+{
+	cv::Mat &frame = buffers.getFront ();
+	unsigned char *textureData = NULL;
+	int texturePitch = 0;
+
+	if (SDL_LockTexture (texture, NULL, (void **) &textureData, &texturePitch) == 0) {
+		int rowSize = frame.cols * frame.channels();
+		for (int y = 0; y < frame.rows; y++) { memcpy (textureData + y * texturePitch, frame.ptr<uchar>(y), rowSize); }
+		SDL_UnlockTexture (texture);
+	}
+
+	SDL_RenderClear (renderer);
+	SDL_RenderCopy (renderer, texture, NULL, NULL);
+	SDL_RenderPresent (renderer);
+
+	double time = FramePacer::getTime ();
+	if (lastPresentTime >= 0 && time - lastPresentTime > LATE_FRAME_RATIO * framePeriod) { lateFrameNb++; }
+	lastPresentTime = time;
+	presentedFrameNb++;
+}
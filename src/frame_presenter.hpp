@@ -0,0 +1,151 @@
+/*
+ * This file is part of Moving Cells.
+ *
+ * Moving Cells is is a digital installation building on a depth sensor to
+ * allow spectators to interact with a cloud of particles through their movements.
+ * It has been developed and first displayed in June 2015 by Robin Lamarche-Perrin
+ * and Bruno Pace for the eponymous dance festival, in Leipzig.
+ * See: http://www.movingcells.org
+ * 
+ * The current version of the program is implemented on Kinect for Windows v2 (K4W2)
+ * through the open source driver libreenect2.
+ * See: https://github.com/OpenKinect/libfreenect2
+ * 
+ * Copyright © 2015-2017 Robin Lamarche-Perrin and Bruno Pace
+ * (<Robin.Lamarche-Perrin@lip6.fr>)
+ * 
+ * Moving Cells is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ * 
+ * Moving Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef FRAME_PRESENTER_HPP
+#define FRAME_PRESENTER_HPP
+
+#include <atomic>
+#include <pthread.h>
+#include <semaphore.h>
+
+#include <SDL.h>
+#include <opencv2/opencv.hpp>
+
+
+#define INPUT_QUEUE_SIZE          1024      // power of two
+#define INPUT_POLL_DELAY          5         // ms between two polls of the input when no frame comes
+#define LATE_FRAME_RATIO          1.5       // frames presented later than this many frame periods after the previous one are late
+#define DEFAULT_REFRESH_RATE      60
+
+
+// TRIPLE BUFFER
+//
+// Three frames exchanged without locks between a producer and a consumer
+// thread. The producer draws into getBack() then publishes it, the consumer
+// acquires the latest published frame and reads getFront() until its next
+// acquire. Neither ever waits for the other: a published frame replaced by
+// the next one before being acquired is dropped.
+
+class TripleBuffer
+{
+public:
+	cv::Mat frames[3];
+	int back = 0;
+	int front = 2;
+	std::atomic<int> middle;                  // index of the published frame, plus FRESH_FRAME until acquired
+
+	static const int FRESH_FRAME = 4;
+
+	TripleBuffer () : middle (1) {}
+
+	void create (int height, int width, int type);
+	cv::Mat &getBack () { return frames[back]; }
+	cv::Mat &getFront () { return frames[front]; }
+
+	bool publish ();                          // false when the previous published frame is dropped
+	bool acquire ();                          // false when nothing was published since the last acquire
+};
+
+
+// INPUT QUEUE
+//
+// Bounded queue without locks, for one producer thread and one consumer
+// thread. Events are dropped when it is full.
+
+struct InputEvent
+{
+	SDL_Event event;
+	Uint8 keyboard[SDL_NUM_SCANCODES];        // keyboard state when the event was polled
+};
+
+
+class InputQueue
+{
+public:
+	InputEvent events[INPUT_QUEUE_SIZE];
+	std::atomic<unsigned int> head;           // next event to pop
+	std::atomic<unsigned int> tail;           // next event to push
+
+	InputQueue () : head (0), tail (0) {}
+
+	InputEvent *getFree ();                   // NULL when full, then push() to publish it
+	void push () { tail.store (tail.load (std::memory_order_relaxed) + 1, std::memory_order_release); }
+	bool pop (InputEvent &event);
+};
+
+
+// FRAME PRESENTER
+//
+// Presents the frames of a TripleBuffer on its own thread, so that the
+// simulation never waits for the display: uploads to the streaming texture,
+// rendering and vsync all happen here. SDL events are polled here too and
+// forwarded through an InputQueue, to be handled by the simulation thread.
+//
+// Frames are counted as presented, dropped (replaced before being presented)
+// or late (presented more than LATE_FRAME_RATIO frame periods after the
+// previous one). Counters are reset by the caller.
+
+class FramePresenter
+{
+public:
+	TripleBuffer buffers;
+	InputQueue inputs;
+
+	SDL_Renderer *renderer = NULL;
+	SDL_Texture *texture = NULL;
+	float framePeriod = 0;                    // in seconds
+	double lastPresentTime = -1;
+
+	std::atomic<int> presentedFrameNb;
+	std::atomic<int> droppedFrameNb;
+	std::atomic<int> lateFrameNb;
+	std::atomic<int> droppedInputNb;
+
+	bool running = false;
+	std::atomic<bool> stopping;
+	pthread_t thread;
+	sem_t frameSemaphore;
+
+	FramePresenter ();
+	~FramePresenter ();
+
+	void start (SDL_Window *window, SDL_Renderer *vRenderer, SDL_Texture *vTexture, float vFramePeriod);
+	void stop ();
+	void publish ();
+
+	static void *run (void *presenter);
+	void run ();
+	void pollInputs ();
+	void presentFrame ();
+};
+
+
+#endif
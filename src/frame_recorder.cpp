@@ -0,0 +1,158 @@
+/*
+ * This file is part of Moving Cells.
+ *
+ * Moving Cells is is a digital installation building on a depth sensor to
+ * allow spectators to interact with a cloud of particles through their movements.
+ * It has been developed and first displayed in June 2015 by Robin Lamarche-Perrin
+ * and Bruno Pace for the eponymous dance festival, in Leipzig.
+ * See: http://www.movingcells.org
+ * 
+ * The current version of the program is implemented on Kinect for Windows v2 (K4W2)
+ * through the open source driver libreenect2.
+ * See: https://github.com/OpenKinect/libfreenect2
+ * 
+ * Copyright © 2015-2017 Robin Lamarche-Perrin and Bruno Pace
+ * (<Robin.Lamarche-Perrin@lip6.fr>)
+ * 
+ * Moving Cells is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ * 
+ * Moving Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <iostream>
+#include <cmath>
+
+#include "frame_recorder.hpp"
+#include "frame_pacer.hpp"
+
+
+void FrameRecorder::start (int threadNumber, int vQueueSize, bool vDropFrames)
+{
+	if (running) { return; }
+	queueSize = (vQueueSize > 0) ? vQueueSize : RECORDER_QUEUE_SIZE;
+	dropFrames = vDropFrames;
+	queue.resize (queueSize);
+	pushedNb = 0;
+	encodingNb = 0;
+	writtenNb = 0;
+	stopping = false;
+
+	threads.resize ((threadNumber > 0) ? threadNumber : 1);
+	for (unsigned int i = 0; i < threads.size(); i++) {
+		int rc = pthread_create (&threads[i], NULL, &FrameRecorder::run, (void *) this);
+		if (rc) { std::cout << "Error: Unable to create thread " << rc << std::endl; exit (-1); }
+	}
+	running = true;
+}
+
+
+void FrameRecorder::stop ()
+{
+	if (!running) { return; }
+	pthread_mutex_lock (&mutex);
+	stopping = true;
+	pthread_cond_broadcast (&frameCondition);
+	pthread_mutex_unlock (&mutex);
+
+	for (unsigned int i = 0; i < threads.size(); i++) { pthread_join (threads[i], NULL); }
+	threads.clear();
+	running = false;
+}
+
+
+bool FrameRecorder::push (const cv::Mat &frame, const std::string &filename)
+{
+	pthread_mutex_lock (&mutex);
+	if (dropFrames && pushedNb - writtenNb == queueSize) {
+		droppedFrameNb++;
+		pthread_mutex_unlock (&mutex);
+		return false;
+	}
+	while (pushedNb - writtenNb == queueSize) { pthread_cond_wait (&freeCondition, &mutex); }
+	pthread_mutex_unlock (&mutex);
+
+	// The free buffer is only seen by this thread until it is pushed
+	RecordedFrame &recorded = queue[pushedNb % queueSize];
+	if (frame.channels() == 4) { cv::cvtColor (frame, recorded.frame, CV_BGRA2BGR); }
+	else { frame.copyTo (recorded.frame); }
+	recorded.filename = filename;
+	recorded.encoded = false;
+
+	pthread_mutex_lock (&mutex);
+	pushedNb++;
+	if (pushedNb - writtenNb > maxQueueDepth) { maxQueueDepth = pushedNb - writtenNb; }
+	pthread_cond_signal (&frameCondition);
+	pthread_mutex_unlock (&mutex);
+	return true;
+}
+
+
+void FrameRecorder::writeReport (std::ostream &stream, double duration)
+{
+	pthread_mutex_lock (&mutex);
+	stream << "record " << (int) (encodedFrameNb / duration) << "fps (";
+	if (encodedFrameNb > 0) { stream << round (encodeTime * 10000 / encodedFrameNb) / 10 << "ms encoding, "; }
+	stream << "queue " << pushedNb - writtenNb << ", max " << maxQueueDepth << "/" << queueSize;
+	if (dropFrames) { stream << ", " << droppedFrameNb << " dropped"; }
+	stream << ")";
+
+	encodedFrameNb = 0;
+	droppedFrameNb = 0;
+	maxQueueDepth = pushedNb - writtenNb;
+	encodeTime = 0;
+	pthread_mutex_unlock (&mutex);
+}
+
+
+void *FrameRecorder::run (void *recorder)
+{
+	reinterpret_cast<FrameRecorder*>(recorder)->run();
+	pthread_exit (NULL);
+}
+
+
+// Encoders take the frames in order. Every pushed frame is written before
+// they stop.
+void FrameRecorder::run ()
+{
+	std::vector<int> params;
+	params.push_back (CV_IMWRITE_PNG_COMPRESSION);
+	params.push_back (0);
+
+	pthread_mutex_lock (&mutex);
+	while (true)
+	{
+		while (!stopping && encodingNb == pushedNb) { pthread_cond_wait (&frameCondition, &mutex); }
+		if (encodingNb == pushedNb) { break; }
+		RecordedFrame &recorded = queue[encodingNb % queueSize];
+		encodingNb++;
+		pthread_mutex_unlock (&mutex);
+
+		double startTime = FramePacer::getTime ();
+		if (!cv::imwrite (recorded.filename, recorded.frame, params)) { std::cerr << "Error writing " << recorded.filename << std::endl; }
+		double time = FramePacer::getTime () - startTime;
+
+		pthread_mutex_lock (&mutex);
+		recorded.encoded = true;
+		encodedFrameNb++;
+		encodeTime += time;
+		bool released = false;
+		while (writtenNb < encodingNb && queue[writtenNb % queueSize].encoded) {
+			std::cout << "SCREENSHOT: " << queue[writtenNb % queueSize].filename << std::endl;
+			writtenNb++;
+			released = true;
+		}
+		if (released) { pthread_cond_signal (&freeCondition); }
+	}
+	pthread_mutex_unlock (&mutex);
+}
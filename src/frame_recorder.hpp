@@ -0,0 +1,98 @@
+/*
+ * This file is part of Moving Cells.
+ *
+ * Moving Cells is is a digital installation building on a depth sensor to
+ * allow spectators to interact with a cloud of particles through their movements.
+ * It has been developed and first displayed in June 2015 by Robin Lamarche-Perrin
+ * and Bruno Pace for the eponymous dance festival, in Leipzig.
+ * See: http://www.movingcells.org
+ * 
+ * The current version of the program is implemented on Kinect for Windows v2 (K4W2)
+ * through the open source driver libreenect2.
+ * See: https://github.com/OpenKinect/libfreenect2
+ * 
+ * Copyright © 2015-2017 Robin Lamarche-Perrin and Bruno Pace
+ * (<Robin.Lamarche-Perrin@lip6.fr>)
+ * 
+ * Moving Cells is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ * 
+ * Moving Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef FRAME_RECORDER_HPP
+#define FRAME_RECORDER_HPP
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include <pthread.h>
+
+#include <opencv2/opencv.hpp>
+
+
+#define RECORDER_QUEUE_SIZE       8         // frames waiting or being encoded
+#define RECORDER_THREAD_NUMBER    4
+
+
+// FRAME RECORDER
+//
+// Writes frames as uncompressed PNG files on a pool of encoder threads, so
+// that the simulation never waits for the encoding or the disk. Frames are
+// copied into a bounded ring of buffers: when all of them are in use, push
+// waits for the oldest frame to be written, or drops the new one in live mode.
+// Encoded frames are released in the order they were pushed, so that the log
+// and the written count always follow the frame numbering.
+
+struct RecordedFrame
+{
+	cv::Mat frame;                            // BGR
+	std::string filename;
+	bool encoded;
+};
+
+
+class FrameRecorder
+{
+public:
+	std::vector<RecordedFrame> queue;
+	int queueSize = 0;
+	bool dropFrames = false;
+
+	long pushedNb = 0;                        // frames pushed
+	long encodingNb = 0;                      // frames taken by an encoder
+	long writtenNb = 0;                       // frames written and released, in order
+
+	bool running = false;
+	bool stopping = false;
+	std::vector<pthread_t> threads;
+	pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+	pthread_cond_t frameCondition = PTHREAD_COND_INITIALIZER;   // frame pushed or stopping, for the encoders
+	pthread_cond_t freeCondition = PTHREAD_COND_INITIALIZER;    // frame released, for push
+
+	// Statistics since the last report
+	int encodedFrameNb = 0;
+	int droppedFrameNb = 0;
+	int maxQueueDepth = 0;
+	double encodeTime = 0;
+
+	void start (int threadNumber, int vQueueSize, bool vDropFrames);
+	void stop ();                             // writes every pushed frame first
+	bool push (const cv::Mat &frame, const std::string &filename);   // false when dropped
+	void writeReport (std::ostream &stream, double duration);
+
+	static void *run (void *recorder);
+	void run ();
+};
+
+
+#endif
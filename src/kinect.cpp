@@ -93,13 +93,6 @@ void Kinect::init ()
 	thresholdFrame = 0;
     objectList = new ObjectList();
 
-	struct timeval kinectStartTimer; // kinectEndTimer;
-	gettimeofday (&kinectStartTimer, NULL);
-
-	// int kinectFrameCounter = 0;
-	// double kinectDelay = 0;
-	// double kinectSumDelay = 0;
-
 	stop = false;
 
 	if (thresholdFromFile)
@@ -140,20 +133,15 @@ void Kinect::run ()
 	while (! stop)
 	{
 		// COMPUTE TIME
-		gettimeofday (&kinectEndTimer, NULL);
-		kinectDelay = (kinectEndTimer.tv_sec - kinectStartTimer.tv_sec) + (float)(kinectEndTimer.tv_usec - kinectStartTimer.tv_usec) / 1000000L;
-		kinectStartTimer = kinectEndTimer;
-
-		kinectFrameCounter++;
-		kinectSumDelay += kinectDelay;
-
-		if (kinectSumDelay >= 3)
+		// The sensor paces the loop, frames are only measured
+		kinectDelay = kinectPacer.step ();
+		if (kinectPacer.report ())
 		{
-			kinectFps = (int) (((float) kinectFrameCounter) / kinectSumDelay);
-			std::cout << "KINECT: " << kinectFps << "fps" << std::endl;
-			kinectSumDelay = 0;
-			kinectFrameCounter = 0;
-		}	
+			kinectFps = kinectPacer.fps;
+			std::cout << "KINECT: ";
+			kinectPacer.writeReport (std::cout);
+			std::cout << std::endl;
+		}
 
 		// GET NEW FRAME
 		listener->waitForNewFrame (frames);
@@ -39,6 +39,9 @@
 
 #include <list>
 
+#include "frame_pacer.hpp"
+
+
 // DEFINE ENUM
 
 #define NO_BORDER                 0
@@ -167,10 +170,8 @@ public:
 	libfreenect2::Registration *registration;
 	libfreenect2::FrameMap frames;
 
-	struct timeval kinectStartTimer, kinectEndTimer;
-	int kinectFrameCounter;
-	double kinectDelay;
-	double kinectSumDelay = 0;
+	FramePacer kinectPacer;
+	double kinectDelay = 0;
 
 	void *status;
 	pthread_attr_t attr;
@@ -70,6 +70,7 @@ int main (int argc, char *argv[])
 	cloud->particleNumber = 1024 * 768 / 3;
 	cloud->displayBodies  = false;
 	cloud->particleDamping = 0.5;
+	if (argc > 1 && std::string (argv[1]) == "--resume") { cloud->warmRestart = true; }
 	cloud->init();
 
 	pthread_t cloudThread;
@@ -0,0 +1,141 @@
+/*
+ * This file is part of Moving Cells.
+ *
+ * Moving Cells is is a digital installation building on a depth sensor to
+ * allow spectators to interact with a cloud of particles through their movements.
+ * It has been developed and first displayed in June 2015 by Robin Lamarche-Perrin
+ * and Bruno Pace for the eponymous dance festival, in Leipzig.
+ * See: http://www.movingcells.org
+ * 
+ * The current version of the program is implemented on Kinect for Windows v2 (K4W2)
+ * through the open source driver libreenect2.
+ * See: https://github.com/OpenKinect/libfreenect2
+ * 
+ * Copyright © 2015-2017 Robin Lamarche-Perrin and Bruno Pace
+ * (<Robin.Lamarche-Perrin@lip6.fr>)
+ * 
+ * Moving Cells is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ * 
+ * Moving Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// LIBRARIES
+
+#include "overlay_layer.hpp"
+
+
+// OVERLAY LAYER
+
+void OverlayLayer::clear ()
+{
+	textNumber = 0;
+	renderedTextNumber = 0;
+	marks.clear();
+}
+
+
+void OverlayLayer::addText (const std::string &str, cv::Point origin)
+{
+	if (textNumber == (int) texts.size()) { texts.push_back (OverlayText ()); }
+	OverlayText &text = texts[textNumber++];
+	if (!text.layer.empty() && text.str == str && text.origin == origin) { return; }
+
+	text.str = str;
+	text.origin = origin;
+	renderText (text);
+	renderedTextNumber++;
+}
+
+
+void OverlayLayer::addMark (cv::Point center, cv::Scalar color)
+{
+	OverlayMark mark;
+	mark.center = center;
+	mark.color = color;
+	marks.push_back (mark);
+}
+
+
+// Hershey glyphs such as brackets go past the cap height and the baseline,
+// and strokes spread over the thickness: the margin keeps them all
+void OverlayLayer::renderText (OverlayText &text)
+{
+	int baseline = 0;
+	cv::Size size = cv::getTextSize (text.str, fontFace, fontScale, textThickness, &baseline);
+	int margin = size.height / 2 + textThickness;
+	text.rect = cv::Rect (text.origin.x - margin, text.origin.y - size.height - margin, size.width + 2 * margin, size.height + baseline + 2 * margin);
+
+	text.layer.create (text.rect.height, text.rect.width, CV_8UC4);
+	text.layer.setTo (cv::Scalar::all (0));
+	cv::putText (text.layer, text.str, text.origin - text.rect.tl(), fontFace, fontScale, textColor, textThickness);
+}
+
+
+void OverlayLayer::apply (cv::Mat &frame, bool saveFrame)
+{
+	cv::Rect frameRect (0, 0, frame.cols, frame.rows);
+	savedNumber = 0;
+
+	for (int t = 0; t < textNumber; t++) {
+		cv::Rect rect = texts[t].rect & frameRect;
+		if (rect.area() == 0) { continue; }
+		if (saveFrame) { save (frame, rect); }
+		blendText (frame, texts[t], rect);
+	}
+
+	int markSize = markRadius + markThickness;
+	for (unsigned int m = 0; m < marks.size(); m++) {
+		cv::Rect rect = cv::Rect (marks[m].center.x - markSize, marks[m].center.y - markSize, 2 * markSize + 1, 2 * markSize + 1) & frameRect;
+		if (rect.area() == 0) { continue; }
+		if (saveFrame) { save (frame, rect); }
+		cv::circle (frame, marks[m].center, markRadius, marks[m].color, markThickness);
+	}
+}
+
+
+// Overlapping rectangles are put back in reverse order
+void OverlayLayer::restore (cv::Mat &frame)
+{
+	for (int s = savedNumber - 1; s >= 0; s--) { savedPixels[s].copyTo (frame (savedRects[s])); }
+	savedNumber = 0;
+}
+
+
+// Opaque pixels of the text (all of them without anti-aliasing) are copied as
+// they are. The alpha channel of a BGRA frame is left untouched.
+void OverlayLayer::blendText (cv::Mat &frame, const OverlayText &text, cv::Rect rect)
+{
+	int channels = frame.channels();
+	for (int y = 0; y < rect.height; y++) {
+		unsigned char *out = frame.ptr<uchar>(rect.y + y) + rect.x * channels;
+		const unsigned char *in = text.layer.ptr<uchar>(rect.y - text.rect.y + y) + (rect.x - text.rect.x) * 4;
+		for (int x = 0; x < rect.width; x++, out += channels, in += 4) {
+			int alpha = in[3];
+			if (alpha == 0) { continue; }
+			for (int c = 0; c < 3; c++) { out[c] = (in[c] * alpha + out[c] * (255 - alpha) + 127) / 255; }
+		}
+	}
+}
+
+
+void OverlayLayer::save (cv::Mat &frame, cv::Rect rect)
+{
+	if (savedNumber == (int) savedPixels.size()) {
+		savedPixels.push_back (cv::Mat ());
+		savedRects.push_back (rect);
+	}
+	savedRects[savedNumber] = rect;
+	savedPixels[savedNumber].create (rect.height, rect.width, frame.type());
+	frame (rect).copyTo (savedPixels[savedNumber]);
+	savedNumber++;
+}
@@ -0,0 +1,102 @@
+/*
+ * This file is part of Moving Cells.
+ *
+ * Moving Cells is is a digital installation building on a depth sensor to
+ * allow spectators to interact with a cloud of particles through their movements.
+ * It has been developed and first displayed in June 2015 by Robin Lamarche-Perrin
+ * and Bruno Pace for the eponymous dance festival, in Leipzig.
+ * See: http://www.movingcells.org
+ * 
+ * The current version of the program is implemented on Kinect for Windows v2 (K4W2)
+ * through the open source driver libreenect2.
+ * See: https://github.com/OpenKinect/libfreenect2
+ * 
+ * Copyright © 2015-2017 Robin Lamarche-Perrin and Bruno Pace
+ * (<Robin.Lamarche-Perrin@lip6.fr>)
+ * 
+ * Moving Cells is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ * 
+ * Moving Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef OVERLAY_LAYER_HPP
+#define OVERLAY_LAYER_HPP
+
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+
+// OVERLAY LAYER
+//
+// Texts and marks composited over the frame itself, instead of over a copy of
+// it. Each text is rendered once into a small BGRA image, kept as long as the
+// text and its position do not change, then alpha-blended into its rectangle
+// of the frame. Texts are identified by their rank since clear(): the image of
+// the n-th text is reused when the n-th text of the previous frame was the
+// same.
+//
+// When the frame is kept from one frame to the next, apply() saves the pixels
+// under the overlays and restore() puts them back once the frame is shown.
+
+struct OverlayText
+{
+	std::string str;
+	cv::Point origin;
+	cv::Rect rect;        // covered by the text in the frame
+	cv::Mat layer;        // BGRA image of rect
+};
+
+
+struct OverlayMark
+{
+	cv::Point center;
+	cv::Scalar color;
+};
+
+
+class OverlayLayer
+{
+public:
+	int fontFace = cv::FONT_HERSHEY_PLAIN;
+	double fontScale = 1;
+	int textThickness = 2;
+	cv::Scalar textColor = cv::Scalar (255, 255, 255, 255);
+	int markRadius = 1;
+	int markThickness = 3;
+
+	std::vector<OverlayText> texts;
+	int textNumber = 0;
+	int renderedTextNumber = 0;           // texts rendered again since the last clear()
+	std::vector<OverlayMark> marks;
+
+	std::vector<cv::Rect> savedRects;
+	std::vector<cv::Mat> savedPixels;
+	int savedNumber = 0;
+
+	void clear ();
+	void addText (const std::string &str, cv::Point origin);
+	void addMark (cv::Point center, cv::Scalar color);
+	bool empty () const { return textNumber == 0 && marks.empty(); }
+
+	void apply (cv::Mat &frame, bool saveFrame);
+	void restore (cv::Mat &frame);
+
+	void renderText (OverlayText &text);
+	void blendText (cv::Mat &frame, const OverlayText &text, cv::Rect rect);
+	void save (cv::Mat &frame, cv::Rect rect);
+};
+
+
+#endif
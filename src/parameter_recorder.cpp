@@ -0,0 +1,143 @@
+/*
+ * This file is part of Moving Cells.
+ *
+ * Moving Cells is is a digital installation building on a depth sensor to
+ * allow spectators to interact with a cloud of particles through their movements.
+ * It has been developed and first displayed in June 2015 by Robin Lamarche-Perrin
+ * and Bruno Pace for the eponymous dance festival, in Leipzig.
+ * See: http://www.movingcells.org
+ * 
+ * The current version of the program is implemented on Kinect for Windows v2 (K4W2)
+ * through the open source driver libreenect2.
+ * See: https://github.com/OpenKinect/libfreenect2
+ * 
+ * Copyright © 2015-2017 Robin Lamarche-Perrin and Bruno Pace
+ * (<Robin.Lamarche-Perrin@lip6.fr>)
+ * 
+ * Moving Cells is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ * 
+ * Moving Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+
+#include "parameter_recorder.hpp"
+
+
+bool ParameterRecorder::open (const std::string &vFilename, const std::vector<std::string> &vNames)
+{
+	close();
+
+	file.open (vFilename, std::ios::out | std::ios::trunc);
+	if (! file) { file.close(); return false; }
+
+	filename = vFilename;
+	names = vNames;
+	changes.assign (names.size(), ParameterRecord());
+	changed.assign (names.size(), false);
+	frameChanges.reserve (names.size());
+	changeNb = 0;
+	records.resize (PARAMETER_RING_SIZE);
+	committedNb = 0;
+	writtenNb = 0;
+	coalescedNb = 0;
+
+	stopping = false;
+	int rc = pthread_create (&thread, NULL, &ParameterRecorder::run, (void *) this);
+	if (rc) { std::cout << "Error: Unable to create thread " << rc << std::endl; exit (-1); }
+	running = true;
+	return true;
+}
+
+
+void ParameterRecorder::close ()
+{
+	if (!running) { return; }
+	commit();
+
+	pthread_mutex_lock (&mutex);
+	stopping = true;
+	pthread_cond_signal (&committed);
+	pthread_mutex_unlock (&mutex);
+	pthread_join (thread, NULL);
+	running = false;
+	file.close();
+}
+
+
+void ParameterRecorder::set (int parameter, double timestamp, float value)
+{
+	if (!running || parameter < 0 || parameter >= (int) changes.size()) { return; }
+	if (changed[parameter]) { coalescedNb++; } else { changed[parameter] = true; changeNb++; }
+	changes[parameter].timestamp = timestamp;
+	changes[parameter].parameter = parameter;
+	changes[parameter].value = value;
+}
+
+
+// The changes are pushed in the order of their timestamps, so that the file
+// stays sorted. A full ring is waited for rather than losing a change.
+void ParameterRecorder::commit ()
+{
+	if (changeNb == 0) { return; }
+
+	frameChanges.clear();
+	for (unsigned int p = 0; p < changes.size(); p++) {
+		if (!changed[p]) continue;
+		frameChanges.push_back (changes[p]);
+		changed[p] = false;
+	}
+	changeNb = 0;
+	std::stable_sort (frameChanges.begin(), frameChanges.end(), [] (const ParameterRecord &a, const ParameterRecord &b) { return a.timestamp < b.timestamp; });
+
+	pthread_mutex_lock (&mutex);
+	for (unsigned int i = 0; i < frameChanges.size(); i++) {
+		while (committedNb - writtenNb == (long) records.size()) { pthread_cond_wait (&written, &mutex); }
+		records[committedNb % records.size()] = frameChanges[i];
+		committedNb++;
+	}
+	pthread_cond_signal (&committed);
+	pthread_mutex_unlock (&mutex);
+}
+
+
+void *ParameterRecorder::run (void *recorder)
+{
+	reinterpret_cast<ParameterRecorder*>(recorder)->run();
+	pthread_exit (NULL);
+}
+
+
+void ParameterRecorder::run ()
+{
+	std::vector<ParameterRecord> batch;
+
+	pthread_mutex_lock (&mutex);
+	while (true)
+	{
+		while (!stopping && committedNb == writtenNb) { pthread_cond_wait (&committed, &mutex); }
+		if (committedNb == writtenNb) { break; }
+		batch.clear();
+		for (; writtenNb < committedNb; writtenNb++) { batch.push_back (records[writtenNb % records.size()]); }
+		pthread_cond_signal (&written);
+		pthread_mutex_unlock (&mutex);
+
+		for (unsigned int i = 0; i < batch.size(); i++) { file << batch[i].timestamp << " " << names[batch[i].parameter] << " " << batch[i].value << "\n"; }
+		file.flush();
+
+		pthread_mutex_lock (&mutex);
+	}
+	pthread_mutex_unlock (&mutex);
+}
@@ -0,0 +1,97 @@
+/*
+ * This file is part of Moving Cells.
+ *
+ * Moving Cells is is a digital installation building on a depth sensor to
+ * allow spectators to interact with a cloud of particles through their movements.
+ * It has been developed and first displayed in June 2015 by Robin Lamarche-Perrin
+ * and Bruno Pace for the eponymous dance festival, in Leipzig.
+ * See: http://www.movingcells.org
+ * 
+ * The current version of the program is implemented on Kinect for Windows v2 (K4W2)
+ * through the open source driver libreenect2.
+ * See: https://github.com/OpenKinect/libfreenect2
+ * 
+ * Copyright © 2015-2017 Robin Lamarche-Perrin and Bruno Pace
+ * (<Robin.Lamarche-Perrin@lip6.fr>)
+ * 
+ * Moving Cells is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ * 
+ * Moving Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef PARAMETER_RECORDER_HPP
+#define PARAMETER_RECORDER_HPP
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <pthread.h>
+
+
+#define PARAMETER_RING_SIZE       4096      // changes waiting for the writer
+
+
+// PARAMETER RECORDER
+//
+// Records parameter sequences (lines of "timestamp name value") without
+// writing on the caller's thread. The changes of a frame are coalesced,
+// only the last value of each parameter being kept, then committed to a
+// ring that a background thread writes to the file.
+
+struct ParameterRecord
+{
+	double timestamp;
+	int parameter;
+	float value;
+};
+
+
+class ParameterRecorder
+{
+public:
+	std::string filename;
+	std::vector<std::string> names;          // of the parameters, by id
+
+	// Changes of the current frame, only touched by the caller
+	std::vector<ParameterRecord> changes;    // by parameter
+	std::vector<bool> changed;
+	int changeNb = 0;
+	std::vector<ParameterRecord> frameChanges;   // sorted by commit
+
+	std::vector<ParameterRecord> records;
+	long committedNb = 0;                    // records pushed in the ring since open
+	long writtenNb = 0;                      // records taken by the writer since open
+	int coalescedNb = 0;                     // changes replaced by a later one of the same frame
+
+	bool running = false;
+	bool stopping = false;
+	std::ofstream file;
+	pthread_t thread;
+	pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+	pthread_cond_t committed = PTHREAD_COND_INITIALIZER;
+	pthread_cond_t written = PTHREAD_COND_INITIALIZER;
+
+	~ParameterRecorder () { close(); }
+
+	bool open (const std::string &filename, const std::vector<std::string> &names);   // false if the file cannot be written
+	void close ();                            // commits and writes everything first
+	bool isOpen () const { return running; }
+	void set (int parameter, double timestamp, float value);
+	void commit ();                           // once per frame
+
+	static void *run (void *recorder);
+	void run ();
+};
+
+
+#endif
@@ -0,0 +1,118 @@
+/*
+ * This file is part of Moving Cells.
+ *
+ * Moving Cells is is a digital installation building on a depth sensor to
+ * allow spectators to interact with a cloud of particles through their movements.
+ * It has been developed and first displayed in June 2015 by Robin Lamarche-Perrin
+ * and Bruno Pace for the eponymous dance festival, in Leipzig.
+ * See: http://www.movingcells.org
+ * 
+ * The current version of the program is implemented on Kinect for Windows v2 (K4W2)
+ * through the open source driver libreenect2.
+ * See: https://github.com/OpenKinect/libfreenect2
+ * 
+ * Copyright © 2015-2017 Robin Lamarche-Perrin and Bruno Pace
+ * (<Robin.Lamarche-Perrin@lip6.fr>)
+ * 
+ * Moving Cells is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ * 
+ * Moving Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <fstream>
+#include <algorithm>
+#include <numeric>
+#include <cstdlib>
+#include <cctype>
+
+#include "parameter_timeline.hpp"
+
+
+bool ParameterTimeline::compile (const std::string &vFilename)
+{
+	std::ifstream file (vFilename, std::ios::in);
+	if (! file.is_open()) { return false; }
+
+	filename = vFilename;
+	tracks.clear();
+	sampleNumber = 0;
+	duration = 0;
+
+	std::string line;
+	for (int lineNb = 0; std::getline (file, line); lineNb++) {
+		const char *begin = line.c_str();
+		char *end;
+		double timestamp = strtod (begin, &end);
+		if (end == begin) continue;
+
+		const char *name = end;
+		while (isspace (*name)) { name++; }
+		const char *nameEnd = name;
+		while (*nameEnd && ! isspace (*nameEnd)) { nameEnd++; }
+		if (nameEnd == name) continue;
+
+		float value = strtof (nameEnd, &end);
+		if (end == nameEnd) continue;
+
+		TimelineTrack &track = tracks[intern (std::string (name, nameEnd))];
+		track.timestamps.push_back (timestamp);
+		track.values.push_back (value);
+		track.lines.push_back (lineNb);
+		sampleNumber++;
+		duration = std::max (duration, timestamp);
+	}
+
+	// Recorded sequences are already sorted: this only fixes edited ones
+	for (unsigned int t = 0; t < tracks.size(); t++) {
+		TimelineTrack &track = tracks[t];
+		if (std::is_sorted (track.timestamps.begin(), track.timestamps.end())) continue;
+
+		std::vector<int> order (track.timestamps.size());
+		std::iota (order.begin(), order.end(), 0);
+		std::stable_sort (order.begin(), order.end(), [&track] (int a, int b) { return track.timestamps[a] < track.timestamps[b]; });
+		TimelineTrack sorted;
+		for (unsigned int i = 0; i < order.size(); i++) {
+			sorted.timestamps.push_back (track.timestamps[order[i]]);
+			sorted.values.push_back (track.values[order[i]]);
+			sorted.lines.push_back (track.lines[order[i]]);
+		}
+		track.timestamps.swap (sorted.timestamps);
+		track.values.swap (sorted.values);
+		track.lines.swap (sorted.lines);
+	}
+	return true;
+}
+
+
+int ParameterTimeline::intern (const std::string &name)
+{
+	int track = getTrack (name);
+	if (track >= 0) { return track; }
+	tracks.push_back (TimelineTrack());
+	tracks.back().name = name;
+	return tracks.size() - 1;
+}
+
+
+int ParameterTimeline::getTrack (const std::string &name) const
+{
+	for (unsigned int t = 0; t < tracks.size(); t++) { if (tracks[t].name == name) return t; }
+	return -1;
+}
+
+
+int ParameterTimeline::seek (int track, double time) const
+{
+	const std::vector<double> &timestamps = tracks[track].timestamps;
+	return std::lower_bound (timestamps.begin(), timestamps.end(), time) - timestamps.begin();
+}
@@ -0,0 +1,71 @@
+/*
+ * This file is part of Moving Cells.
+ *
+ * Moving Cells is is a digital installation building on a depth sensor to
+ * allow spectators to interact with a cloud of particles through their movements.
+ * It has been developed and first displayed in June 2015 by Robin Lamarche-Perrin
+ * and Bruno Pace for the eponymous dance festival, in Leipzig.
+ * See: http://www.movingcells.org
+ * 
+ * The current version of the program is implemented on Kinect for Windows v2 (K4W2)
+ * through the open source driver libreenect2.
+ * See: https://github.com/OpenKinect/libfreenect2
+ * 
+ * Copyright © 2015-2017 Robin Lamarche-Perrin and Bruno Pace
+ * (<Robin.Lamarche-Perrin@lip6.fr>)
+ * 
+ * Moving Cells is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ * 
+ * Moving Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef PARAMETER_TIMELINE_HPP
+#define PARAMETER_TIMELINE_HPP
+
+#include <string>
+#include <vector>
+
+
+// PARAMETER TIMELINE
+//
+// A parameter sequence (lines of "timestamp name value") compiled once into
+// one track per name, each holding its timestamps and values in two arrays.
+// Names are interned when the file is compiled, so that playing the sequence
+// compares no string, and seeking to any time is a binary search per track.
+
+struct TimelineTrack
+{
+	std::string name;
+	int id = -1;                              // what the name stands for, set by the player
+	std::vector<double> timestamps;           // sorted
+	std::vector<float> values;
+	std::vector<int> lines;                   // line of each sample, to play the tracks in the order of the file
+};
+
+
+class ParameterTimeline
+{
+public:
+	std::string filename;
+	std::vector<TimelineTrack> tracks;
+	int sampleNumber = 0;
+	double duration = 0;
+
+	bool compile (const std::string &filename);   // false if the file cannot be read
+	int intern (const std::string &name);
+	int getTrack (const std::string &name) const;  // -1 if the sequence never uses this name
+	int seek (int track, double time) const;       // first sample at or after time
+};
+
+
+#endif
@@ -0,0 +1,118 @@
+/*
+ * This file is part of Moving Cells.
+ *
+ * Moving Cells is is a digital installation building on a depth sensor to
+ * allow spectators to interact with a cloud of particles through their movements.
+ * It has been developed and first displayed in June 2015 by Robin Lamarche-Perrin
+ * and Bruno Pace for the eponymous dance festival, in Leipzig.
+ * See: http://www.movingcells.org
+ * 
+ * The current version of the program is implemented on Kinect for Windows v2 (K4W2)
+ * through the open source driver libreenect2.
+ * See: https://github.com/OpenKinect/libfreenect2
+ * 
+ * Copyright © 2015-2017 Robin Lamarche-Perrin and Bruno Pace
+ * (<Robin.Lamarche-Perrin@lip6.fr>)
+ * 
+ * Moving Cells is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ * 
+ * Moving Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef PARTICLE_ARRAY_HPP
+#define PARTICLE_ARRAY_HPP
+
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+
+#define PARTICLE_ALIGNMENT    64
+
+
+// PARTICLE ARRAY
+//
+// Structure-of-arrays storage of the particle states: positions and speeds
+// live in four separate arrays aligned on cache lines, so that the
+// integrator can load several consecutive particles in one vector.
+
+struct ParticleArray
+{
+public:
+	int number;
+	float *x, *y, *dx, *dy;
+
+	ParticleArray () : number (0), x (NULL), y (NULL), dx (NULL), dy (NULL) {}
+	~ParticleArray () { release(); }
+
+	void allocate (int vNumber)
+	{
+		release();
+		number = vNumber;
+		x = allocateArray (number);
+		y = allocateArray (number);
+		dx = allocateArray (number);
+		dy = allocateArray (number);
+	}
+
+	// Grows the arrays, keeping the current particles (new ones are zero)
+	void resize (int vNumber)
+	{
+		if (vNumber <= number) { return; }
+		float *newX = allocateArray (vNumber);
+		float *newY = allocateArray (vNumber);
+		float *newDx = allocateArray (vNumber);
+		float *newDy = allocateArray (vNumber);
+		if (number > 0) {
+			memcpy (newX, x, number * sizeof (float));
+			memcpy (newY, y, number * sizeof (float));
+			memcpy (newDx, dx, number * sizeof (float));
+			memcpy (newDy, dy, number * sizeof (float));
+		}
+		release();
+		number = vNumber;
+		x = newX; y = newY; dx = newDx; dy = newDy;
+	}
+
+	// Exchanges the arrays in O(1), e.g. with a buffer loaded in the background
+	void swap (ParticleArray &other)
+	{
+		std::swap (number, other.number);
+		std::swap (x, other.x); std::swap (y, other.y);
+		std::swap (dx, other.dx); std::swap (dy, other.dy);
+	}
+
+	void release ()
+	{
+		free (x); free (y); free (dx); free (dy);
+		x = NULL; y = NULL; dx = NULL; dy = NULL;
+		number = 0;
+	}
+
+	static float *allocateArray (int number)
+	{
+		void *array = NULL;
+		size_t size = ((size_t) number * sizeof (float) + PARTICLE_ALIGNMENT - 1) / PARTICLE_ALIGNMENT * PARTICLE_ALIGNMENT;
+		if (size == 0) { size = PARTICLE_ALIGNMENT; }
+		if (posix_memalign (&array, PARTICLE_ALIGNMENT, size) != 0) { return NULL; }
+		memset (array, 0, size);
+		return (float *) array;
+	}
+
+private:
+	ParticleArray (const ParticleArray &);
+	ParticleArray &operator= (const ParticleArray &);
+};
+
+
+#endif
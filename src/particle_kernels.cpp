@@ -0,0 +1,130 @@
+/*
+ * This file is part of Moving Cells.
+ *
+ * Moving Cells is is a digital installation building on a depth sensor to
+ * allow spectators to interact with a cloud of particles through their movements.
+ * It has been developed and first displayed in June 2015 by Robin Lamarche-Perrin
+ * and Bruno Pace for the eponymous dance festival, in Leipzig.
+ * See: http://www.movingcells.org
+ * 
+ * The current version of the program is implemented on Kinect for Windows v2 (K4W2)
+ * through the open source driver libreenect2.
+ * See: https://github.com/OpenKinect/libfreenect2
+ * 
+ * Copyright © 2015-2017 Robin Lamarche-Perrin and Bruno Pace
+ * (<Robin.Lamarche-Perrin@lip6.fr>)
+ * 
+ * Moving Cells is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ * 
+ * Moving Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+// LIBRARIES
+
+#include <cmath>
+
+#include "particle_kernels_simd.hpp"
+
+
+// FUNCTIONS
+
+ParticleKernel selectParticleKernelScalar (int forceLaw, int bodyNumber) { return ParticleIntegrator<ScalarVec>::select (forceLaw, bodyNumber); }
+
+
+// Reference integration, with pow, atan2, cos and sin for each particle-body pair
+void integrateParticlesExact (const ParticleKernelArgs &args)
+{
+	for (int i = args.first; i < args.last; i++) {
+
+		float x = args.x[i];
+		float y = args.y[i];
+		float dx = args.dx[i];
+		float dy = args.dy[i];
+		
+		// Compute motion
+		float ddx = - args.damping * dx;
+		float ddy = - args.damping * dy;
+
+		for (int j = 0; j < args.bodyNumber; j++) {
+			float distanceX = x - args.bodyX[j];
+			float distanceY = y - args.bodyY[j];
+	
+			float factor = pow (pow (distanceX, 2) + pow (distanceY, 2), args.gravitationFactor);
+			if (factor == 0) continue;
+			
+			float angle = atan2 (distanceY, distanceX);
+			ddx -= args.bodyWeight[j] * cos (angle + args.gravitationAngle) / factor;
+			ddy -= args.bodyWeight[j] * sin (angle + args.gravitationAngle) / factor;
+		}
+
+		// Apply motion
+		dx += ddx * args.delay;
+		dy += ddy * args.delay;
+
+		if (dx > args.maxSpeed) { dx = args.maxSpeed; }
+		if (dx < -args.maxSpeed) { dx = -args.maxSpeed; }
+		if (dy > args.maxSpeed) { dy = args.maxSpeed; }
+		if (dy < -args.maxSpeed) { dy = -args.maxSpeed; }
+		
+		args.x[i] = x + (dx - ddx * args.delay / 2) * args.delay;
+		args.y[i] = y + (dy - ddy * args.delay / 2) * args.delay;
+		args.dx[i] = dx;
+		args.dy[i] = dy;
+	}
+}
+
+
+// Factors reached by adding keyboard steps (0.01, 0.1) carry rounding errors,
+// hence the tolerance; it changes forces by less than 1e-4 on the screen.
+int getForceLaw (float gravitationFactor)
+{
+	if (fabs (gravitationFactor) < FORCE_LAW_TOLERANCE) { return CONSTANT_FORCE; }
+	if (fabs (gravitationFactor - 1) < FORCE_LAW_TOLERANCE) { return INVERSE_LINEAR_FORCE; }
+	if (fabs (gravitationFactor - 2) < FORCE_LAW_TOLERANCE) { return INVERSE_SQUARE_FORCE; }
+	return GENERIC_FORCE;
+}
+
+
+int getBestParticleKernel ()
+{
+#if defined (__x86_64__) || defined (__i386__)
+	__builtin_cpu_init ();
+	if (__builtin_cpu_supports ("avx512f")) { return AVX512_KERNEL; }
+	if (__builtin_cpu_supports ("avx2") && __builtin_cpu_supports ("fma")) { return AVX2_KERNEL; }
+	if (__builtin_cpu_supports ("sse4.1")) { return SSE4_KERNEL; }
+#endif
+	return SCALAR_KERNEL;
+}
+
+
+ParticleKernel getParticleKernel (int kernel, int forceLaw, int bodyNumber)
+{
+	switch (kernel) {
+	case SSE4_KERNEL   : return selectParticleKernelSSE4 (forceLaw, bodyNumber);
+	case AVX2_KERNEL   : return selectParticleKernelAVX2 (forceLaw, bodyNumber);
+	case AVX512_KERNEL : return selectParticleKernelAVX512 (forceLaw, bodyNumber);
+	default            : return selectParticleKernelScalar (forceLaw, bodyNumber);
+	}
+}
+
+
+const char *getParticleKernelName (int kernel)
+{
+	switch (kernel) {
+	case SSE4_KERNEL   : return "SSE4.1";
+	case AVX2_KERNEL   : return "AVX2";
+	case AVX512_KERNEL : return "AVX-512";
+	default            : return "scalar";
+	}
+}
@@ -0,0 +1,137 @@
+/*
+ * This file is part of Moving Cells.
+ *
+ * Moving Cells is is a digital installation building on a depth sensor to
+ * allow spectators to interact with a cloud of particles through their movements.
+ * It has been developed and first displayed in June 2015 by Robin Lamarche-Perrin
+ * and Bruno Pace for the eponymous dance festival, in Leipzig.
+ * See: http://www.movingcells.org
+ * 
+ * The current version of the program is implemented on Kinect for Windows v2 (K4W2)
+ * through the open source driver libreenect2.
+ * See: https://github.com/OpenKinect/libfreenect2
+ * 
+ * Copyright © 2015-2017 Robin Lamarche-Perrin and Bruno Pace
+ * (<Robin.Lamarche-Perrin@lip6.fr>)
+ * 
+ * Moving Cells is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ * 
+ * Moving Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef PARTICLE_KERNELS_HPP
+#define PARTICLE_KERNELS_HPP
+
+
+// KERNEL IDENTIFIERS
+
+#define SCALAR_KERNEL             0
+#define SSE4_KERNEL               1
+#define AVX2_KERNEL               2
+#define AVX512_KERNEL             3
+
+
+// FORCE LAWS (gravitation factors with a specialized power evaluation)
+
+#define GENERIC_FORCE             0
+#define CONSTANT_FORCE            1
+#define INVERSE_LINEAR_FORCE      2
+#define INVERSE_SQUARE_FORCE      3
+
+
+// BODY NUMBERS (0, 1, 2 and 4 bodies have an unrolled kernel, others use the generic one)
+
+#define ANY_BODY_NUMBER          -1
+
+
+// TOLERANCES
+
+#define FORCE_LAW_TOLERANCE       1e-5
+#define FAST_PHYSICS_TOLERANCE    1e-4
+
+
+// KERNEL ARGUMENTS
+//
+// The kernels integrate the particles in [first, last) under the attraction
+// of the active bodies (the ones with a non-zero weight). They only update
+// positions and speeds; borders and pixels are handled by the caller.
+//
+// Instead of atan2, cos and sin, the force of a body is obtained by rotating
+// the distance vector by the gravitation angle:
+//   (cos (angle + a), sin (angle + a)) / r^g
+//     = (dx cos a - dy sin a, dx sin a + dy cos a) * (r^2)^(-g/2 - 1/2)
+// where the power is evaluated with polynomial approximations of exp and log,
+// or with a square root and a division for the gravitation factors 0, 1 and 2
+// (see getForceLaw). The cosine and sine of the angle are computed once per
+// frame by the caller.
+//
+// Accuracy: against the exact kernel (pow, atan2, cos and sin), body forces
+// agree within a relative error of FAST_PHYSICS_TOLERANCE for gravitation
+// factors in [-2, 4] (measured: 2e-7 on average, 4e-5 at worst where the
+// forces of several bodies cancel out). Positions then differ by a few float
+// ulps per step, more close to a body when the factor is high, where the
+// dynamics is chaotic anyway. Particles lying exactly on a body keep the exact
+// path behaviour. This is checked by running static-cells --check-physics.
+//
+// getParticleKernel returns a kernel instantiated for the given instruction
+// set, force law and number of bodies, so that the caller only has to select
+// it again when these change.
+
+struct ParticleKernelArgs
+{
+	float *x;
+	float *y;
+	float *dx;
+	float *dy;
+	int first;
+	int last;
+
+	int bodyNumber;
+	const float *bodyX;
+	const float *bodyY;
+	const float *bodyWeight;
+
+	float damping;
+	float delay;
+	float maxSpeed;
+
+	int forceLaw;
+	float exponent;       // - gravitationFactor / 2 - 1/2
+	float cosAngle;
+	float sinAngle;
+	float zeroX;          // force direction on a particle lying on a body
+	float zeroY;
+
+	float gravitationFactor;  // gravitationFactor / 2, only used by the exact kernel
+	float gravitationAngle;   // in radians, only used by the exact kernel
+};
+
+typedef void (*ParticleKernel) (const ParticleKernelArgs &args);
+
+
+// FUNCTIONS
+
+int getBestParticleKernel ();
+ParticleKernel getParticleKernel (int kernel, int forceLaw, int bodyNumber);
+const char *getParticleKernelName (int kernel);
+int getForceLaw (float gravitationFactor);
+
+void integrateParticlesExact (const ParticleKernelArgs &args);
+
+ParticleKernel selectParticleKernelScalar (int forceLaw, int bodyNumber);
+ParticleKernel selectParticleKernelSSE4 (int forceLaw, int bodyNumber);
+ParticleKernel selectParticleKernelAVX2 (int forceLaw, int bodyNumber);
+ParticleKernel selectParticleKernelAVX512 (int forceLaw, int bodyNumber);
+
+
+#endif
@@ -0,0 +1,90 @@
+/*
+ * This file is part of Moving Cells.
+ *
+ * Moving Cells is is a digital installation building on a depth sensor to
+ * allow spectators to interact with a cloud of particles through their movements.
+ * It has been developed and first displayed in June 2015 by Robin Lamarche-Perrin
+ * and Bruno Pace for the eponymous dance festival, in Leipzig.
+ * See: http://www.movingcells.org
+ * 
+ * The current version of the program is implemented on Kinect for Windows v2 (K4W2)
+ * through the open source driver libreenect2.
+ * See: https://github.com/OpenKinect/libfreenect2
+ * 
+ * Copyright © 2015-2017 Robin Lamarche-Perrin and Bruno Pace
+ * (<Robin.Lamarche-Perrin@lip6.fr>)
+ * 
+ * Moving Cells is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ * 
+ * Moving Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+// AVX-512 PARTICLE KERNEL (16 particles per iteration)
+// Compiled with -mavx512f, only called when the processor supports it.
+
+#include <immintrin.h>
+
+#include "particle_kernels_simd.hpp"
+
+
+namespace {
+
+struct Avx512Vec
+{
+	typedef __m512 Float;
+	typedef __mmask16 Mask;
+	static const int width = 16;
+
+	static Float set (float v) { return _mm512_set1_ps (v); }
+	static Float load (const float *p) { return _mm512_loadu_ps (p); }
+	static void store (float *p, Float v) { _mm512_storeu_ps (p, v); }
+
+	static Float add (Float a, Float b) { return _mm512_add_ps (a, b); }
+	static Float sub (Float a, Float b) { return _mm512_sub_ps (a, b); }
+	static Float mul (Float a, Float b) { return _mm512_mul_ps (a, b); }
+	static Float madd (Float a, Float b, Float c) { return _mm512_fmadd_ps (a, b, c); }
+	static Float div (Float a, Float b) { return _mm512_div_ps (a, b); }
+	static Float sqrt (Float a) { return _mm512_sqrt_ps (a); }
+	static Float min (Float a, Float b) { return _mm512_min_ps (a, b); }
+	static Float max (Float a, Float b) { return _mm512_max_ps (a, b); }
+	static Float floor (Float a) { return _mm512_roundscale_ps (a, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC); }
+
+	static Mask lt (Float a, Float b) { return _mm512_cmp_ps_mask (a, b, _CMP_LT_OQ); }
+	static Mask gt (Float a, Float b) { return _mm512_cmp_ps_mask (a, b, _CMP_GT_OQ); }
+	static Mask eq (Float a, Float b) { return _mm512_cmp_ps_mask (a, b, _CMP_EQ_OQ); }
+	static Float select (Mask m, Float a, Float b) { return _mm512_mask_blend_ps (m, b, a); }
+
+	static Float exponent (Float a)
+	{
+		__m512i e = _mm512_and_si512 (_mm512_srli_epi32 (_mm512_castps_si512 (a), 23), _mm512_set1_epi32 (0xff));
+		return _mm512_cvtepi32_ps (_mm512_sub_epi32 (e, _mm512_set1_epi32 (126)));
+	}
+
+	static Float mantissa (Float a)
+	{
+		__m512i m = _mm512_and_si512 (_mm512_castps_si512 (a), _mm512_set1_epi32 (0x807fffff));
+		return _mm512_castsi512_ps (_mm512_or_si512 (m, _mm512_set1_epi32 (0x3f000000)));
+	}
+
+	static Float ldexp (Float a, Float n)
+	{
+		__m512i e = _mm512_slli_epi32 (_mm512_cvttps_epi32 (n), 23);
+		return _mm512_castsi512_ps (_mm512_add_epi32 (_mm512_castps_si512 (a), e));
+	}
+};
+
+}
+
+
+ParticleKernel selectParticleKernelAVX512 (int forceLaw, int bodyNumber) { return ParticleIntegrator<Avx512Vec>::select (forceLaw, bodyNumber); }
@@ -0,0 +1,255 @@
+/*
+ * This file is part of Moving Cells.
+ *
+ * Moving Cells is is a digital installation building on a depth sensor to
+ * allow spectators to interact with a cloud of particles through their movements.
+ * It has been developed and first displayed in June 2015 by Robin Lamarche-Perrin
+ * and Bruno Pace for the eponymous dance festival, in Leipzig.
+ * See: http://www.movingcells.org
+ * 
+ * The current version of the program is implemented on Kinect for Windows v2 (K4W2)
+ * through the open source driver libreenect2.
+ * See: https://github.com/OpenKinect/libfreenect2
+ * 
+ * Copyright © 2015-2017 Robin Lamarche-Perrin and Bruno Pace
+ * (<Robin.Lamarche-Perrin@lip6.fr>)
+ * 
+ * Moving Cells is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ * 
+ * Moving Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// PARTICLE KERNEL TEMPLATE
+//
+// Included by each particle_kernels_*.cpp file, which compiles it for one
+// instruction set. V wraps the vector type of that instruction set: it
+// provides the arithmetic, comparison and bit manipulation operations used
+// below. Everything lives in an anonymous namespace so that no code compiled
+// for a wider instruction set can leak into the rest of the program.
+
+#ifndef PARTICLE_KERNELS_SIMD_HPP
+#define PARTICLE_KERNELS_SIMD_HPP
+
+#include <stdint.h>
+#include <string.h>
+
+#include "particle_kernels.hpp"
+
+
+namespace {
+
+struct ScalarVec
+{
+	typedef float Float;
+	typedef bool Mask;
+	static const int width = 1;
+
+	static Float set (float v) { return v; }
+	static Float load (const float *p) { return *p; }
+	static void store (float *p, Float v) { *p = v; }
+
+	static Float add (Float a, Float b) { return a + b; }
+	static Float sub (Float a, Float b) { return a - b; }
+	static Float mul (Float a, Float b) { return a * b; }
+	static Float madd (Float a, Float b, Float c) { return a * b + c; }
+	static Float div (Float a, Float b) { return a / b; }
+	static Float sqrt (Float a) { return __builtin_sqrtf (a); }
+	static Float min (Float a, Float b) { return a < b ? a : b; }
+	static Float max (Float a, Float b) { return a > b ? a : b; }
+	static Float floor (Float a) { return __builtin_floorf (a); }
+
+	static Mask lt (Float a, Float b) { return a < b; }
+	static Mask gt (Float a, Float b) { return a > b; }
+	static Mask eq (Float a, Float b) { return a == b; }
+	static Float select (Mask m, Float a, Float b) { return m ? a : b; }
+
+	static int32_t bits (Float a) { int32_t i; memcpy (&i, &a, 4); return i; }
+	static Float fromBits (int32_t i) { Float a; memcpy (&a, &i, 4); return a; }
+
+	// x = mantissa (x) * 2^exponent (x) with mantissa (x) in [0.5, 1)
+	static Float exponent (Float a) { return (float) (((bits (a) >> 23) & 0xff) - 126); }
+	static Float mantissa (Float a) { return fromBits ((bits (a) & 0x807fffff) | 0x3f000000); }
+	// Wraps like the vector slli and add: shifting a negative int32_t is undefined
+	static Float ldexp (Float a, Float n) { return fromBits ((int32_t) ((uint32_t) bits (a) + ((uint32_t) (int32_t) n << 23))); }
+};
+
+
+template <class V>
+struct ParticleIntegrator
+{
+	typedef typename V::Float F;
+	typedef typename V::Mask M;
+
+	// Natural logarithm of positive normal numbers (Cephes logf)
+	static inline F log (F x)
+	{
+		const F one = V::set (1.f);
+		F e = V::exponent (x);
+		F m = V::mantissa (x);
+
+		M small = V::lt (m, V::set (0.707106781186547524f));
+		e = V::select (small, V::sub (e, one), e);
+		m = V::sub (V::select (small, V::add (m, m), m), one);
+
+		F z = V::mul (m, m);
+		F y = V::set (7.0376836292E-2f);
+		y = V::madd (y, m, V::set (-1.1514610310E-1f));
+		y = V::madd (y, m, V::set (1.1676998740E-1f));
+		y = V::madd (y, m, V::set (-1.2420140846E-1f));
+		y = V::madd (y, m, V::set (1.4249322787E-1f));
+		y = V::madd (y, m, V::set (-1.6668057665E-1f));
+		y = V::madd (y, m, V::set (2.0000714765E-1f));
+		y = V::madd (y, m, V::set (-2.4999993993E-1f));
+		y = V::madd (y, m, V::set (3.3333331174E-1f));
+		y = V::mul (V::mul (y, m), z);
+
+		y = V::madd (e, V::set (-2.12194440E-4f), y);
+		y = V::madd (z, V::set (-0.5f), y);
+		F r = V::add (m, y);
+		return V::madd (e, V::set (0.693359375f), r);
+	}
+
+	// Exponential (Cephes expf), flushed to 0 below e^-87 and to infinity above e^88
+	static inline F exp (F x)
+	{
+		const F maxLog = V::set (88.f);
+		const F minLog = V::set (-87.f);
+		M over = V::gt (x, maxLog);
+		M under = V::lt (x, minLog);
+		x = V::min (V::max (x, minLog), maxLog);
+
+		F z = V::floor (V::madd (x, V::set (1.44269504088896341f), V::set (0.5f)));
+		x = V::madd (z, V::set (-0.693359375f), x);
+		x = V::madd (z, V::set (2.12194440E-4f), x);
+
+		F xx = V::mul (x, x);
+		F p = V::set (1.9875691500E-4f);
+		p = V::madd (p, x, V::set (1.3981999507E-3f));
+		p = V::madd (p, x, V::set (8.3334519073E-3f));
+		p = V::madd (p, x, V::set (4.1665795894E-2f));
+		p = V::madd (p, x, V::set (1.6666665459E-1f));
+		p = V::madd (p, x, V::set (5.0000001201E-1f));
+		p = V::add (V::madd (p, xx, x), V::set (1.f));
+		p = V::ldexp (p, z);
+
+		p = V::select (over, V::set (__builtin_inff ()), p);
+		return V::select (under, V::set (0.f), p);
+	}
+
+	// (r^2)^exponent, with exact shortcuts for the specialized force laws
+	template <int law>
+	static inline F power (F distance2, F exponent)
+	{
+		const F one = V::set (1.f);
+		switch (law) {
+		case CONSTANT_FORCE       : return V::div (one, V::sqrt (distance2));
+		case INVERSE_LINEAR_FORCE : return V::div (one, distance2);
+		case INVERSE_SQUARE_FORCE : return V::div (one, V::mul (distance2, V::sqrt (distance2)));
+		default                   : return exp (V::mul (exponent, log (distance2)));
+		}
+	}
+
+	template <int law, int bodyCount>
+	static inline void step (const ParticleKernelArgs &args, int i)
+	{
+		const int bodyNumber = (bodyCount == ANY_BODY_NUMBER) ? args.bodyNumber : bodyCount;
+		const F zero = V::set (0.f);
+		const F delay = V::set (args.delay);
+		const F exponent = V::set (args.exponent);
+
+		F x = V::load (args.x + i);
+		F y = V::load (args.y + i);
+		F dx = V::load (args.dx + i);
+		F dy = V::load (args.dy + i);
+
+		// Compute motion
+		F ddx = V::mul (V::set (- args.damping), dx);
+		F ddy = V::mul (V::set (- args.damping), dy);
+
+		for (int j = 0; j < bodyNumber; j++) {
+			F distanceX = V::sub (x, V::set (args.bodyX[j]));
+			F distanceY = V::sub (y, V::set (args.bodyY[j]));
+			F distance2 = V::madd (distanceX, distanceX, V::mul (distanceY, distanceY));
+
+			M onBody = V::eq (distance2, zero);
+			distance2 = V::max (V::select (onBody, V::set (1.f), distance2), V::set (1.17549435E-38f));
+			F scale = power<law> (distance2, exponent);
+
+			F unitX = V::mul (distanceX, scale);
+			F unitY = V::mul (distanceY, scale);
+			F forceX = V::sub (V::mul (unitX, V::set (args.cosAngle)), V::mul (unitY, V::set (args.sinAngle)));
+			F forceY = V::madd (unitX, V::set (args.sinAngle), V::mul (unitY, V::set (args.cosAngle)));
+			forceX = V::select (onBody, V::set (args.zeroX), forceX);
+			forceY = V::select (onBody, V::set (args.zeroY), forceY);
+
+			F weight = V::set (args.bodyWeight[j]);
+			ddx = V::sub (ddx, V::mul (weight, forceX));
+			ddy = V::sub (ddy, V::mul (weight, forceY));
+		}
+
+		// Apply motion
+		F ddxDelay = V::mul (ddx, delay);
+		F ddyDelay = V::mul (ddy, delay);
+		dx = V::add (dx, ddxDelay);
+		dy = V::add (dy, ddyDelay);
+
+		const F maxSpeed = V::set (args.maxSpeed);
+		const F minSpeed = V::set (- args.maxSpeed);
+		dx = V::max (V::min (dx, maxSpeed), minSpeed);
+		dy = V::max (V::min (dy, maxSpeed), minSpeed);
+
+		const F half = V::set (0.5f);
+		x = V::add (x, V::mul (V::sub (dx, V::mul (ddxDelay, half)), delay));
+		y = V::add (y, V::mul (V::sub (dy, V::mul (ddyDelay, half)), delay));
+
+		V::store (args.x + i, x);
+		V::store (args.y + i, y);
+		V::store (args.dx + i, dx);
+		V::store (args.dy + i, dy);
+	}
+
+	template <int law, int bodyCount>
+	static void integrate (const ParticleKernelArgs &args)
+	{
+		int i = args.first;
+		for (; i + V::width <= args.last; i += V::width) { step<law, bodyCount> (args, i); }
+		for (; i < args.last; i++) { ParticleIntegrator<ScalarVec>::template step<law, bodyCount> (args, i); }
+	}
+
+	template <int law>
+	static ParticleKernel select (int bodyNumber)
+	{
+		switch (bodyNumber) {
+		case 0  : return &integrate<law, 0>;
+		case 1  : return &integrate<law, 1>;
+		case 2  : return &integrate<law, 2>;
+		case 4  : return &integrate<law, 4>;
+		default : return &integrate<law, ANY_BODY_NUMBER>;
+		}
+	}
+
+	static ParticleKernel select (int forceLaw, int bodyNumber)
+	{
+		switch (forceLaw) {
+		case CONSTANT_FORCE       : return select<CONSTANT_FORCE> (bodyNumber);
+		case INVERSE_LINEAR_FORCE : return select<INVERSE_LINEAR_FORCE> (bodyNumber);
+		case INVERSE_SQUARE_FORCE : return select<INVERSE_SQUARE_FORCE> (bodyNumber);
+		default                   : return select<GENERIC_FORCE> (bodyNumber);
+		}
+	}
+};
+
+}
+
+
+#endif
@@ -0,0 +1,90 @@
+/*
+ * This file is part of Moving Cells.
+ *
+ * Moving Cells is is a digital installation building on a depth sensor to
+ * allow spectators to interact with a cloud of particles through their movements.
+ * It has been developed and first displayed in June 2015 by Robin Lamarche-Perrin
+ * and Bruno Pace for the eponymous dance festival, in Leipzig.
+ * See: http://www.movingcells.org
+ * 
+ * The current version of the program is implemented on Kinect for Windows v2 (K4W2)
+ * through the open source driver libreenect2.
+ * See: https://github.com/OpenKinect/libfreenect2
+ * 
+ * Copyright © 2015-2017 Robin Lamarche-Perrin and Bruno Pace
+ * (<Robin.Lamarche-Perrin@lip6.fr>)
+ * 
+ * Moving Cells is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ * 
+ * Moving Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+// SSE4.1 PARTICLE KERNEL (4 particles per iteration)
+// Compiled with -msse4.1, only called when the processor supports it.
+
+#include <smmintrin.h>
+
+#include "particle_kernels_simd.hpp"
+
+
+namespace {
+
+struct Sse4Vec
+{
+	typedef __m128 Float;
+	typedef __m128 Mask;
+	static const int width = 4;
+
+	static Float set (float v) { return _mm_set1_ps (v); }
+	static Float load (const float *p) { return _mm_loadu_ps (p); }
+	static void store (float *p, Float v) { _mm_storeu_ps (p, v); }
+
+	static Float add (Float a, Float b) { return _mm_add_ps (a, b); }
+	static Float sub (Float a, Float b) { return _mm_sub_ps (a, b); }
+	static Float mul (Float a, Float b) { return _mm_mul_ps (a, b); }
+	static Float madd (Float a, Float b, Float c) { return _mm_add_ps (_mm_mul_ps (a, b), c); }
+	static Float div (Float a, Float b) { return _mm_div_ps (a, b); }
+	static Float sqrt (Float a) { return _mm_sqrt_ps (a); }
+	static Float min (Float a, Float b) { return _mm_min_ps (a, b); }
+	static Float max (Float a, Float b) { return _mm_max_ps (a, b); }
+	static Float floor (Float a) { return _mm_floor_ps (a); }
+
+	static Mask lt (Float a, Float b) { return _mm_cmplt_ps (a, b); }
+	static Mask gt (Float a, Float b) { return _mm_cmpgt_ps (a, b); }
+	static Mask eq (Float a, Float b) { return _mm_cmpeq_ps (a, b); }
+	static Float select (Mask m, Float a, Float b) { return _mm_blendv_ps (b, a, m); }
+
+	static Float exponent (Float a)
+	{
+		__m128i e = _mm_and_si128 (_mm_srli_epi32 (_mm_castps_si128 (a), 23), _mm_set1_epi32 (0xff));
+		return _mm_cvtepi32_ps (_mm_sub_epi32 (e, _mm_set1_epi32 (126)));
+	}
+
+	static Float mantissa (Float a)
+	{
+		__m128i m = _mm_and_si128 (_mm_castps_si128 (a), _mm_set1_epi32 (0x807fffff));
+		return _mm_castsi128_ps (_mm_or_si128 (m, _mm_set1_epi32 (0x3f000000)));
+	}
+
+	static Float ldexp (Float a, Float n)
+	{
+		__m128i e = _mm_slli_epi32 (_mm_cvttps_epi32 (n), 23);
+		return _mm_castsi128_ps (_mm_add_epi32 (_mm_castps_si128 (a), e));
+	}
+};
+
+}
+
+
+ParticleKernel selectParticleKernelSSE4 (int forceLaw, int bodyNumber) { return ParticleIntegrator<Sse4Vec>::select (forceLaw, bodyNumber); }
@@ -0,0 +1,286 @@
+/*
+ * This file is part of Moving Cells.
+ *
+ * Moving Cells is is a digital installation building on a depth sensor to
+ * allow spectators to interact with a cloud of particles through their movements.
+ * It has been developed and first displayed in June 2015 by Robin Lamarche-Perrin
+ * and Bruno Pace for the eponymous dance festival, in Leipzig.
+ * See: http://www.movingcells.org
+ * 
+ * The current version of the program is implemented on Kinect for Windows v2 (K4W2)
+ * through the open source driver libreenect2.
+ * See: https://github.com/OpenKinect/libfreenect2
+ * 
+ * Copyright © 2015-2017 Robin Lamarche-Perrin and Bruno Pace
+ * (<Robin.Lamarche-Perrin@lip6.fr>)
+ * 
+ * Moving Cells is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ * 
+ * Moving Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "particle_snapshot.hpp"
+
+
+bool ParticleSnapshot::open (const std::string &vFilename)
+{
+	close();
+	filename = vFilename;
+
+	int fd = ::open (filename.c_str(), O_RDONLY);
+	if (fd < 0) { return false; }
+	struct stat status;
+	if (fstat (fd, &status) != 0 || (size_t) status.st_size < sizeof (SnapshotHeader)) { ::close (fd); return false; }
+	mappingSize = status.st_size;
+	mapping = mmap (NULL, mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close (fd);
+	if (mapping == MAP_FAILED) { mapping = NULL; return false; }
+
+	memcpy (&header, mapping, sizeof (SnapshotHeader));
+	bool valid = memcmp (header.magic, SNAPSHOT_MAGIC, sizeof (header.magic)) == 0
+		&& header.version == SNAPSHOT_VERSION
+		&& header.headerSize >= sizeof (SnapshotHeader)
+		&& header.groupSize > 0 && header.fieldNumber % header.groupSize == 0
+		&& header.headerSize + header.particleNumber * header.fieldNumber * sizeof (float) <= mappingSize;
+	if (!valid) {
+		std::cerr << "Error: " << filename << " is not a version " << SNAPSHOT_VERSION << " particle snapshot" << std::endl;
+		close();
+		return false;
+	}
+
+	madvise (mapping, mappingSize, MADV_WILLNEED);
+	return true;
+}
+
+
+void ParticleSnapshot::close ()
+{
+	if (mapping == NULL) { return; }
+	munmap (mapping, mappingSize);
+	mapping = NULL;
+	mappingSize = 0;
+}
+
+
+// Copies the first particles into arrays of groupSize interleaved fields,
+// whatever the layout of the snapshot
+int ParticleSnapshot::read (float * const *arrays, int fieldNumber, int groupSize, int number) const
+{
+	if ((int) header.fieldNumber != fieldNumber) { return -1; }
+	if (number > getParticleNumber()) { number = getParticleNumber(); }
+
+	if ((int) header.groupSize == groupSize) {
+		for (int i = 0; i < fieldNumber / groupSize; i++) { memcpy (arrays[i], getArray (i), (size_t) number * groupSize * sizeof (float)); }
+		return number;
+	}
+	for (int field = 0; field < fieldNumber; field++) {
+		const float *source = getArray (field / header.groupSize) + field % header.groupSize;
+		float *destination = arrays[field / groupSize] + field % groupSize;
+		for (int i = 0; i < number; i++) { destination[(size_t) i * groupSize] = source[(size_t) i * header.groupSize]; }
+	}
+	return number;
+}
+
+
+// One particle per line, its fields separated by spaces
+int ParticleSnapshot::importText (const std::string &filename, float * const *arrays, int fieldNumber, int groupSize, int number)
+{
+	std::ifstream file (filename, std::ios::in);
+	if (! file.is_open()) { return -1; }
+
+	int i = 0;
+	std::string line;
+	float fields[SNAPSHOT_MAX_FIELD_NUMBER] = {0};
+	while (i < number && std::getline (file, line)) {
+		std::istringstream ss (line);
+		for (int field = 0; field < fieldNumber; field++) { ss >> fields[field]; }
+		for (int field = 0; field < fieldNumber; field++) { arrays[field / groupSize][(size_t) i * groupSize + field % groupSize] = fields[field]; }
+		i++;
+	}
+	return i;
+}
+
+
+int ParticleSnapshot::load (const std::string &filename, float * const *arrays, int fieldNumber, int groupSize, int number)
+{
+	if (isText (filename)) { return importText (filename, arrays, fieldNumber, groupSize, number); }
+	ParticleSnapshot snapshot;
+	if (! snapshot.open (filename)) { return -1; }
+	return snapshot.read (arrays, fieldNumber, groupSize, number);
+}
+
+
+// Written to a temporary file first and synced, so that readers never see a
+// partial snapshot, even after a power cut
+bool ParticleSnapshot::write (const std::string &filename, int particleNumber, int width, int height, int fieldNumber, int groupSize, const float * const *arrays)
+{
+	SnapshotHeader header;
+	memset (&header, 0, sizeof (SnapshotHeader));
+	memcpy (header.magic, SNAPSHOT_MAGIC, sizeof (header.magic));
+	header.version = SNAPSHOT_VERSION;
+	header.headerSize = SNAPSHOT_HEADER_SIZE;
+	header.particleNumber = particleNumber;
+	header.width = width;
+	header.height = height;
+	header.fieldNumber = fieldNumber;
+	header.groupSize = groupSize;
+
+	std::string temporaryFilename = filename + ".tmp";
+	FILE *file = fopen (temporaryFilename.c_str(), "wb");
+	if (file == NULL) { return false; }
+
+	char padding[SNAPSHOT_HEADER_SIZE] = {0};
+	bool written = fwrite (&header, sizeof (SnapshotHeader), 1, file) == 1
+		&& fwrite (padding, SNAPSHOT_HEADER_SIZE - sizeof (SnapshotHeader), 1, file) == 1;
+	size_t arraySize = (size_t) particleNumber * groupSize;
+	for (int i = 0; written && i < fieldNumber / groupSize; i++) { written = fwrite (arrays[i], sizeof (float), arraySize, file) == arraySize; }
+	written = written && fflush (file) == 0 && fsync (fileno (file)) == 0;
+	written = (fclose (file) == 0) && written;
+
+	if (!written || rename (temporaryFilename.c_str(), filename.c_str()) != 0) { unlink (temporaryFilename.c_str()); return false; }
+	return true;
+}
+
+
+bool ParticleSnapshot::isText (const std::string &filename)
+{
+	size_t length = strlen (TEXT_SNAPSHOT_EXTENSION);
+	return filename.size() >= length && filename.compare (filename.size() - length, length, TEXT_SNAPSHOT_EXTENSION) == 0;
+}
+
+
+// When both exist, the text file may have been edited since the binary one
+// was written (e.g. by tools/partikules/adjust_particle_positions.R)
+std::string ParticleSnapshot::find (const std::string &name)
+{
+	std::string filename = name + SNAPSHOT_EXTENSION;
+	std::string textFilename = name + TEXT_SNAPSHOT_EXTENSION;
+	struct stat binaryStat, textStat;
+	if (stat (filename.c_str(), &binaryStat) != 0 || access (filename.c_str(), R_OK) != 0) { return textFilename; }
+	if (stat (textFilename.c_str(), &textStat) != 0) { return filename; }
+
+	bool textNewer = textStat.st_mtim.tv_sec > binaryStat.st_mtim.tv_sec
+		|| (textStat.st_mtim.tv_sec == binaryStat.st_mtim.tv_sec && textStat.st_mtim.tv_nsec > binaryStat.st_mtim.tv_nsec);
+	return textNewer ? textFilename : filename;
+}
+
+
+// SNAPSHOT WRITER
+
+void SnapshotWriter::start ()
+{
+	if (running) { return; }
+	stopping = false;
+	int rc = pthread_create (&thread, NULL, &SnapshotWriter::run, (void *) this);
+	if (rc) { std::cout << "Error: Unable to create thread " << rc << std::endl; exit (-1); }
+	running = true;
+}
+
+
+void SnapshotWriter::stop ()
+{
+	if (!running) { return; }
+	pthread_mutex_lock (&mutex);
+	stopping = true;
+	pthread_cond_signal (&condition);
+	pthread_mutex_unlock (&mutex);
+	pthread_join (thread, NULL);
+	running = false;
+}
+
+
+void SnapshotWriter::capture (const std::string &filename, int particleNumber, int width, int height, int fieldNumber, int groupSize, const float * const *arrays, bool verbose)
+{
+	start();
+
+	// Never waits for the writer: a capture of the same file still pending is
+	// replaced (autosaves), otherwise a free buffer is used or a new one added
+	pthread_mutex_lock (&mutex);
+	SnapshotCapture *spare = NULL;
+	SnapshotCapture *pending = NULL;
+	for (std::list<SnapshotCapture>::iterator it = captures.begin(); it != captures.end(); ++it) {
+		if (it->state == PENDING_CAPTURE && it->filename == filename) { pending = &*it; }
+		else if (it->state == FREE_CAPTURE && spare == NULL) { spare = &*it; }
+	}
+	if (pending != NULL) { std::cout << "REPLACING PARTICLE SNAPSHOT: " << filename << std::endl; }
+	else if (spare == NULL) { captures.push_back (SnapshotCapture()); spare = &captures.back(); }
+	SnapshotCapture &capture = (pending != NULL) ? *pending : *spare;
+	capture.state = FILLING_CAPTURE;
+	pthread_mutex_unlock (&mutex);
+
+	size_t arraySize = (size_t) particleNumber * groupSize;
+	capture.data.resize (arraySize * (fieldNumber / groupSize));
+	for (int i = 0; i < fieldNumber / groupSize; i++) { memcpy (capture.data.data() + i * arraySize, arrays[i], arraySize * sizeof (float)); }
+	capture.filename = filename;
+	capture.particleNumber = particleNumber;
+	capture.width = width;
+	capture.height = height;
+	capture.fieldNumber = fieldNumber;
+	capture.groupSize = groupSize;
+	capture.verbose = verbose;
+
+	pthread_mutex_lock (&mutex);
+	capture.state = PENDING_CAPTURE;
+	capture.order = captureNumber++;
+	pthread_cond_signal (&condition);
+	pthread_mutex_unlock (&mutex);
+}
+
+
+void *SnapshotWriter::run (void *writer)
+{
+	reinterpret_cast<SnapshotWriter*>(writer)->run();
+	pthread_exit (NULL);
+}
+
+
+void SnapshotWriter::run ()
+{
+	pthread_mutex_lock (&mutex);
+	while (true)
+	{
+		SnapshotCapture *next = NULL;
+		while (true) {
+			for (std::list<SnapshotCapture>::iterator it = captures.begin(); it != captures.end(); ++it) {
+				if (it->state == PENDING_CAPTURE && (next == NULL || (int) (it->order - next->order) < 0)) { next = &*it; }
+			}
+			if (next != NULL || stopping) { break; }
+			pthread_cond_wait (&condition, &mutex);
+		}
+		if (next == NULL) { break; }
+		SnapshotCapture &capture = *next;
+		capture.state = WRITING_CAPTURE;
+		pthread_mutex_unlock (&mutex);
+
+		std::vector<const float *> arrays;
+		for (int i = 0; i < capture.fieldNumber / capture.groupSize; i++) { arrays.push_back (capture.data.data() + (size_t) i * capture.particleNumber * capture.groupSize); }
+		if (! ParticleSnapshot::write (capture.filename, capture.particleNumber, capture.width, capture.height, capture.fieldNumber, capture.groupSize, arrays.data())) {
+			std::cout << "COULD NOT WRITE FILE: " << capture.filename << std::endl;
+		}
+		else if (capture.verbose) { std::cout << "SAVING PARTICLE POSITIONS: " << capture.filename << std::endl; }
+
+		pthread_mutex_lock (&mutex);
+		capture.state = FREE_CAPTURE;
+	}
+	pthread_mutex_unlock (&mutex);
+}
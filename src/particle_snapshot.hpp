@@ -0,0 +1,159 @@
+/*
+ * This file is part of Moving Cells.
+ *
+ * Moving Cells is is a digital installation building on a depth sensor to
+ * allow spectators to interact with a cloud of particles through their movements.
+ * It has been developed and first displayed in June 2015 by Robin Lamarche-Perrin
+ * and Bruno Pace for the eponymous dance festival, in Leipzig.
+ * See: http://www.movingcells.org
+ * 
+ * The current version of the program is implemented on Kinect for Windows v2 (K4W2)
+ * through the open source driver libreenect2.
+ * See: https://github.com/OpenKinect/libfreenect2
+ * 
+ * Copyright © 2015-2017 Robin Lamarche-Perrin and Bruno Pace
+ * (<Robin.Lamarche-Perrin@lip6.fr>)
+ * 
+ * Moving Cells is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ * 
+ * Moving Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef PARTICLE_SNAPSHOT_HPP
+#define PARTICLE_SNAPSHOT_HPP
+
+#include <string>
+#include <vector>
+#include <list>
+#include <cstdint>
+#include <pthread.h>
+
+
+#define SNAPSHOT_MAGIC            "PSNAPSHT"          // 8 bytes
+#define SNAPSHOT_VERSION          1
+#define SNAPSHOT_HEADER_SIZE      64                  // arrays start on a cache line
+#define SNAPSHOT_MAX_FIELD_NUMBER 6
+#define SNAPSHOT_EXTENSION        ".snapshot"
+#define TEXT_SNAPSHOT_EXTENSION   ".csv"              // one particle per line, fields separated by spaces
+
+
+// PARTICLE SNAPSHOT
+//
+// Binary snapshot of the particle states: a header, then the raw float
+// arrays. Particles hold fieldNumber floats (x y dx dy in 2D, x y z dx dy dz
+// in 3D), stored as fieldNumber / groupSize arrays of groupSize interleaved
+// fields: groupSize 1 is a structure of arrays, groupSize fieldNumber an array
+// of structures. Each cloud writes its own memory layout, so that saving and
+// loading are plain copies.
+//
+// Snapshots are read through mmap, without any parsing. Text snapshots stay
+// available for import and export, chosen by their extension.
+
+struct SnapshotHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t headerSize;                      // offset of the arrays
+	uint64_t particleNumber;
+	uint32_t width;                           // resolution of the recording cloud
+	uint32_t height;
+	uint32_t fieldNumber;                     // floats per particle
+	uint32_t groupSize;                       // fields interleaved in each array
+};
+
+
+class ParticleSnapshot
+{
+public:
+	SnapshotHeader header;
+	std::string filename;
+	void *mapping = NULL;
+	size_t mappingSize = 0;
+
+	ParticleSnapshot () {}
+	~ParticleSnapshot () { close(); }
+
+	bool open (const std::string &vFilename);   // false when missing or invalid
+	void close ();
+	bool isOpen () const { return mapping != NULL; }
+
+	int getParticleNumber () const { return header.particleNumber; }
+	int getArrayNumber () const { return header.fieldNumber / header.groupSize; }
+	const float *getArray (int index) const { return (const float *) ((const char *) mapping + header.headerSize) + (size_t) index * header.groupSize * header.particleNumber; }
+
+	int read (float * const *arrays, int fieldNumber, int groupSize, int number) const;   // particles read, -1 when the fields differ
+	static int importText (const std::string &filename, float * const *arrays, int fieldNumber, int groupSize, int number);   // -1 when missing
+	static int load (const std::string &filename, float * const *arrays, int fieldNumber, int groupSize, int number);         // either format
+	static bool write (const std::string &filename, int particleNumber, int width, int height, int fieldNumber, int groupSize, const float * const *arrays);
+	static bool isText (const std::string &filename);
+	static std::string find (const std::string &name);   // the newer of the binary and text snapshots
+
+private:
+	ParticleSnapshot (const ParticleSnapshot &);
+	ParticleSnapshot &operator= (const ParticleSnapshot &);
+};
+
+
+
+// SNAPSHOT WRITER
+//
+// Writes snapshots on a background thread. A capture copies the particle
+// arrays into a spare buffer, which takes about a millisecond, and returns:
+// the formatting and the disk never stall the caller. While a snapshot is
+// being written, a newer capture of the same file replaces the one waiting
+// for the writer (autosaves); a capture of another file gets its own buffer.
+
+// Snapshot capture states
+#define FREE_CAPTURE              0
+#define FILLING_CAPTURE           1
+#define PENDING_CAPTURE           2
+#define WRITING_CAPTURE           3
+
+
+struct SnapshotCapture
+{
+	std::vector<float> data;                  // the arrays one after the other
+	std::string filename;
+	int particleNumber;
+	int width;
+	int height;
+	int fieldNumber;
+	int groupSize;
+	bool verbose;
+	int state = FREE_CAPTURE;
+	unsigned int order = 0;                   // pending captures are written oldest first
+};
+
+
+class SnapshotWriter
+{
+public:
+	std::list<SnapshotCapture> captures;      // grows only while distinct files wait for the writer
+	unsigned int captureNumber = 0;
+
+	bool running = false;
+	bool stopping = false;
+	pthread_t thread;
+	pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+	pthread_cond_t condition = PTHREAD_COND_INITIALIZER;
+
+	void start ();
+	void stop ();                             // writes the pending captures first
+	void capture (const std::string &filename, int particleNumber, int width, int height, int fieldNumber, int groupSize, const float * const *arrays, bool verbose);
+
+	static void *run (void *writer);
+	void run ();
+};
+
+
+#endif
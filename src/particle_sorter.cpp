@@ -0,0 +1,186 @@
+/*
+ * This file is part of Moving Cells.
+ *
+ * Moving Cells is is a digital installation building on a depth sensor to
+ * allow spectators to interact with a cloud of particles through their movements.
+ * It has been developed and first displayed in June 2015 by Robin Lamarche-Perrin
+ * and Bruno Pace for the eponymous dance festival, in Leipzig.
+ * See: http://www.movingcells.org
+ * 
+ * The current version of the program is implemented on Kinect for Windows v2 (K4W2)
+ * through the open source driver libreenect2.
+ * See: https://github.com/OpenKinect/libfreenect2
+ * 
+ * Copyright © 2015-2017 Robin Lamarche-Perrin and Bruno Pace
+ * (<Robin.Lamarche-Perrin@lip6.fr>)
+ * 
+ * Moving Cells is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ * 
+ * Moving Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+// LIBRARIES
+
+#include <algorithm>
+#include <cstring>
+
+#include "particle_sorter.hpp"
+
+
+// FUNCTIONS
+
+// Interleaves the bits of x (even bits) and y (odd bits), for coordinates below 65536
+unsigned int ParticleSorter::getMortonCode (unsigned int x, unsigned int y)
+{
+	x &= 0xffff;
+	x = (x | (x << 8)) & 0x00ff00ff;
+	x = (x | (x << 4)) & 0x0f0f0f0f;
+	x = (x | (x << 2)) & 0x33333333;
+	x = (x | (x << 1)) & 0x55555555;
+
+	y &= 0xffff;
+	y = (y | (y << 8)) & 0x00ff00ff;
+	y = (y | (y << 4)) & 0x0f0f0f0f;
+	y = (y | (y << 2)) & 0x33333333;
+	y = (y | (y << 1)) & 0x55555555;
+
+	return x | (y << 1);
+}
+
+
+void ParticleSorter::sort (WorkerPool *vWorkers, ParticleArray *vParticles, int vNumber, float vScale, int vWidth, int vHeight)
+{
+	workers = vWorkers;
+	workerNumber = std::max (workers->workerNumber, 1);
+	particles = vParticles;
+	number = vNumber;
+	scale = vScale;
+	width = vWidth;
+	height = vHeight;
+
+	if ((int) keys.size() < number) {
+		keys.resize (number);
+		sortedKeys.resize (number);
+		indices.resize (number);
+		sortedIndices.resize (number);
+	}
+	if (buffer.number < number) { buffer.allocate (number); }
+	digitCounts.resize (workerNumber * RADIX_SIZE);
+
+	// Number of bits of the Morton codes of the screen
+	int coordinateBits = 0;
+	while ((1 << coordinateBits) < std::max (width, height)) { coordinateBits++; }
+	int keyBits = 2 * coordinateBits;
+
+	workers->run (&ParticleSorter::computeKeys, this);
+
+	for (shift = 0; shift < keyBits; shift += RADIX_BITS) {
+		workers->run (&ParticleSorter::countDigits, this);
+
+		int offset = 0;
+		for (int digit = 0; digit < RADIX_SIZE; digit++) {
+			for (int worker = 0; worker < workerNumber; worker++) {
+				int &count = digitCounts[worker * RADIX_SIZE + digit];
+				int digitNumber = count;
+				count = offset;
+				offset += digitNumber;
+			}
+		}
+
+		workers->run (&ParticleSorter::moveKeys, this);
+		keys.swap (sortedKeys);
+		indices.swap (sortedIndices);
+	}
+
+	workers->run (&ParticleSorter::permuteParticles, this);
+	workers->run (&ParticleSorter::copyParticles, this);
+}
+
+
+void ParticleSorter::computeKeys (void *sorter, int id)
+{
+	reinterpret_cast<ParticleSorter*>(sorter)->computeKeys (id);
+}
+
+void ParticleSorter::computeKeys (int id)
+{
+	for (int i = getFirst (id); i < getLast (id); i++) {
+		int x = std::min (std::max ((int) (particles->x[i] * scale), 0), width - 1);
+		int y = std::min (std::max ((int) (particles->y[i] * scale), 0), height - 1);
+		keys[i] = getMortonCode (x, y);
+		indices[i] = i;
+	}
+}
+
+
+void ParticleSorter::countDigits (void *sorter, int id)
+{
+	reinterpret_cast<ParticleSorter*>(sorter)->countDigits (id);
+}
+
+void ParticleSorter::countDigits (int id)
+{
+	int *counts = digitCounts.data() + id * RADIX_SIZE;
+	for (int digit = 0; digit < RADIX_SIZE; digit++) { counts[digit] = 0; }
+	for (int i = getFirst (id); i < getLast (id); i++) { counts[(keys[i] >> shift) & (RADIX_SIZE - 1)]++; }
+}
+
+
+void ParticleSorter::moveKeys (void *sorter, int id)
+{
+	reinterpret_cast<ParticleSorter*>(sorter)->moveKeys (id);
+}
+
+void ParticleSorter::moveKeys (int id)
+{
+	int *offsets = digitCounts.data() + id * RADIX_SIZE;
+	for (int i = getFirst (id); i < getLast (id); i++) {
+		int position = offsets[(keys[i] >> shift) & (RADIX_SIZE - 1)]++;
+		sortedKeys[position] = keys[i];
+		sortedIndices[position] = indices[i];
+	}
+}
+
+
+void ParticleSorter::permuteParticles (void *sorter, int id)
+{
+	reinterpret_cast<ParticleSorter*>(sorter)->permuteParticles (id);
+}
+
+void ParticleSorter::permuteParticles (int id)
+{
+	for (int i = getFirst (id); i < getLast (id); i++) {
+		int j = indices[i];
+		buffer.x[i] = particles->x[j];
+		buffer.y[i] = particles->y[j];
+		buffer.dx[i] = particles->dx[j];
+		buffer.dy[i] = particles->dy[j];
+	}
+}
+
+
+void ParticleSorter::copyParticles (void *sorter, int id)
+{
+	reinterpret_cast<ParticleSorter*>(sorter)->copyParticles (id);
+}
+
+void ParticleSorter::copyParticles (int id)
+{
+	int first = getFirst (id);
+	int size = (getLast (id) - first) * sizeof (float);
+	memcpy (particles->x + first, buffer.x + first, size);
+	memcpy (particles->y + first, buffer.y + first, size);
+	memcpy (particles->dx + first, buffer.dx + first, size);
+	memcpy (particles->dy + first, buffer.dy + first, size);
+}
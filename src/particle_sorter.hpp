@@ -0,0 +1,102 @@
+/*
+ * This file is part of Moving Cells.
+ *
+ * Moving Cells is is a digital installation building on a depth sensor to
+ * allow spectators to interact with a cloud of particles through their movements.
+ * It has been developed and first displayed in June 2015 by Robin Lamarche-Perrin
+ * and Bruno Pace for the eponymous dance festival, in Leipzig.
+ * See: http://www.movingcells.org
+ * 
+ * The current version of the program is implemented on Kinect for Windows v2 (K4W2)
+ * through the open source driver libreenect2.
+ * See: https://github.com/OpenKinect/libfreenect2
+ * 
+ * Copyright © 2015-2017 Robin Lamarche-Perrin and Bruno Pace
+ * (<Robin.Lamarche-Perrin@lip6.fr>)
+ * 
+ * Moving Cells is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ * 
+ * Moving Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef PARTICLE_SORTER_HPP
+#define PARTICLE_SORTER_HPP
+
+#include <vector>
+
+#include "worker_pool.hpp"
+#include "particle_array.hpp"
+
+
+#define RADIX_BITS            8
+#define RADIX_SIZE            (1 << RADIX_BITS)
+
+
+// PARTICLE SORTER
+//
+// Reorders particles by the Z-order (Morton) code of the pixel they lie on,
+// so that particles close in the arrays are close on the screen. The keys
+// are sorted with a parallel least-significant-digit radix sort run by the
+// workers of a WorkerPool: in each pass, every worker counts the digits of
+// its chunk of keys, the counts are turned into offsets (digit first, then
+// worker), and every worker moves its keys to their offsets. The sort is
+// stable, hence deterministic. Only the digits covering the screen
+// coordinates are sorted. The particles are permuted into a buffer and
+// copied back, so that the particle arrays keep their address.
+
+class ParticleSorter
+{
+public:
+	WorkerPool *workers = NULL;
+	int workerNumber = 0;
+
+	ParticleArray *particles = NULL;
+	ParticleArray buffer;
+	int number = 0;
+	float scale = 1;
+	int width = 0;
+	int height = 0;
+	int shift = 0;
+
+	std::vector<unsigned int> keys;
+	std::vector<unsigned int> sortedKeys;
+	std::vector<int> indices;
+	std::vector<int> sortedIndices;
+	std::vector<int> digitCounts;        // per worker and digit, then write positions
+
+	// Sorts the first vNumber particles, whose pixel is (x * vScale, y * vScale)
+	void sort (WorkerPool *vWorkers, ParticleArray *vParticles, int vNumber, float vScale, int vWidth, int vHeight);
+
+	static unsigned int getMortonCode (unsigned int x, unsigned int y);
+
+	int getFirst (int id) { return (long) number * id / workerNumber; }
+	int getLast (int id) { return (long) number * (id + 1) / workerNumber; }
+
+	static void computeKeys (void *sorter, int id);
+	void computeKeys (int id);
+
+	static void countDigits (void *sorter, int id);
+	void countDigits (int id);
+
+	static void moveKeys (void *sorter, int id);
+	void moveKeys (int id);
+
+	static void permuteParticles (void *sorter, int id);
+	void permuteParticles (int id);
+
+	static void copyParticles (void *sorter, int id);
+	void copyParticles (int id);
+};
+
+
+#endif
@@ -0,0 +1,141 @@
+/*
+ * This file is part of Moving Cells.
+ *
+ * Moving Cells is is a digital installation building on a depth sensor to
+ * allow spectators to interact with a cloud of particles through their movements.
+ * It has been developed and first displayed in June 2015 by Robin Lamarche-Perrin
+ * and Bruno Pace for the eponymous dance festival, in Leipzig.
+ * See: http://www.movingcells.org
+ * 
+ * The current version of the program is implemented on Kinect for Windows v2 (K4W2)
+ * through the open source driver libreenect2.
+ * See: https://github.com/OpenKinect/libfreenect2
+ * 
+ * Copyright © 2015-2017 Robin Lamarche-Perrin and Bruno Pace
+ * (<Robin.Lamarche-Perrin@lip6.fr>)
+ * 
+ * Moving Cells is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ * 
+ * Moving Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// LIBRARIES
+
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+#include "pixel_kernels.hpp"
+
+
+// FUNCTIONS
+
+namespace {
+
+inline void storeColor (const PixelKernelArgs &args, int i, uint32_t color)
+{
+	unsigned char *p = args.frame + (i - args.first) * args.frameChannels;
+	if (args.frameChannels == 4) { memcpy (p, &color, 4); return; }
+	p[0] = color;
+	p[1] = color >> 8;
+	p[2] = color >> 16;
+}
+
+}
+
+
+void convertPixelsScalar (const PixelKernelArgs &args, int first, int last)
+{
+	float maxEntry = COLOR_TABLE_SIZE - 1;
+
+	for (int i = first; i < last; i++)
+	{
+		unsigned int count = args.counts[i];
+		args.counts[i] = 0;
+
+		float pixel = args.pixels[i] * args.cleaningRate + count * args.drawingRate;
+		args.pixels[i] = pixel;
+
+		float entry = pixel * args.tableScale;
+		if (entry > maxEntry) { entry = maxEntry; }
+		uint32_t color = args.table[(int) entry];
+
+		storeColor (args, i, color);
+	}
+}
+
+
+void convertPixelsScalar (const PixelKernelArgs &args) { convertPixelsScalar (args, args.first, args.last); }
+
+
+void convertFixedPixelsScalar (const PixelKernelArgs &args, int first, int last)
+{
+	for (int i = first; i < last; i++)
+	{
+		unsigned int count = args.counts[i];
+		args.counts[i] = 0;
+		if (count > 0xffff) { count = 0xffff; }
+
+		unsigned int dither = ((unsigned int) i * FIXED_DITHER_STEP + args.fixedDither) & 0xffff;
+		unsigned int pixel = args.fixedPixels[i];
+		unsigned int faded = (pixel * args.fixedCleaningRate + dither) >> 16;
+		if (faded == pixel && pixel > 0 && pixel < FIXED_FADE_EPSILON && count == 0) { faded--; }
+
+		unsigned int drawn = count * args.fixedDrawingRate + ((count * args.fixedDrawingFraction + (dither ^ 0xffff)) >> 16);
+		pixel = faded + drawn;
+		if (pixel > 0xffff) { pixel = 0xffff; }
+		args.fixedPixels[i] = pixel;
+
+		uint32_t color = args.table[pixel >> FIXED_TABLE_SHIFT];
+		storeColor (args, i, color);
+	}
+}
+
+
+void convertFixedPixelsScalar (const PixelKernelArgs &args) { convertFixedPixelsScalar (args, args.first, args.last); }
+
+
+// Fixed-point rates and dither of the float rates of args, for densities
+// with shift fractional bits
+void setupFixedRates (PixelKernelArgs &args, int shift, int frame)
+{
+	args.fixedCleaningRate = std::min (0xffff, (int) lround (args.cleaningRate * 0x10000));
+	long drawingRate = std::min (0xffffL << 16, (long) lround (ldexp (args.drawingRate, shift + 16)));
+	args.fixedDrawingRate = drawingRate >> 16;
+	args.fixedDrawingFraction = drawingRate & 0xffff;
+	args.fixedDither = ((unsigned int) frame * FIXED_DITHER_FRAME_STEP) & 0xffff;
+}
+
+
+// The AVX-512 particle kernel has no pixel counterpart: gathers are not
+// faster there and the conversion is bound by memory anyway.
+PixelKernel getPixelKernel (int kernel)
+{
+	switch (kernel) {
+	case SSE4_KERNEL   : return convertPixelsSSE4;
+	case AVX2_KERNEL   : return convertPixelsAVX2;
+	case AVX512_KERNEL : return convertPixelsAVX2;
+	default            : return convertPixelsScalar;
+	}
+}
+
+
+PixelKernel getFixedPixelKernel (int kernel)
+{
+	switch (kernel) {
+	case SSE4_KERNEL   : return convertFixedPixelsSSE4;
+	case AVX2_KERNEL   : return convertFixedPixelsAVX2;
+	case AVX512_KERNEL : return convertFixedPixelsAVX2;
+	default            : return convertFixedPixelsScalar;
+	}
+}
@@ -0,0 +1,123 @@
+/*
+ * This file is part of Moving Cells.
+ *
+ * Moving Cells is is a digital installation building on a depth sensor to
+ * allow spectators to interact with a cloud of particles through their movements.
+ * It has been developed and first displayed in June 2015 by Robin Lamarche-Perrin
+ * and Bruno Pace for the eponymous dance festival, in Leipzig.
+ * See: http://www.movingcells.org
+ * 
+ * The current version of the program is implemented on Kinect for Windows v2 (K4W2)
+ * through the open source driver libreenect2.
+ * See: https://github.com/OpenKinect/libfreenect2
+ * 
+ * Copyright © 2015-2017 Robin Lamarche-Perrin and Bruno Pace
+ * (<Robin.Lamarche-Perrin@lip6.fr>)
+ * 
+ * Moving Cells is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ * 
+ * Moving Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef PIXEL_KERNELS_HPP
+#define PIXEL_KERNELS_HPP
+
+#include <stdint.h>
+
+#include "particle_kernels.hpp"
+
+
+// COLOR TABLE
+
+#define COLOR_TABLE_SIZE          4096
+
+
+// FIXED-POINT DENSITIES
+
+#define FIXED_TABLE_SHIFT         4         // 65536 fixed-point densities for COLOR_TABLE_SIZE entries
+#define FIXED_MAX_SHIFT           12        // at most 12 fractional bits
+#define FIXED_FADE_EPSILON        (1 << FIXED_TABLE_SHIFT)   // densities below the first color, always decreasing without particles
+#define FIXED_DITHER_STEP         0x9e37    // dither offset between consecutive pixels (golden ratio)
+#define FIXED_DITHER_FRAME_STEP   0x6a09    // dither offset between consecutive frames (square root of 2)
+#define FIXED_FADE_TOLERANCE      0.01      // relative deviation of the mean fixed-point density from the float one
+
+
+// KERNEL ARGUMENTS
+//
+// The kernels read the particle counts of the pixels in [first, last)
+// (resetting them to zero), update the pixel densities with the
+// cleaning and drawing rates, and write the colours of these pixels from frame
+// on, in BGR (3 channels) or BGRA (4 channels, as ARGB8888 textures).
+//
+// Colours are read from a table of COLOR_TABLE_SIZE packed entries (blue in
+// the lowest byte, then green and red), with the pixel intensity already
+// applied and an opaque alpha in the highest byte. The entry of a pixel is its density times tableScale, clamped to
+// the last entry which holds the saturated colour.
+//
+// The fixed-point kernels keep the densities in saturating unsigned 16 bits
+// with fixedShift fractional bits, instead of floats. They are faded by a
+// multiply-high with the cleaning rate in 0.16 fixed point, and particle
+// counts times the drawing rate (an integer part and a 0.16 fraction) are
+// added with saturation. Both products are rounded with a dither of 16 bits,
+// (i * FIXED_DITHER_STEP + fixedDither) for the fading and its complement for
+// the drawing: they are exact on average, over neighbouring pixels and over
+// frames, so the densities follow the float half-life at any level. Densities
+// below FIXED_FADE_EPSILON without particles decrease by one at least, so that
+// they still vanish. Their table is indexed by the density >> FIXED_TABLE_SHIFT.
+//
+// The SIMD kernels convert 16 pixels per iteration and give exactly the same
+// densities and colours as the scalar ones.
+
+struct PixelKernelArgs
+{
+	unsigned int *counts;
+	float *pixels;
+	unsigned char *frame;     // colour of the first pixel
+	int frameChannels;        // 3 or 4 bytes per colour
+	int first;
+	int last;
+
+	float cleaningRate;
+	float drawingRate;
+
+	uint16_t *fixedPixels;
+	int fixedCleaningRate;    // in 0.16 fixed point
+	int fixedDrawingRate;     // density of one particle, in fixed point (integer part)
+	int fixedDrawingFraction; // its fractional part, in 0.16 fixed point
+	int fixedDither;          // dither of the pixel 0, changed every frame
+
+	const uint32_t *table;
+	float tableScale;
+};
+
+typedef void (*PixelKernel) (const PixelKernelArgs &args);
+
+
+// FUNCTIONS
+
+PixelKernel getPixelKernel (int kernel);
+PixelKernel getFixedPixelKernel (int kernel);
+void setupFixedRates (PixelKernelArgs &args, int shift, int frame);
+
+void convertPixelsScalar (const PixelKernelArgs &args, int first, int last);
+void convertPixelsScalar (const PixelKernelArgs &args);
+void convertPixelsSSE4 (const PixelKernelArgs &args);
+void convertPixelsAVX2 (const PixelKernelArgs &args);
+
+void convertFixedPixelsScalar (const PixelKernelArgs &args, int first, int last);
+void convertFixedPixelsScalar (const PixelKernelArgs &args);
+void convertFixedPixelsSSE4 (const PixelKernelArgs &args);
+void convertFixedPixelsAVX2 (const PixelKernelArgs &args);
+
+
+#endif
@@ -0,0 +1,166 @@
+/*
+ * This file is part of Moving Cells.
+ *
+ * Moving Cells is is a digital installation building on a depth sensor to
+ * allow spectators to interact with a cloud of particles through their movements.
+ * It has been developed and first displayed in June 2015 by Robin Lamarche-Perrin
+ * and Bruno Pace for the eponymous dance festival, in Leipzig.
+ * See: http://www.movingcells.org
+ * 
+ * The current version of the program is implemented on Kinect for Windows v2 (K4W2)
+ * through the open source driver libreenect2.
+ * See: https://github.com/OpenKinect/libfreenect2
+ * 
+ * Copyright © 2015-2017 Robin Lamarche-Perrin and Bruno Pace
+ * (<Robin.Lamarche-Perrin@lip6.fr>)
+ * 
+ * Moving Cells is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ * 
+ * Moving Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// AVX2 PIXEL KERNEL (16 pixels per iteration)
+// Compiled with -mavx2, only called when the processor supports it.
+
+#include <immintrin.h>
+
+#include "pixel_kernels.hpp"
+
+
+namespace {
+
+// Densities and colors of 8 pixels, counts reset to zero
+inline __m256i updatePixels (const PixelKernelArgs &args, int i, __m256 cleaningRate, __m256 drawingRate, __m256 tableScale, __m256 maxEntry)
+{
+	__m256i *c = (__m256i *) (args.counts + i);
+	__m256i count = _mm256_loadu_si256 (c);
+	_mm256_storeu_si256 (c, _mm256_setzero_si256 ());
+
+	__m256 pixel = _mm256_add_ps (_mm256_mul_ps (_mm256_loadu_ps (args.pixels + i), cleaningRate), _mm256_mul_ps (_mm256_cvtepi32_ps (count), drawingRate));
+	_mm256_storeu_ps (args.pixels + i, pixel);
+
+	__m256i entry = _mm256_cvttps_epi32 (_mm256_min_ps (_mm256_mul_ps (pixel, tableScale), maxEntry));
+	return _mm256_i32gather_epi32 ((const int *) args.table, entry, 4);
+}
+
+
+// High halves of 16 products of 16 bits, rounded up when the low half plus
+// the dither carries
+inline __m256i roundHigh (__m256i a, __m256i b, __m256i dither)
+{
+	__m256i low = _mm256_mullo_epi16 (a, b);
+	__m256i sum = _mm256_add_epi16 (low, dither);
+	__m256i carry = _mm256_xor_si256 (_mm256_cmpeq_epi16 (_mm256_max_epu16 (sum, low), sum), _mm256_cmpeq_epi16 (low, low));
+	return _mm256_sub_epi16 (_mm256_mulhi_epu16 (a, b), carry);
+}
+
+
+// Fixed-point densities of 16 pixels
+inline __m256i updateFixedPixels (const PixelKernelArgs &args, int i, __m256i cleaningRate, __m256i drawingRate, __m256i drawingFraction, __m256i ditherSteps)
+{
+	__m256i zero = _mm256_setzero_si256 ();
+	__m256i ones = _mm256_cmpeq_epi16 (zero, zero);
+	__m256i *p = (__m256i *) (args.fixedPixels + i);
+	__m256i pixel = _mm256_loadu_si256 (p);
+	__m256i dither = _mm256_add_epi16 (_mm256_set1_epi16 ((unsigned int) i * FIXED_DITHER_STEP + args.fixedDither), ditherSteps);
+
+	// Counts saturated to 16 bits (the pack works within 128-bit lanes)
+	__m256i *c = (__m256i *) (args.counts + i);
+	__m256i count0 = _mm256_loadu_si256 (c);
+	__m256i count1 = _mm256_loadu_si256 (c + 1);
+	_mm256_storeu_si256 (c, zero);
+	_mm256_storeu_si256 (c + 1, zero);
+	__m256i count = _mm256_permute4x64_epi64 (_mm256_packus_epi32 (count0, count1), 0xd8);
+
+	// Dithered fading, decreasing by one at least below the epsilon without particles
+	__m256i faded = roundHigh (pixel, cleaningRate, dither);
+	__m256i small = _mm256_and_si256 (_mm256_cmpeq_epi16 (_mm256_min_epu16 (pixel, _mm256_set1_epi16 (FIXED_FADE_EPSILON - 1)), pixel), _mm256_cmpeq_epi16 (count, zero));
+	faded = _mm256_min_epu16 (faded, _mm256_or_si256 (_mm256_subs_epu16 (pixel, _mm256_set1_epi16 (1)), _mm256_xor_si256 (small, ones)));
+
+	// Saturated count times drawing rate, the fraction dithered
+	__m256i overflow = _mm256_xor_si256 (_mm256_cmpeq_epi16 (_mm256_mulhi_epu16 (count, drawingRate), zero), ones);
+	__m256i drawn = _mm256_or_si256 (_mm256_mullo_epi16 (count, drawingRate), overflow);
+	drawn = _mm256_adds_epu16 (drawn, roundHigh (count, drawingFraction, _mm256_xor_si256 (dither, ones)));
+
+	pixel = _mm256_adds_epu16 (faded, drawn);
+	_mm256_storeu_si256 (p, pixel);
+	return pixel;
+}
+
+
+// Packed colors of 16 pixels, stored as they are in 4 channels, or as
+// 4 x 12 bytes stored as 3 x 16 bytes in 3 channels
+inline void storeColors (const PixelKernelArgs &args, int i, __m256i c01, __m256i c23)
+{
+	unsigned char *frame = args.frame + (i - args.first) * args.frameChannels;
+	if (args.frameChannels == 4) {
+		_mm256_storeu_si256 ((__m256i *) frame, c01);
+		_mm256_storeu_si256 ((__m256i *) frame + 1, c23);
+		return;
+	}
+
+	// Drops the fourth byte of each packed colour: 4 pixels per lane give 12 bytes
+	__m256i pack = _mm256_setr_epi8 (0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1, 0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+	c01 = _mm256_shuffle_epi8 (c01, pack);
+	c23 = _mm256_shuffle_epi8 (c23, pack);
+	__m128i c0 = _mm256_castsi256_si128 (c01);
+	__m128i c1 = _mm256_extracti128_si256 (c01, 1);
+	__m128i c2 = _mm256_castsi256_si128 (c23);
+	__m128i c3 = _mm256_extracti128_si256 (c23, 1);
+
+	__m128i *p = (__m128i *) frame;
+	_mm_storeu_si128 (p, _mm_or_si128 (c0, _mm_slli_si128 (c1, 12)));
+	_mm_storeu_si128 (p + 1, _mm_or_si128 (_mm_srli_si128 (c1, 4), _mm_slli_si128 (c2, 8)));
+	_mm_storeu_si128 (p + 2, _mm_or_si128 (_mm_srli_si128 (c2, 8), _mm_slli_si128 (c3, 4)));
+}
+
+}
+
+
+void convertPixelsAVX2 (const PixelKernelArgs &args)
+{
+	__m256 cleaningRate = _mm256_set1_ps (args.cleaningRate);
+	__m256 drawingRate = _mm256_set1_ps (args.drawingRate);
+	__m256 tableScale = _mm256_set1_ps (args.tableScale);
+	__m256 maxEntry = _mm256_set1_ps (COLOR_TABLE_SIZE - 1);
+
+	int i = args.first;
+	for (; i + 16 <= args.last; i += 16)
+	{
+		__m256i c01 = updatePixels (args, i, cleaningRate, drawingRate, tableScale, maxEntry);
+		__m256i c23 = updatePixels (args, i+8, cleaningRate, drawingRate, tableScale, maxEntry);
+		storeColors (args, i, c01, c23);
+	}
+
+	convertPixelsScalar (args, i, args.last);
+}
+
+
+void convertFixedPixelsAVX2 (const PixelKernelArgs &args)
+{
+	__m256i cleaningRate = _mm256_set1_epi16 (args.fixedCleaningRate);
+	__m256i drawingRate = _mm256_set1_epi16 (args.fixedDrawingRate);
+	__m256i drawingFraction = _mm256_set1_epi16 (args.fixedDrawingFraction);
+	__m256i ditherSteps = _mm256_mullo_epi16 (_mm256_setr_epi16 (0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15), _mm256_set1_epi16 (FIXED_DITHER_STEP));
+
+	int i = args.first;
+	for (; i + 16 <= args.last; i += 16)
+	{
+		__m256i entry = _mm256_srli_epi16 (updateFixedPixels (args, i, cleaningRate, drawingRate, drawingFraction, ditherSteps), FIXED_TABLE_SHIFT);
+		__m256i c01 = _mm256_i32gather_epi32 ((const int *) args.table, _mm256_cvtepu16_epi32 (_mm256_castsi256_si128 (entry)), 4);
+		__m256i c23 = _mm256_i32gather_epi32 ((const int *) args.table, _mm256_cvtepu16_epi32 (_mm256_extracti128_si256 (entry, 1)), 4);
+		storeColors (args, i, c01, c23);
+	}
+
+	convertFixedPixelsScalar (args, i, args.last);
+}
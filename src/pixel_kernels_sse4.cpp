@@ -0,0 +1,184 @@
+/*
+ * This file is part of Moving Cells.
+ *
+ * Moving Cells is is a digital installation building on a depth sensor to
+ * allow spectators to interact with a cloud of particles through their movements.
+ * It has been developed and first displayed in June 2015 by Robin Lamarche-Perrin
+ * and Bruno Pace for the eponymous dance festival, in Leipzig.
+ * See: http://www.movingcells.org
+ * 
+ * The current version of the program is implemented on Kinect for Windows v2 (K4W2)
+ * through the open source driver libreenect2.
+ * See: https://github.com/OpenKinect/libfreenect2
+ * 
+ * Copyright © 2015-2017 Robin Lamarche-Perrin and Bruno Pace
+ * (<Robin.Lamarche-Perrin@lip6.fr>)
+ * 
+ * Moving Cells is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ * 
+ * Moving Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// SSE4.1 PIXEL KERNEL (16 pixels per iteration)
+// Compiled with -msse4.1, only called when the processor supports it.
+
+#include <smmintrin.h>
+
+#include "pixel_kernels.hpp"
+
+
+namespace {
+
+// Table colors of 4 entries
+inline __m128i lookColors (const uint32_t *table, __m128i entry)
+{
+	return _mm_set_epi32 (table[_mm_extract_epi32 (entry, 3)], table[_mm_extract_epi32 (entry, 2)], table[_mm_extract_epi32 (entry, 1)], table[_mm_extract_epi32 (entry, 0)]);
+}
+
+
+// Densities and colors of 4 pixels, counts reset to zero
+inline __m128i updatePixels (const PixelKernelArgs &args, int i, __m128 cleaningRate, __m128 drawingRate, __m128 tableScale, __m128 maxEntry)
+{
+	__m128i *c = (__m128i *) (args.counts + i);
+	__m128i count = _mm_loadu_si128 (c);
+	_mm_storeu_si128 (c, _mm_setzero_si128 ());
+
+	__m128 pixel = _mm_add_ps (_mm_mul_ps (_mm_loadu_ps (args.pixels + i), cleaningRate), _mm_mul_ps (_mm_cvtepi32_ps (count), drawingRate));
+	_mm_storeu_ps (args.pixels + i, pixel);
+
+	__m128i entry = _mm_cvttps_epi32 (_mm_min_ps (_mm_mul_ps (pixel, tableScale), maxEntry));
+	return lookColors (args.table, entry);
+}
+
+
+// Counts of 8 pixels, saturated to 16 bits, counts reset to zero
+inline __m128i loadCounts (const PixelKernelArgs &args, int i)
+{
+	__m128i *c = (__m128i *) (args.counts + i);
+	__m128i count0 = _mm_loadu_si128 (c);
+	__m128i count1 = _mm_loadu_si128 (c + 1);
+	_mm_storeu_si128 (c, _mm_setzero_si128 ());
+	_mm_storeu_si128 (c + 1, _mm_setzero_si128 ());
+	return _mm_packus_epi32 (count0, count1);
+}
+
+
+// High halves of 8 products of 16 bits, rounded up when the low half plus
+// the dither carries
+inline __m128i roundHigh (__m128i a, __m128i b, __m128i dither)
+{
+	__m128i low = _mm_mullo_epi16 (a, b);
+	__m128i sum = _mm_add_epi16 (low, dither);
+	__m128i carry = _mm_xor_si128 (_mm_cmpeq_epi16 (_mm_max_epu16 (sum, low), sum), _mm_cmpeq_epi16 (low, low));
+	return _mm_sub_epi16 (_mm_mulhi_epu16 (a, b), carry);
+}
+
+
+// Fixed-point densities of 8 pixels
+inline __m128i updateFixedPixels (const PixelKernelArgs &args, int i, __m128i cleaningRate, __m128i drawingRate, __m128i drawingFraction, __m128i ditherSteps)
+{
+	__m128i zero = _mm_setzero_si128 ();
+	__m128i ones = _mm_cmpeq_epi16 (zero, zero);
+	__m128i *p = (__m128i *) (args.fixedPixels + i);
+	__m128i pixel = _mm_loadu_si128 (p);
+	__m128i dither = _mm_add_epi16 (_mm_set1_epi16 ((unsigned int) i * FIXED_DITHER_STEP + args.fixedDither), ditherSteps);
+
+	__m128i count = loadCounts (args, i);
+
+	// Dithered fading, decreasing by one at least below the epsilon without particles
+	__m128i faded = roundHigh (pixel, cleaningRate, dither);
+	__m128i small = _mm_and_si128 (_mm_cmpeq_epi16 (_mm_min_epu16 (pixel, _mm_set1_epi16 (FIXED_FADE_EPSILON - 1)), pixel), _mm_cmpeq_epi16 (count, zero));
+	faded = _mm_min_epu16 (faded, _mm_or_si128 (_mm_subs_epu16 (pixel, _mm_set1_epi16 (1)), _mm_xor_si128 (small, ones)));
+
+	// Saturated count times drawing rate, the fraction dithered
+	__m128i overflow = _mm_xor_si128 (_mm_cmpeq_epi16 (_mm_mulhi_epu16 (count, drawingRate), zero), ones);
+	__m128i drawn = _mm_or_si128 (_mm_mullo_epi16 (count, drawingRate), overflow);
+	drawn = _mm_adds_epu16 (drawn, roundHigh (count, drawingFraction, _mm_xor_si128 (dither, ones)));
+
+	pixel = _mm_adds_epu16 (faded, drawn);
+	_mm_storeu_si128 (p, pixel);
+	return pixel;
+}
+
+
+// Packed colors of 16 pixels, stored as they are in 4 channels, or as 3 x 16
+// bytes in 3 channels
+inline void storeColors (const PixelKernelArgs &args, int i, __m128i c0, __m128i c1, __m128i c2, __m128i c3)
+{
+	__m128i *p = (__m128i *) (args.frame + (i - args.first) * args.frameChannels);
+	if (args.frameChannels == 4) {
+		_mm_storeu_si128 (p, c0);
+		_mm_storeu_si128 (p + 1, c1);
+		_mm_storeu_si128 (p + 2, c2);
+		_mm_storeu_si128 (p + 3, c3);
+		return;
+	}
+
+	// Drops the fourth byte of each packed colour: 4 pixels give 12 bytes
+	__m128i pack = _mm_setr_epi8 (0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+	c0 = _mm_shuffle_epi8 (c0, pack);
+	c1 = _mm_shuffle_epi8 (c1, pack);
+	c2 = _mm_shuffle_epi8 (c2, pack);
+	c3 = _mm_shuffle_epi8 (c3, pack);
+
+	_mm_storeu_si128 (p, _mm_or_si128 (c0, _mm_slli_si128 (c1, 12)));
+	_mm_storeu_si128 (p + 1, _mm_or_si128 (_mm_srli_si128 (c1, 4), _mm_slli_si128 (c2, 8)));
+	_mm_storeu_si128 (p + 2, _mm_or_si128 (_mm_srli_si128 (c2, 8), _mm_slli_si128 (c3, 4)));
+}
+
+}
+
+
+void convertPixelsSSE4 (const PixelKernelArgs &args)
+{
+	__m128 cleaningRate = _mm_set1_ps (args.cleaningRate);
+	__m128 drawingRate = _mm_set1_ps (args.drawingRate);
+	__m128 tableScale = _mm_set1_ps (args.tableScale);
+	__m128 maxEntry = _mm_set1_ps (COLOR_TABLE_SIZE - 1);
+
+	int i = args.first;
+	for (; i + 16 <= args.last; i += 16)
+	{
+		__m128i c0 = updatePixels (args, i, cleaningRate, drawingRate, tableScale, maxEntry);
+		__m128i c1 = updatePixels (args, i+4, cleaningRate, drawingRate, tableScale, maxEntry);
+		__m128i c2 = updatePixels (args, i+8, cleaningRate, drawingRate, tableScale, maxEntry);
+		__m128i c3 = updatePixels (args, i+12, cleaningRate, drawingRate, tableScale, maxEntry);
+		storeColors (args, i, c0, c1, c2, c3);
+	}
+
+	convertPixelsScalar (args, i, args.last);
+}
+
+
+void convertFixedPixelsSSE4 (const PixelKernelArgs &args)
+{
+	__m128i cleaningRate = _mm_set1_epi16 (args.fixedCleaningRate);
+	__m128i drawingRate = _mm_set1_epi16 (args.fixedDrawingRate);
+	__m128i drawingFraction = _mm_set1_epi16 (args.fixedDrawingFraction);
+	__m128i ditherSteps = _mm_mullo_epi16 (_mm_setr_epi16 (0, 1, 2, 3, 4, 5, 6, 7), _mm_set1_epi16 (FIXED_DITHER_STEP));
+
+	int i = args.first;
+	for (; i + 16 <= args.last; i += 16)
+	{
+		__m128i entry0 = _mm_srli_epi16 (updateFixedPixels (args, i, cleaningRate, drawingRate, drawingFraction, ditherSteps), FIXED_TABLE_SHIFT);
+		__m128i entry1 = _mm_srli_epi16 (updateFixedPixels (args, i+8, cleaningRate, drawingRate, drawingFraction, ditherSteps), FIXED_TABLE_SHIFT);
+
+		__m128i c0 = lookColors (args.table, _mm_cvtepu16_epi32 (entry0));
+		__m128i c1 = lookColors (args.table, _mm_cvtepu16_epi32 (_mm_srli_si128 (entry0, 8)));
+		__m128i c2 = lookColors (args.table, _mm_cvtepu16_epi32 (entry1));
+		__m128i c3 = lookColors (args.table, _mm_cvtepu16_epi32 (_mm_srli_si128 (entry1, 8)));
+		storeColors (args, i, c0, c1, c2, c3);
+	}
+
+	convertFixedPixelsScalar (args, i, args.last);
+}
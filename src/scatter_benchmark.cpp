@@ -0,0 +1,250 @@
+/*
+ * This file is part of Moving Cells.
+ *
+ * Moving Cells is is a digital installation building on a depth sensor to
+ * allow spectators to interact with a cloud of particles through their movements.
+ * It has been developed and first displayed in June 2015 by Robin Lamarche-Perrin
+ * and Bruno Pace for the eponymous dance festival, in Leipzig.
+ * See: http://www.movingcells.org
+ * 
+ * The current version of the program is implemented on Kinect for Windows v2 (K4W2)
+ * through the open source driver libreenect2.
+ * See: https://github.com/OpenKinect/libfreenect2
+ * 
+ * Copyright © 2015-2017 Robin Lamarche-Perrin and Bruno Pace
+ * (<Robin.Lamarche-Perrin@lip6.fr>)
+ * 
+ * Moving Cells is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ * 
+ * Moving Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// SCATTER BENCHMARK
+//
+// Measures the cost of counting particles into a density buffer as the
+// resolution grows, with the direct scatter of Cloud (one count buffer per
+// worker, merged afterwards) and with tile binning (particles sorted by
+// screen tile, then counted tile by tile in a single buffer).
+// Particles are spread uniformly, in random order, one for nine pixels.
+// Times are per frame, for the whole pass (scatter and merge into the final
+// density) and for the scatter part alone.
+//
+// Usage: scatter-benchmark [threadNumber] [frameNumber]
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include <sys/time.h>
+
+#include "worker_pool.hpp"
+#include "tile_bins.hpp"
+
+
+struct Resolution { const char *name; int width; int height; };
+
+const Resolution resolutions[] = {
+	{ "1080p", 1920, 1080 },
+	{ "1440p", 2560, 1440 },
+	{ "4K",    3840, 2160 },
+	{ "5K",    5120, 2880 },
+	{ "8K",    7680, 4320 }
+};
+
+
+class ScatterBenchmark
+{
+public:
+	int width, height, pixelNumber, particleNumber;
+	int threadNumber;
+	WorkerPool *workers;
+
+	std::vector<int> particleX, particleY;
+	std::vector<int> particlePixels, particleTiles;
+	std::vector<unsigned int*> pixelCounts;
+	std::vector<unsigned int> pixels;
+	TileBins tileBins;
+
+	ScatterBenchmark (WorkerPool *vWorkers, int vThreadNumber, int vWidth, int vHeight);
+	~ScatterBenchmark ();
+
+	int getFirst (int number, int id) { return (long) number * id / threadNumber; }
+	int getLast (int number, int id) { return (long) number * (id + 1) / threadNumber; }
+
+	static void scatter (void *arg, int id);
+	static void merge (void *arg, int id);
+	static void count (void *arg, int id);
+	static void bin (void *arg, int id);
+	static void accumulate (void *arg, int id);
+	static void mergeOne (void *arg, int id);
+};
+
+
+ScatterBenchmark::ScatterBenchmark (WorkerPool *vWorkers, int vThreadNumber, int vWidth, int vHeight)
+	: width (vWidth), height (vHeight), threadNumber (vThreadNumber), workers (vWorkers)
+{
+	pixelNumber = width * height;
+	particleNumber = pixelNumber / 9;
+
+	std::mt19937 generator (0);
+	std::uniform_int_distribution<int> randomX (0, width - 1);
+	std::uniform_int_distribution<int> randomY (0, height - 1);
+	particleX.resize (particleNumber);
+	particleY.resize (particleNumber);
+	for (int i = 0; i < particleNumber; i++) { particleX[i] = randomX (generator); particleY[i] = randomY (generator); }
+
+	particlePixels.resize (particleNumber);
+	particleTiles.resize (particleNumber);
+	pixelCounts.resize (threadNumber);
+	for (int i = 0; i < threadNumber; i++) { pixelCounts[i] = new unsigned int [pixelNumber] (); }
+	pixels.resize (pixelNumber);
+	tileBins.setup (width, height, sizeof (unsigned int), threadNumber, particleNumber);
+}
+
+
+ScatterBenchmark::~ScatterBenchmark ()
+{
+	for (int i = 0; i < threadNumber; i++) { delete [] pixelCounts[i]; }
+}
+
+
+// Direct scatter: each worker counts its particles in its own buffer
+void ScatterBenchmark::scatter (void *arg, int id)
+{
+	ScatterBenchmark *b = reinterpret_cast<ScatterBenchmark*>(arg);
+	unsigned int *counts = b->pixelCounts[id];
+	for (int i = b->getFirst (b->particleNumber, id); i < b->getLast (b->particleNumber, id); i++) {
+		counts[b->particleX[i] + b->particleY[i] * b->width]++;
+	}
+}
+
+void ScatterBenchmark::merge (void *arg, int id)
+{
+	ScatterBenchmark *b = reinterpret_cast<ScatterBenchmark*>(arg);
+	for (int i = b->getFirst (b->pixelNumber, id); i < b->getLast (b->pixelNumber, id); i++) {
+		unsigned int count = 0;
+		for (int t = 0; t < b->threadNumber; t++) { count += b->pixelCounts[t][i]; b->pixelCounts[t][i] = 0; }
+		b->pixels[i] = count;
+	}
+}
+
+
+// Tile binning: count per tile, sort by tile, then count tile by tile in one buffer
+void ScatterBenchmark::count (void *arg, int id)
+{
+	ScatterBenchmark *b = reinterpret_cast<ScatterBenchmark*>(arg);
+	b->tileBins.clear (id);
+	for (int i = b->getFirst (b->particleNumber, id); i < b->getLast (b->particleNumber, id); i++) {
+		int tile = b->tileBins.grid.getTile (b->particleX[i], b->particleY[i]);
+		b->particlePixels[i] = b->particleX[i] + b->particleY[i] * b->width;
+		b->particleTiles[i] = tile;
+		b->tileBins.count (id, tile);
+	}
+}
+
+void ScatterBenchmark::bin (void *arg, int id)
+{
+	ScatterBenchmark *b = reinterpret_cast<ScatterBenchmark*>(arg);
+	for (int i = b->getFirst (b->particleNumber, id); i < b->getLast (b->particleNumber, id); i++) {
+		b->tileBins.insert (id, b->particleTiles[i], b->particlePixels[i]);
+	}
+}
+
+void ScatterBenchmark::accumulate (void *arg, int id)
+{
+	ScatterBenchmark *b = reinterpret_cast<ScatterBenchmark*>(arg);
+	unsigned int *counts = b->pixelCounts[0];
+	const int *entries = b->tileBins.entries.data();
+	for (int tile = id; tile < b->tileBins.grid.tileNumber; tile += b->threadNumber) {
+		int last = b->tileBins.getLastEntry (tile);
+		for (int k = b->tileBins.getFirstEntry (tile); k < last; k++) { counts[entries[k]]++; }
+	}
+}
+
+void ScatterBenchmark::mergeOne (void *arg, int id)
+{
+	ScatterBenchmark *b = reinterpret_cast<ScatterBenchmark*>(arg);
+	unsigned int *counts = b->pixelCounts[0];
+	for (int i = b->getFirst (b->pixelNumber, id); i < b->getLast (b->pixelNumber, id); i++) { b->pixels[i] = counts[i]; counts[i] = 0; }
+}
+
+
+double getTime ()
+{
+	struct timeval timer;
+	gettimeofday (&timer, NULL);
+	return timer.tv_sec + timer.tv_usec / 1e6;
+}
+
+
+int main (int argc, char *argv[])
+{
+	int threadNumber = (argc > 1) ? atoi (argv[1]) : 0;
+	int frameNumber = (argc > 2) ? atoi (argv[2]) : 20;
+	if (threadNumber <= 0) { threadNumber = WorkerPool::getProcessorNumber(); }
+	if (frameNumber <= 0) { frameNumber = 1; }
+
+	WorkerPool workers;
+	workers.start (threadNumber);
+
+	std::cout << "SCATTER BENCHMARK: " << threadNumber << " threads, " << frameNumber << " frames, L2 cache " << TileGrid::getCacheSize() / 1024 << " KB" << std::endl;
+	std::cout << std::setw (6) << "res" << std::setw (10) << "particles" << std::setw (8) << "tiles"
+			  << std::setw (14) << "direct ms" << std::setw (14) << "of scatter" << std::setw (14) << "binned ms" << std::setw (14) << "of scatter"
+			  << std::setw (16) << "direct ns/part" << std::setw (16) << "binned ns/part" << std::endl;
+
+	for (unsigned int r = 0; r < sizeof (resolutions) / sizeof (Resolution); r++) {
+		ScatterBenchmark benchmark (&workers, threadNumber, resolutions[r].width, resolutions[r].height);
+
+		double directScatter = 0, directTotal = 0;
+		double binnedScatter = 0, binnedTotal = 0;
+		unsigned long directSum = 0, binnedSum = 0;
+
+		for (int frame = 0; frame <= frameNumber; frame++) {
+			double t0 = getTime ();
+			workers.run (&ScatterBenchmark::scatter, &benchmark);
+			double t1 = getTime ();
+			workers.run (&ScatterBenchmark::merge, &benchmark);
+			double t2 = getTime ();
+			if (frame == 0) { for (int i = 0; i < benchmark.pixelNumber; i++) { directSum += benchmark.pixels[i] * (unsigned long) i; } }
+
+			workers.run (&ScatterBenchmark::count, &benchmark);
+			benchmark.tileBins.computeOffsets ();
+			workers.run (&ScatterBenchmark::bin, &benchmark);
+			workers.run (&ScatterBenchmark::accumulate, &benchmark);
+			double t3 = getTime ();
+			workers.run (&ScatterBenchmark::mergeOne, &benchmark);
+			double t4 = getTime ();
+			if (frame == 0) { for (int i = 0; i < benchmark.pixelNumber; i++) { binnedSum += benchmark.pixels[i] * (unsigned long) i; } }
+
+			// The first frame only warms up the caches
+			if (frame == 0) continue;
+			directScatter += t1 - t0;
+			directTotal += t2 - t0;
+			binnedScatter += t3 - t2;
+			binnedTotal += t4 - t2;
+		}
+
+		if (directSum != binnedSum) { std::cerr << "Error: binned density differs from direct density" << std::endl; exit (-1); }
+
+		double particles = (double) benchmark.particleNumber * frameNumber;
+		std::cout << std::fixed << std::setprecision (2)
+				  << std::setw (6) << resolutions[r].name << std::setw (10) << benchmark.particleNumber << std::setw (8) << benchmark.tileBins.grid.tileNumber
+				  << std::setw (14) << directTotal * 1000 / frameNumber << std::setw (14) << directScatter * 1000 / frameNumber
+				  << std::setw (14) << binnedTotal * 1000 / frameNumber << std::setw (14) << binnedScatter * 1000 / frameNumber
+				  << std::setw (16) << directScatter * 1e9 / particles << std::setw (16) << binnedScatter * 1e9 / particles << std::endl;
+	}
+
+	workers.stop ();
+	return 0;
+}
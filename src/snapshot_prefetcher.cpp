@@ -0,0 +1,181 @@
+/*
+ * This file is part of Moving Cells.
+ *
+ * Moving Cells is is a digital installation building on a depth sensor to
+ * allow spectators to interact with a cloud of particles through their movements.
+ * It has been developed and first displayed in June 2015 by Robin Lamarche-Perrin
+ * and Bruno Pace for the eponymous dance festival, in Leipzig.
+ * See: http://www.movingcells.org
+ * 
+ * The current version of the program is implemented on Kinect for Windows v2 (K4W2)
+ * through the open source driver libreenect2.
+ * See: https://github.com/OpenKinect/libfreenect2
+ * 
+ * Copyright © 2015-2017 Robin Lamarche-Perrin and Bruno Pace
+ * (<Robin.Lamarche-Perrin@lip6.fr>)
+ * 
+ * Moving Cells is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ * 
+ * Moving Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <iostream>
+#include <cstdlib>
+
+#include "snapshot_prefetcher.hpp"
+#include "particle_snapshot.hpp"
+#include "frame_pacer.hpp"
+
+
+void SnapshotPrefetcher::start ()
+{
+	if (running) { return; }
+	stopping = false;
+	int rc = pthread_create (&thread, NULL, &SnapshotPrefetcher::run, (void *) this);
+	if (rc) { std::cout << "Error: Unable to create thread " << rc << std::endl; exit (-1); }
+	running = true;
+}
+
+
+void SnapshotPrefetcher::stop ()
+{
+	if (!running) { return; }
+	pthread_mutex_lock (&mutex);
+	stopping = true;
+	pthread_cond_signal (&requested);
+	pthread_mutex_unlock (&mutex);
+	pthread_join (thread, NULL);
+	running = false;
+	for (int i = 0; i < PREFETCH_SLOT_NUMBER; i++) { slots[i].state = FREE_SLOT; }
+}
+
+
+// The slot being loaded is waited for, its arrays are kept for a next request
+void SnapshotPrefetcher::clear ()
+{
+	pthread_mutex_lock (&mutex);
+	for (int i = 0; i < PREFETCH_SLOT_NUMBER; i++) {
+		while (slots[i].state == LOADING_SLOT) { pthread_cond_wait (&loaded, &mutex); }
+		slots[i].state = FREE_SLOT;
+	}
+	pthread_mutex_unlock (&mutex);
+}
+
+
+bool SnapshotPrefetcher::request (const std::string &filename, int capacity, int particleNumber)
+{
+	start();
+
+	pthread_mutex_lock (&mutex);
+	int index = -1;
+	for (int i = 0; i < PREFETCH_SLOT_NUMBER && index < 0; i++) { if (slots[i].state == FREE_SLOT) { index = i; } }
+	if (index >= 0) {
+		PrefetchSlot &slot = slots[index];
+		slot.filename = filename;
+		slot.capacity = capacity;
+		slot.particleNumber = particleNumber;
+		slot.order = requestNb++;
+		slot.state = REQUESTED_SLOT;
+		pthread_cond_signal (&requested);
+	}
+	pthread_mutex_unlock (&mutex);
+	return index >= 0;
+}
+
+
+// Particles beyond the end of the snapshot keep their state: they are copied
+// into the loaded arrays before the swap
+bool SnapshotPrefetcher::take (const std::string &filename, ParticleArray *particles, int particleNumber)
+{
+	pthread_mutex_lock (&mutex);
+	int index = -1;
+	for (int i = 0; i < PREFETCH_SLOT_NUMBER; i++) {
+		if (slots[i].state != FREE_SLOT && slots[i].filename == filename && (index < 0 || slots[i].order < slots[index].order)) { index = i; }
+	}
+	if (index < 0) { pthread_mutex_unlock (&mutex); return false; }
+
+	PrefetchSlot &slot = slots[index];
+	if (slot.state == REQUESTED_SLOT || slot.state == LOADING_SLOT) {
+		double waitTime = FramePacer::getTime();
+		while (slot.state == REQUESTED_SLOT || slot.state == LOADING_SLOT) { pthread_cond_wait (&loaded, &mutex); }
+		lateNb++;
+		std::cout << "LATE PARTICLE SNAPSHOT: " << filename << " (waited " << (FramePacer::getTime() - waitTime) * 1000 << "ms)" << std::endl;
+	}
+	pthread_mutex_unlock (&mutex);
+
+	bool ready = (slot.state == READY_SLOT);
+	if (ready) {
+		int number = std::min (slot.loadedNumber, particleNumber);
+		if (slot.particles.number == particles->number) {
+			size_t size = (size_t) std::max (particleNumber - number, 0) * sizeof (float);
+			memcpy (slot.particles.x + number, particles->x + number, size);
+			memcpy (slot.particles.y + number, particles->y + number, size);
+			memcpy (slot.particles.dx + number, particles->dx + number, size);
+			memcpy (slot.particles.dy + number, particles->dy + number, size);
+			particles->swap (slot.particles);
+		}
+		else {
+			// The cloud was resized since the request: copy instead
+			size_t size = (size_t) number * sizeof (float);
+			memcpy (particles->x, slot.particles.x, size);
+			memcpy (particles->y, slot.particles.y, size);
+			memcpy (particles->dx, slot.particles.dx, size);
+			memcpy (particles->dy, slot.particles.dy, size);
+		}
+	}
+
+	pthread_mutex_lock (&mutex);
+	slot.state = FREE_SLOT;
+	pthread_mutex_unlock (&mutex);
+	return ready;
+}
+
+
+void *SnapshotPrefetcher::run (void *prefetcher)
+{
+	reinterpret_cast<SnapshotPrefetcher*>(prefetcher)->run();
+	pthread_exit (NULL);
+}
+
+
+void SnapshotPrefetcher::run ()
+{
+	pthread_mutex_lock (&mutex);
+	while (true)
+	{
+		int index = -1;
+		while (!stopping) {
+			for (int i = 0; i < PREFETCH_SLOT_NUMBER; i++) {
+				if (slots[i].state == REQUESTED_SLOT && (index < 0 || slots[i].order < slots[index].order)) { index = i; }
+			}
+			if (index >= 0) { break; }
+			pthread_cond_wait (&requested, &mutex);
+		}
+		if (index < 0) { break; }
+
+		PrefetchSlot &slot = slots[index];
+		slot.state = LOADING_SLOT;
+		pthread_mutex_unlock (&mutex);
+
+		// Allocating and filling the arrays here also faults their pages in
+		if (slot.particles.number != slot.capacity) { slot.particles.allocate (slot.capacity); }
+		float *arrays[] = { slot.particles.x, slot.particles.y, slot.particles.dx, slot.particles.dy };
+		int number = ParticleSnapshot::load (slot.filename, arrays, 4, 1, slot.particleNumber);
+
+		pthread_mutex_lock (&mutex);
+		slot.loadedNumber = number;
+		slot.state = (number < 0) ? FAILED_SLOT : READY_SLOT;
+		pthread_cond_broadcast (&loaded);
+	}
+	pthread_mutex_unlock (&mutex);
+}
@@ -0,0 +1,96 @@
+/*
+ * This file is part of Moving Cells.
+ *
+ * Moving Cells is is a digital installation building on a depth sensor to
+ * allow spectators to interact with a cloud of particles through their movements.
+ * It has been developed and first displayed in June 2015 by Robin Lamarche-Perrin
+ * and Bruno Pace for the eponymous dance festival, in Leipzig.
+ * See: http://www.movingcells.org
+ * 
+ * The current version of the program is implemented on Kinect for Windows v2 (K4W2)
+ * through the open source driver libreenect2.
+ * See: https://github.com/OpenKinect/libfreenect2
+ * 
+ * Copyright © 2015-2017 Robin Lamarche-Perrin and Bruno Pace
+ * (<Robin.Lamarche-Perrin@lip6.fr>)
+ * 
+ * Moving Cells is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ * 
+ * Moving Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef SNAPSHOT_PREFETCHER_HPP
+#define SNAPSHOT_PREFETCHER_HPP
+
+#include <string>
+#include <pthread.h>
+
+#include "particle_array.hpp"
+
+
+#define PREFETCH_SLOT_NUMBER      2
+#define PREFETCH_LOOKAHEAD        30.       // seconds before its timestamp a snapshot may be loaded
+
+#define FREE_SLOT                 0
+#define REQUESTED_SLOT            1
+#define LOADING_SLOT              2
+#define READY_SLOT                3
+#define FAILED_SLOT               4
+
+
+// SNAPSHOT PREFETCHER
+//
+// Loads the snapshots that a parameter sequence is about to use on a
+// background thread, into spare particle arrays. When the sequence reaches
+// the snapshot, take swaps these arrays with the ones of the cloud, so that
+// the frame never waits for the file. A snapshot that is still loading at
+// that time is waited for, and reported as late.
+
+struct PrefetchSlot
+{
+	int state = FREE_SLOT;
+	std::string filename;
+	ParticleArray particles;
+	int capacity;                             // size of the arrays to swap with
+	int particleNumber;                       // particles to load
+	int loadedNumber;                         // particles in the file, at most particleNumber
+	long order;                               // slots are loaded and taken in the order of the requests
+};
+
+
+class SnapshotPrefetcher
+{
+public:
+	PrefetchSlot slots[PREFETCH_SLOT_NUMBER];
+	long requestNb = 0;
+	int lateNb = 0;
+
+	bool running = false;
+	bool stopping = false;
+	pthread_t thread;
+	pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+	pthread_cond_t requested = PTHREAD_COND_INITIALIZER;
+	pthread_cond_t loaded = PTHREAD_COND_INITIALIZER;
+
+	void start ();
+	void stop ();
+	void clear ();                            // forgets all the requests
+	bool request (const std::string &filename, int capacity, int particleNumber);   // false if no slot is free
+	bool take (const std::string &filename, ParticleArray *particles, int particleNumber);   // false if it was not requested or could not be loaded
+
+	static void *run (void *prefetcher);
+	void run ();
+};
+
+
+#endif
@@ -37,6 +37,10 @@ int main (int argc, char *argv[])
 	srand (time (NULL));
 
 	Cloud *cloud = new Cloud ();
+	if (argc > 1 && std::string (argv[1]) == "--check-physics") { return cloud->checkPhysics () ? 0 : 1; }
+	if (argc > 1 && std::string (argv[1]) == "--check-fading") { return cloud->checkFading () ? 0 : 1; }
+	if (argc > 1 && std::string (argv[1]) == "--resume") { cloud->warmRestart = true; }
+	if (argc > 2 && std::string (argv[1]) == "--start") { cloud->sequenceStartTime = atof (argv[2]); }
 	cloud->init();
 
 	pthread_t cloudThread;
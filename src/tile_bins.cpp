@@ -0,0 +1,113 @@
+/*
+ * This file is part of Moving Cells.
+ *
+ * Moving Cells is is a digital installation building on a depth sensor to
+ * allow spectators to interact with a cloud of particles through their movements.
+ * It has been developed and first displayed in June 2015 by Robin Lamarche-Perrin
+ * and Bruno Pace for the eponymous dance festival, in Leipzig.
+ * See: http://www.movingcells.org
+ * 
+ * The current version of the program is implemented on Kinect for Windows v2 (K4W2)
+ * through the open source driver libreenect2.
+ * See: https://github.com/OpenKinect/libfreenect2
+ * 
+ * Copyright © 2015-2017 Robin Lamarche-Perrin and Bruno Pace
+ * (<Robin.Lamarche-Perrin@lip6.fr>)
+ * 
+ * Moving Cells is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ * 
+ * Moving Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+// LIBRARIES
+
+#include <unistd.h>
+
+#include "tile_bins.hpp"
+
+
+// TILE GRID
+
+int TileGrid::getCacheSize ()
+{
+#ifdef _SC_LEVEL2_CACHE_SIZE
+	long size = sysconf (_SC_LEVEL2_CACHE_SIZE);
+	if (size > 0) { return size; }
+#endif
+	return DEFAULT_L2_CACHE_SIZE;
+}
+
+
+void TileGrid::setup (int vWidth, int vHeight, int bytesPerPixel, bool rowBands)
+{
+	int widthShift = TILE_WIDTH_SHIFT;
+	if (rowBands) { while ((1 << widthShift) < vWidth) { widthShift++; } }
+
+	int heightShift = 0;
+	while ((2 << heightShift) * (1 << widthShift) * bytesPerPixel <= getCacheSize () / 2) { heightShift++; }
+
+	setup (vWidth, vHeight, widthShift, heightShift);
+}
+
+
+void TileGrid::setup (int vWidth, int vHeight, int vTileWidthShift, int vTileHeightShift)
+{
+	width = vWidth;
+	height = vHeight;
+
+	tileWidthShift = vTileWidthShift;
+	tileHeightShift = vTileHeightShift;
+	tileWidth = 1 << tileWidthShift;
+	tileHeight = 1 << tileHeightShift;
+
+	columnNumber = (width + tileWidth - 1) / tileWidth;
+	rowNumber = (height + tileHeight - 1) / tileHeight;
+	tileNumber = columnNumber * rowNumber;
+}
+
+
+// TILE BINS
+
+void TileBins::setup (int width, int height, int bytesPerPixel, int vWorkerNumber, int capacity, bool rowBands)
+{
+	grid.setup (width, height, bytesPerPixel, rowBands);
+	workerNumber = vWorkerNumber;
+
+	tileCounts.assign (workerNumber * grid.tileNumber, 0);
+	tileOffsets.assign (grid.tileNumber + 1, 0);
+	entries.resize (capacity);
+}
+
+
+void TileBins::clear (int worker)
+{
+	int *counts = tileCounts.data() + worker * grid.tileNumber;
+	for (int tile = 0; tile < grid.tileNumber; tile++) { counts[tile] = 0; }
+}
+
+
+void TileBins::computeOffsets ()
+{
+	int offset = 0;
+	for (int tile = 0; tile < grid.tileNumber; tile++) {
+		tileOffsets[tile] = offset;
+		for (int worker = 0; worker < workerNumber; worker++) {
+			int &count = tileCounts[worker * grid.tileNumber + tile];
+			int number = count;
+			count = offset;
+			offset += number;
+		}
+	}
+	tileOffsets[grid.tileNumber] = offset;
+}
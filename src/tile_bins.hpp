@@ -0,0 +1,110 @@
+/*
+ * This file is part of Moving Cells.
+ *
+ * Moving Cells is is a digital installation building on a depth sensor to
+ * allow spectators to interact with a cloud of particles through their movements.
+ * It has been developed and first displayed in June 2015 by Robin Lamarche-Perrin
+ * and Bruno Pace for the eponymous dance festival, in Leipzig.
+ * See: http://www.movingcells.org
+ * 
+ * The current version of the program is implemented on Kinect for Windows v2 (K4W2)
+ * through the open source driver libreenect2.
+ * See: https://github.com/OpenKinect/libfreenect2
+ * 
+ * Copyright © 2015-2017 Robin Lamarche-Perrin and Bruno Pace
+ * (<Robin.Lamarche-Perrin@lip6.fr>)
+ * 
+ * Moving Cells is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ * 
+ * Moving Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef TILE_BINS_HPP
+#define TILE_BINS_HPP
+
+#include <vector>
+
+
+#define DEFAULT_L2_CACHE_SIZE     262144
+#define TILE_WIDTH_SHIFT          8         // tiles are 256 pixels wide
+
+
+// TILE GRID
+//
+// Splits the screen into rectangular tiles whose density values fit in half
+// of the L2 cache. Tile dimensions are powers of two, so that the tile of a
+// pixel is found with shifts. With rowBands, tiles span the whole width of
+// the screen, so that each tile is a contiguous range of pixels. Tiles can
+// also be given fixed dimensions.
+
+struct TileGrid
+{
+public:
+	int width = 0;
+	int height = 0;
+	int tileWidthShift = 0;
+	int tileHeightShift = 0;
+	int tileWidth = 0;
+	int tileHeight = 0;
+	int columnNumber = 0;
+	int rowNumber = 0;
+	int tileNumber = 0;
+
+	void setup (int vWidth, int vHeight, int bytesPerPixel, bool rowBands = false);
+	void setup (int vWidth, int vHeight, int vTileWidthShift, int vTileHeightShift);
+
+	int getTile (int x, int y) const { return (y >> tileHeightShift) * columnNumber + (x >> tileWidthShift); }
+	int getFirstX (int tile) const { return (tile % columnNumber) << tileWidthShift; }
+	int getFirstY (int tile) const { return (tile / columnNumber) << tileHeightShift; }
+	int getLastX (int tile) const { int x = getFirstX (tile) + tileWidth; return x < width ? x : width; }
+	int getLastY (int tile) const { int y = getFirstY (tile) + tileHeight; return y < height ? y : height; }
+
+	static int getCacheSize ();
+};
+
+
+// TILE BINS
+//
+// Counting sort of pixel indices by tile, done in parallel by the workers
+// of a WorkerPool:
+//   1. each worker clears its counters, then calls count() for each of its
+//      items;
+//   2. one thread calls computeOffsets();
+//   3. each worker calls insert() for the same items, in the same order.
+// The entries of a tile then lie in [getFirstEntry (tile), getLastEntry (tile)),
+// ordered by worker then by insertion, so that the result is deterministic.
+// Tiles can then be processed independently, one worker per tile.
+
+class TileBins
+{
+public:
+	TileGrid grid;
+	int workerNumber = 0;
+
+	std::vector<int> tileCounts;     // per worker and tile, then write positions
+	std::vector<int> tileOffsets;    // first entry of each tile, plus the total
+	std::vector<int> entries;
+
+	void setup (int width, int height, int bytesPerPixel, int vWorkerNumber, int capacity, bool rowBands = false);
+
+	void clear (int worker);
+	void count (int worker, int tile) { tileCounts[worker * grid.tileNumber + tile]++; }
+	void computeOffsets ();
+	void insert (int worker, int tile, int entry) { entries[tileCounts[worker * grid.tileNumber + tile]++] = entry; }
+
+	int getFirstEntry (int tile) const { return tileOffsets[tile]; }
+	int getLastEntry (int tile) const { return tileOffsets[tile + 1]; }
+};
+
+
+#endif
@@ -37,6 +37,9 @@
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 
+#include "frame_pacer.hpp"
+#include "bezel_crop.hpp"
+
 int camId = 0;
 unsigned int maxDelay = 150;
 unsigned int initDelay = 1;
@@ -61,9 +64,8 @@ int frameHeight = 720; // 360 (cam1)    720 (cam2)    768 (cam3)
 const bool flipFrame = false;
 
 const bool cropBorder = false;
-const double borderWidthRatio = 2.596 / 332.644;
-const double borderHeightRatio = 3.124 / 188.776;
-int borderWidth, screenWidth, borderHeight, screenHeight;
+BezelCrop bezelCrop;
+cv::Mat croppedFrame;
 
 double fadeOut = 0;
 double fadeRate = 0;
@@ -161,6 +163,8 @@ int main (int argc, char *argv[])
 	// if (argc > 2) { maxDelay = atoi(argv[2]); }
 	// if (argc > 3) { switchingTime = atof(argv[3]); }
 
+	bezelCrop.evenBorders = true;
+
 	if (fromFile) {
 		cam = cv::VideoCapture (inputFileName);
 		std::cout << "OPENING FILE " << inputFileName << std::endl;
@@ -196,12 +200,11 @@ int main (int argc, char *argv[])
 	}
 	
 	double time = 0;
-	double subtime = 0;
-	struct timeval startTime, endTime;
-	gettimeofday (&startTime, NULL);
-
 	int frameNb = 0;
-	int subframeNb = 0;
+
+	// Cameras pace the loop by themselves, video files are displayed at their frame rate
+	FramePacer pacer;
+	if (fromFile && !toFile && fps > 0) { pacer.targetRate = fps; }
 
 	delay = initDelay;
 	std::cout << "DELAY: " << (delay-1) << std::endl;
@@ -215,11 +218,6 @@ int main (int argc, char *argv[])
 	colSize = ((float) frameWidth / (float) maxDelay);
 	std::cout << "cols: " << colSize << " pixels / rows: " << rowSize << " pixels" << std::endl;
 
-	borderWidth = round (frameWidth * borderWidthRatio / 2) * 2;
-	screenWidth = (frameWidth - borderWidth) / 2;
-	borderHeight = round (frameHeight * borderHeightRatio / 2) * 2;
-	screenHeight = (frameHeight - borderHeight) / 2;
-
 
 	while (newDelay < maxDelay+1)
 	{
@@ -245,21 +243,15 @@ int main (int argc, char *argv[])
 	while (!stop)
 	{
 		// Measure time
-		gettimeofday (&endTime, NULL);
-		double deltaTime = (endTime.tv_sec - startTime.tv_sec) + (float) (endTime.tv_usec - startTime.tv_usec) / 1000000L;
-		startTime = endTime;
-
+		double deltaTime = pacer.step ();
 		time += deltaTime;
-		subtime += deltaTime;
-
 		frameNb++;
-		subframeNb++;
 
-		if (subtime >= 3)
+		if (pacer.report ())
 		{
-			std::cout << "CAM: " << (int) (((float) subframeNb) / subtime) << "fps" << std::endl;
-			subtime = 0;
-			subframeNb = 0;
+			std::cout << "CAM: ";
+			pacer.writeReport (std::cout);
+			std::cout << std::endl;
 		}
 
 		if (fadeRate != 0) {
@@ -385,14 +377,8 @@ void *displayFrame (void *arg)
 	}
 
 	if (cropBorder) {
-		cv::Mat output = cv::Mat (screenHeight * 2, screenWidth * 2, CV_8UC3, cv::Scalar (0, 0, 0));
-
-		finalFrame (cv::Rect (0, 0, screenWidth, screenHeight)).copyTo (output (cv::Rect (0, 0, screenWidth, screenHeight)));
-		finalFrame (cv::Rect (screenWidth + borderWidth, 0, screenWidth, screenHeight)).copyTo (output (cv::Rect (screenWidth, 0, screenWidth, screenHeight)));
-		finalFrame (cv::Rect (0, screenHeight + borderHeight, screenWidth, screenHeight)).copyTo (output (cv::Rect (0, screenHeight, screenWidth, screenHeight)));
-		finalFrame (cv::Rect (screenWidth + borderWidth, screenHeight + borderHeight, screenWidth, screenHeight)).copyTo (output (cv::Rect (screenWidth, screenHeight, screenWidth, screenHeight)));
-
-		finalFrame = output;
+		bezelCrop.apply (finalFrame, croppedFrame);
+		finalFrame = croppedFrame;
 	}
 	
 	if (fadeOut > 0) { finalFrame.convertTo (finalFrame, -1, 1-fadeOut); }
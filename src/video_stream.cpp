@@ -0,0 +1,246 @@
+/*
+ * This file is part of Moving Cells.
+ *
+ * Moving Cells is is a digital installation building on a depth sensor to
+ * allow spectators to interact with a cloud of particles through their movements.
+ * It has been developed and first displayed in June 2015 by Robin Lamarche-Perrin
+ * and Bruno Pace for the eponymous dance festival, in Leipzig.
+ * See: http://www.movingcells.org
+ * 
+ * The current version of the program is implemented on Kinect for Windows v2 (K4W2)
+ * through the open source driver libreenect2.
+ * See: https://github.com/OpenKinect/libfreenect2
+ * 
+ * Copyright © 2015-2017 Robin Lamarche-Perrin and Bruno Pace
+ * (<Robin.Lamarche-Perrin@lip6.fr>)
+ * 
+ * Moving Cells is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ * 
+ * Moving Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <iostream>
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <signal.h>
+
+#include "video_stream.hpp"
+
+
+// Opening a named pipe waits for its reader
+bool VideoStream::open (const std::string &vFilename, int vFormat, int vWidth, int vHeight, float vFrameRate)
+{
+	close();
+	filename = vFilename;
+	format = vFormat;
+	width = vWidth;
+	height = vHeight;
+	frameRate = (vFrameRate > 0) ? vFrameRate : DEFAULT_VIDEO_FRAME_RATE;
+
+	file = fopen (filename.c_str(), "wb");
+	if (file == NULL) { std::cerr << "Error opening video stream " << filename << ": " << strerror (errno) << std::endl; return false; }
+
+	if (format != Y4M_STREAM) { std::cout << "VIDEO: read with ffmpeg -f rawvideo -pixel_format bgr24 -video_size " << width << "x" << height << " -framerate " << frameRate << " -i " << filename << std::endl; }
+	std::cout << "VIDEO: streaming to " << filename << std::endl;
+
+	buffers[0].resize (getFrameSize());
+	buffers[1].resize (getFrameSize());
+	convertedBuffer = 0;
+	pendingBuffer = -1;
+	frameNb = 0;
+	failed = false;
+	stopping = false;
+
+	int rc = pthread_create (&thread, NULL, &VideoStream::run, (void *) this);
+	if (rc) { std::cout << "Error: Unable to create thread " << rc << std::endl; exit (-1); }
+	return true;
+}
+
+
+// Writes the pending frame first
+void VideoStream::close ()
+{
+	if (file == NULL) { return; }
+	pthread_mutex_lock (&mutex);
+	stopping = true;
+	pthread_cond_broadcast (&condition);
+	pthread_mutex_unlock (&mutex);
+	pthread_join (thread, NULL);
+	file = NULL;
+	std::cout << "VIDEO: " << frameNb << " frames streamed to " << filename << std::endl;
+}
+
+
+bool VideoStream::write (const cv::Mat &vFrame, WorkerPool &workers)
+{
+	if (file == NULL) { return false; }
+	if (vFrame.cols != width || vFrame.rows != height) {
+		std::cerr << "Error: video stream " << filename << " is " << width << "x" << height << ", not " << vFrame.cols << "x" << vFrame.rows << std::endl;
+		close();
+		return false;
+	}
+
+	frame = &vFrame;
+	workerNumber = workers.workerNumber;
+	workers.run (&VideoStream::convert, this);
+
+	// The writer is done with the other buffer once nothing is pending
+	pthread_mutex_lock (&mutex);
+	while (pendingBuffer >= 0 && !failed) { pthread_cond_wait (&condition, &mutex); }
+	bool written = !failed;
+	if (written) {
+		pendingBuffer = convertedBuffer;
+		convertedBuffer = 1 - convertedBuffer;
+		frameNb++;
+		pthread_cond_broadcast (&condition);
+	}
+	pthread_mutex_unlock (&mutex);
+
+	if (!written) { close(); }
+	return written;
+}
+
+
+int VideoStream::getFrameSize () const
+{
+	if (format == Y4M_STREAM) { return width * height + 2 * ((width + 1) / 2) * ((height + 1) / 2); }
+	return width * height * 3;
+}
+
+
+void VideoStream::convert (void *stream, int id)
+{
+	reinterpret_cast<VideoStream*>(stream)->convert (id);
+}
+
+void VideoStream::convert (int id)
+{
+	if (format == Y4M_STREAM) {
+		int rowNumber = (height + 1) / 2;
+		convertY4M ((long) rowNumber * id / workerNumber, (long) rowNumber * (id + 1) / workerNumber);
+	}
+	else { convertRaw ((long) height * id / workerNumber, (long) height * (id + 1) / workerNumber); }
+}
+
+
+void VideoStream::convertRaw (int firstRow, int lastRow)
+{
+	int channels = frame->channels();
+	for (int y = firstRow; y < lastRow; y++) {
+		const unsigned char *pixel = frame->ptr<uchar>(y);
+		unsigned char *output = buffers[convertedBuffer].data() + (long) y * width * 3;
+		if (channels == 3) { memcpy (output, pixel, width * 3); continue; }
+		for (int x = 0; x < width; x++, pixel += channels, output += 3) {
+			output[0] = pixel[0];
+			output[1] = pixel[1];
+			output[2] = pixel[2];
+		}
+	}
+}
+
+
+// BT.601 limited range. Rows are chroma rows, each covering two rows of
+// pixels, whose chroma is averaged over 2x2 blocks.
+void VideoStream::convertY4M (int firstRow, int lastRow)
+{
+	int channels = frame->channels();
+	int chromaWidth = (width + 1) / 2;
+	int chromaHeight = (height + 1) / 2;
+	unsigned char *yPlane = buffers[convertedBuffer].data();
+	unsigned char *uPlane = yPlane + (long) width * height;
+	unsigned char *vPlane = uPlane + (long) chromaWidth * chromaHeight;
+
+	for (int row = firstRow; row < lastRow; row++) {
+		const unsigned char *lines[2] = { frame->ptr<uchar>(2 * row), frame->ptr<uchar>(std::min (2 * row + 1, height - 1)) };
+
+		for (int k = 0; k < 2 && 2 * row + k < height; k++) {
+			const unsigned char *pixel = lines[k];
+			unsigned char *luma = yPlane + (long) (2 * row + k) * width;
+			for (int x = 0; x < width; x++, pixel += channels) {
+				luma[x] = ((66 * pixel[2] + 129 * pixel[1] + 25 * pixel[0] + 128) >> 8) + 16;
+			}
+		}
+
+		unsigned char *u = uPlane + (long) row * chromaWidth;
+		unsigned char *v = vPlane + (long) row * chromaWidth;
+		for (int x = 0; x < chromaWidth; x++) {
+			int left = 2 * x * channels;
+			int right = std::min (2 * x + 1, width - 1) * channels;
+			int b = lines[0][left] + lines[0][right] + lines[1][left] + lines[1][right];
+			int g = lines[0][left + 1] + lines[0][right + 1] + lines[1][left + 1] + lines[1][right + 1];
+			int r = lines[0][left + 2] + lines[0][right + 2] + lines[1][left + 2] + lines[1][right + 2];
+			u[x] = ((-38 * r - 74 * g + 112 * b + 512) >> 10) + 128;
+			v[x] = ((112 * r - 94 * g - 18 * b + 512) >> 10) + 128;
+		}
+	}
+}
+
+
+void *VideoStream::run (void *stream)
+{
+	reinterpret_cast<VideoStream*>(stream)->run();
+	pthread_exit (NULL);
+}
+
+
+// Everything is written from this thread, where SIGPIPE is blocked: a reader
+// that quits fails the next write with EPIPE instead of killing the process
+void VideoStream::run ()
+{
+	sigset_t signals;
+	sigemptyset (&signals);
+	sigaddset (&signals, SIGPIPE);
+	pthread_sigmask (SIG_BLOCK, &signals, NULL);
+
+	bool headerWritten = true;
+	if (format == Y4M_STREAM) {
+		int numerator = round (frameRate * 1000);
+		int denominator = 1000;
+		int a = numerator, b = denominator;
+		while (b != 0) { int r = a % b; a = b; b = r; }
+		numerator /= a;
+		denominator /= a;
+		headerWritten = fprintf (file, "YUV4MPEG2 W%d H%d F%d:%d Ip A1:1 C420jpeg\n", width, height, numerator, denominator) > 0;
+	}
+
+	pthread_mutex_lock (&mutex);
+	if (!headerWritten) {
+		std::cerr << "Error writing video stream " << filename << ": " << strerror (errno) << std::endl;
+		failed = true;
+		pthread_cond_broadcast (&condition);
+	}
+	while (!failed)
+	{
+		while (!stopping && pendingBuffer < 0) { pthread_cond_wait (&condition, &mutex); }
+		if (pendingBuffer < 0) { break; }
+		std::vector<unsigned char> &buffer = buffers[pendingBuffer];
+		pthread_mutex_unlock (&mutex);
+
+		bool written = (format != Y4M_STREAM || fputs ("FRAME\n", file) >= 0)
+			&& fwrite (buffer.data(), 1, buffer.size(), file) == buffer.size();
+
+		pthread_mutex_lock (&mutex);
+		pendingBuffer = -1;
+		pthread_cond_broadcast (&condition);
+		if (!written) {
+			if (errno == EPIPE) { std::cout << "VIDEO: the reader of " << filename << " closed the stream" << std::endl; }
+			else { std::cerr << "Error writing video stream " << filename << ": " << strerror (errno) << std::endl; }
+			failed = true;
+		}
+	}
+	pthread_mutex_unlock (&mutex);
+
+	fclose (file);
+}
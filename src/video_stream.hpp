@@ -0,0 +1,103 @@
+/*
+ * This file is part of Moving Cells.
+ *
+ * Moving Cells is is a digital installation building on a depth sensor to
+ * allow spectators to interact with a cloud of particles through their movements.
+ * It has been developed and first displayed in June 2015 by Robin Lamarche-Perrin
+ * and Bruno Pace for the eponymous dance festival, in Leipzig.
+ * See: http://www.movingcells.org
+ * 
+ * The current version of the program is implemented on Kinect for Windows v2 (K4W2)
+ * through the open source driver libreenect2.
+ * See: https://github.com/OpenKinect/libfreenect2
+ * 
+ * Copyright © 2015-2017 Robin Lamarche-Perrin and Bruno Pace
+ * (<Robin.Lamarche-Perrin@lip6.fr>)
+ * 
+ * Moving Cells is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ * 
+ * Moving Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef VIDEO_STREAM_HPP
+#define VIDEO_STREAM_HPP
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <pthread.h>
+
+#include <opencv2/opencv.hpp>
+
+#include "worker_pool.hpp"
+
+
+// DEFINE ENUM
+
+#define Y4M_STREAM                0         // YUV4MPEG2, BT.601 4:2:0
+#define RAW_STREAM                1         // headerless BGR24 frames
+
+#define DEFAULT_VIDEO_FRAME_RATE  30
+
+
+// VIDEO STREAM
+//
+// Writes frames as one video stream to a file or a named pipe, so that ffmpeg
+// reads them directly instead of an image file per frame. Frames are
+// converted to YUV 4:2:0 or packed BGR on the worker pool, then written by a
+// writer thread while the next frame is converted: the caller only waits
+// when the reader is slower than the simulation.
+//
+// Y4M streams carry their size and frame rate. Raw streams do not, so the
+// ffmpeg options to read them are printed when the stream opens.
+
+class VideoStream
+{
+public:
+	int format = Y4M_STREAM;
+	int width = 0;
+	int height = 0;
+	float frameRate = 0;
+	std::string filename;
+	FILE *file = NULL;
+
+	std::vector<unsigned char> buffers[2];
+	int convertedBuffer = 0;                  // buffer of the frame being converted
+	int pendingBuffer = -1;                   // buffer waiting for, or being written by, the writer, -1 if none
+	const cv::Mat *frame = NULL;              // frame being converted
+	int workerNumber = 1;
+
+	long frameNb = 0;
+	bool failed = false;
+	bool stopping = false;
+	pthread_t thread;
+	pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+	pthread_cond_t condition = PTHREAD_COND_INITIALIZER;
+
+	bool open (const std::string &vFilename, int vFormat, int vWidth, int vHeight, float vFrameRate);
+	bool isOpen () const { return file != NULL; }
+	void close ();
+	bool write (const cv::Mat &vFrame, WorkerPool &workers);   // false when the stream is closed
+
+	int getFrameSize () const;
+	static void convert (void *stream, int id);
+	void convert (int id);
+	void convertRaw (int firstRow, int lastRow);
+	void convertY4M (int firstRow, int lastRow);
+
+	static void *run (void *stream);
+	void run ();
+};
+
+
+#endif
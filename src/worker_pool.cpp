@@ -0,0 +1,153 @@
+/*
+ * This file is part of Moving Cells.
+ *
+ * Moving Cells is is a digital installation building on a depth sensor to
+ * allow spectators to interact with a cloud of particles through their movements.
+ * It has been developed and first displayed in June 2015 by Robin Lamarche-Perrin
+ * and Bruno Pace for the eponymous dance festival, in Leipzig.
+ * See: http://www.movingcells.org
+ * 
+ * The current version of the program is implemented on Kinect for Windows v2 (K4W2)
+ * through the open source driver libreenect2.
+ * See: https://github.com/OpenKinect/libfreenect2
+ * 
+ * Copyright © 2015-2017 Robin Lamarche-Perrin and Bruno Pace
+ * (<Robin.Lamarche-Perrin@lip6.fr>)
+ * 
+ * Moving Cells is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ * 
+ * Moving Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+// LIBRARIES
+
+#include <iostream>
+#include <cstdlib>
+#include <unistd.h>
+
+#include "worker_pool.hpp"
+
+
+// FUNCTIONS
+
+WorkerPool::WorkerPool () {}
+
+
+WorkerPool::~WorkerPool ()
+{
+	stop();
+}
+
+
+int WorkerPool::getProcessorNumber ()
+{
+	long number = sysconf (_SC_NPROCESSORS_ONLN);
+	if (number < 1) { return 1; }
+	return number;
+}
+
+
+void WorkerPool::start (int number)
+{
+	if (number < 1) { number = 1; }
+	if (number == workerNumber) { return; }
+	stop();
+
+	workerNumber = number;
+	stopping = false;
+	threads.resize (workerNumber);
+	workerArgs.resize (workerNumber);
+
+	// Worker 0 is the calling thread, the other ones are spawned once here
+	for (int i = 1; i < workerNumber; i++)
+	{
+		workerArgs[i].pool = this;
+		workerArgs[i].id = i;
+		workerArgs[i].generation = currentGeneration;
+		int rc = pthread_create (&threads[i], NULL, &WorkerPool::work, (void *) &workerArgs[i]);
+		if (rc) { std::cout << "Error: Unable to create thread " << rc << std::endl; exit(-1); }
+	}
+}
+
+
+void WorkerPool::stop ()
+{
+	if (workerNumber == 0) { return; }
+
+	pthread_mutex_lock (&mutex);
+	stopping = true;
+	pthread_cond_broadcast (&startCondition);
+	pthread_mutex_unlock (&mutex);
+
+	for (int i = 1; i < workerNumber; i++)
+	{
+		int rc = pthread_join (threads[i], NULL);
+		if (rc) { std::cout << "Error: Unable to join thread " << rc << std::endl; exit(-1); }
+	}
+
+	threads.clear();
+	workerArgs.clear();
+	workerNumber = 0;
+}
+
+
+void WorkerPool::run (Task task, void *arg)
+{
+	if (workerNumber <= 1) { task (arg, 0); return; }
+
+	pthread_mutex_lock (&mutex);
+	currentTask = task;
+	currentArg = arg;
+	pendingWorkers = workerNumber - 1;
+	currentGeneration++;
+	pthread_cond_broadcast (&startCondition);
+	pthread_mutex_unlock (&mutex);
+
+	task (arg, 0);
+
+	pthread_mutex_lock (&mutex);
+	while (pendingWorkers > 0) { pthread_cond_wait (&endCondition, &mutex); }
+	pthread_mutex_unlock (&mutex);
+}
+
+
+void *WorkerPool::work (void *arg)
+{
+	WorkerArg *workerArg = (WorkerArg *) arg;
+	workerArg->pool->work (workerArg->id, workerArg->generation);
+	pthread_exit (NULL);
+}
+
+
+void WorkerPool::work (int id, unsigned long generation)
+{
+	pthread_mutex_lock (&mutex);
+	while (true)
+	{
+		while (currentGeneration == generation && !stopping) { pthread_cond_wait (&startCondition, &mutex); }
+		if (stopping) { break; }
+
+		generation = currentGeneration;
+		Task task = currentTask;
+		void *arg = currentArg;
+		pthread_mutex_unlock (&mutex);
+
+		task (arg, id);
+
+		pthread_mutex_lock (&mutex);
+		if (--pendingWorkers == 0) { pthread_cond_signal (&endCondition); }
+	}
+
+	pthread_mutex_unlock (&mutex);
+}
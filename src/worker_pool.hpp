@@ -0,0 +1,86 @@
+/*
+ * This file is part of Moving Cells.
+ *
+ * Moving Cells is is a digital installation building on a depth sensor to
+ * allow spectators to interact with a cloud of particles through their movements.
+ * It has been developed and first displayed in June 2015 by Robin Lamarche-Perrin
+ * and Bruno Pace for the eponymous dance festival, in Leipzig.
+ * See: http://www.movingcells.org
+ * 
+ * The current version of the program is implemented on Kinect for Windows v2 (K4W2)
+ * through the open source driver libreenect2.
+ * See: https://github.com/OpenKinect/libfreenect2
+ * 
+ * Copyright © 2015-2017 Robin Lamarche-Perrin and Bruno Pace
+ * (<Robin.Lamarche-Perrin@lip6.fr>)
+ * 
+ * Moving Cells is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ * 
+ * Moving Cells is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef WORKER_POOL_HPP
+#define WORKER_POOL_HPP
+
+#include <vector>
+#include <pthread.h>
+
+
+// WORKER POOL
+//
+// Long-lived threads that execute one task per phase. A call to run() wakes
+// every worker, runs the task on the calling thread as worker 0 and returns
+// once all workers are done, which acts as a barrier between phases.
+// run() must only be called from one thread at a time.
+
+class WorkerPool
+{
+public:
+	typedef void (*Task) (void *arg, int id);
+
+	struct WorkerArg {
+		WorkerPool *pool;
+		int id;
+		unsigned long generation;
+	};
+
+	int workerNumber = 0;
+	bool stopping = false;
+
+	Task currentTask = NULL;
+	void *currentArg = NULL;
+	unsigned long currentGeneration = 0;
+	int pendingWorkers = 0;
+
+	pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+	pthread_cond_t startCondition = PTHREAD_COND_INITIALIZER;
+	pthread_cond_t endCondition = PTHREAD_COND_INITIALIZER;
+
+	std::vector<pthread_t> threads;
+	std::vector<WorkerArg> workerArgs;
+
+	WorkerPool ();
+	~WorkerPool ();
+
+	void start (int number);
+	void stop ();
+	void run (Task task, void *arg);
+
+	static int getProcessorNumber ();
+
+	static void *work (void *arg);
+	void work (int id, unsigned long generation);
+};
+
+
+#endif
@@ -1,12 +1,12 @@
-// g++ crop_screens.cpp -o crop-screens `pkg-config --cflags --libs opencv`
+// g++ crop_screens.cpp ../../../src/bezel_crop.cpp -I../../../src -o crop-screens `pkg-config --cflags --libs opencv`
+// Crops images recorded without cropBezels, new recordings are cropped by static-cells itself
 
 #include <iostream>
 #include <fstream>
 #include <vector>
 #include <opencv2/opencv.hpp>
 
-double borderWidthRatio = 2.596 / 332.644;
-double borderHeightRatio = 3.124 / 188.776;
+#include "bezel_crop.hpp"
 
 int main (int argc, char *argv[])
 {
@@ -16,24 +16,9 @@ int main (int argc, char *argv[])
 	std::string outputFile = argv[2];
 
 	cv::Mat input = cv::imread (inputFile);
-	cv::Size size = input.size();
-
-	int borderWidth = round (size.width * borderWidthRatio);
-	int screenWidth = (size.width - borderWidth) / 2;
-
-	int borderHeight = round (size.height * borderHeightRatio);
-	int screenHeight = (size.height - borderHeight) / 2;
-
-	// std::cout << " image = " << size.width << " x " << size.height << std::endl;
-	// std::cout << "border = " << borderWidth << " x " << borderHeight << std::endl;
-	// std::cout << "screen = " << screenWidth << " x " << screenHeight << std::endl;
-	
-	cv::Mat output = cv::Mat (screenHeight * 2, screenWidth * 2, CV_8UC3, cv::Scalar (0, 0, 0));
-
-	input (cv::Rect (0, 0, screenWidth, screenHeight)).copyTo (output (cv::Rect (0, 0, screenWidth, screenHeight)));
-	input (cv::Rect (screenWidth + borderWidth, 0, screenWidth, screenHeight)).copyTo (output (cv::Rect (screenWidth, 0, screenWidth, screenHeight)));
-	input (cv::Rect (0, screenHeight + borderHeight, screenWidth, screenHeight)).copyTo (output (cv::Rect (0, screenHeight, screenWidth, screenHeight)));
-	input (cv::Rect (screenWidth + borderWidth, screenHeight + borderHeight, screenWidth, screenHeight)).copyTo (output (cv::Rect (screenWidth, screenHeight, screenWidth, screenHeight)));
+	cv::Mat output;
+	BezelCrop crop;
+	crop.apply (input, output);
 
 	std::vector<int> params;
     params.push_back (CV_IMWRITE_PNG_COMPRESSION);
@@ -43,4 +28,3 @@ int main (int argc, char *argv[])
 
 	return EXIT_SUCCESS;
 }
-
@@ -0,0 +1,13 @@
+#!/bin/bash
+# Requires recordVideo in static-cells: frames are streamed through a named
+# pipe to ffmpeg, without writing any image
+trash out/
+mkdir out
+mkfifo out/static-cells-screenshot.y4m
+trash static-cells-HD.mp4
+ffmpeg -i out/static-cells-screenshot.y4m -c:v libx264 -profile:v high -crf 17 -pix_fmt yuv420p static-cells-HD.mp4 &
+../../build/bin/static-cells
+wait
+trash static-cells-alva-noto-HD.mp4
+ffmpeg -i static-cells-HD.mp4 -itsoffset 0.70 -i alva-noto-outro-HD.mp3 -map 0:v -map 1:a -c copy -shortest static-cells-alva-noto-HD.mp4
+#vlc static-cells-alva-noto-HD.mp4 &